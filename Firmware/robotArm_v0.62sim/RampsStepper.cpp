@@ -3,40 +3,41 @@
 
 #include <Arduino.h>
 
-RampsStepper::RampsStepper(int aStepPin, int aDirPin, int aEnablePin, bool aInverse) {
+RampsStepper::RampsStepper(bool aInverse) {
   setReductionRatio(MAIN_GEAR_TEETH / MOTOR_GEAR_TEETH, MICROSTEPS * STEPS_PER_REV);
-  stepPin = aStepPin;
-  dirPin = aDirPin;
-  enablePin = aEnablePin;
   inverse = aInverse;
   stepperStepPosition = 0;
-  stepperStepTargetPosition;
-#ifndef SIMULATION
-  pinMode(stepPin, OUTPUT);
-  pinMode(dirPin, OUTPUT);
-  pinMode(enablePin, OUTPUT);
-#endif
-  enable(false);
+  stepperStepTargetPosition = 0;
+  stepperStepQueuedPosition = 0;
+  stepDelta = 1;
+  state = false;
 }
 
 void RampsStepper::enable(bool value) {
   state = value;
 #ifndef SIMULATION
-  digitalWrite(enablePin, !value);
+  writeEnable(!value);
 #endif
 }
 
 bool RampsStepper::isOnPosition() const {
-  return stepperStepPosition == stepperStepTargetPosition;
+  return getPosition() == stepperStepTargetPosition;
 }
 
 int RampsStepper::getPosition() const {
-  return stepperStepPosition;
+  // int son dos bytes en AVR: se lee sin que la interrupción lo cambie a medias
+  noInterrupts();
+  int position = stepperStepPosition;
+  interrupts();
+  return position;
 }
 
 void RampsStepper::setPosition(int value) {
+  noInterrupts();
   stepperStepPosition = value;
+  interrupts();
   stepperStepTargetPosition = value;
+  stepperStepQueuedPosition = value;
 }
 
 void RampsStepper::stepToPosition(int value) {
@@ -71,21 +72,40 @@ void RampsStepper::stepRelativeRad(float rad) {
 void RampsStepper::update() {   
   while (stepperStepTargetPosition < stepperStepPosition) {  
 #ifndef SIMULATION
-    digitalWrite(dirPin, !inverse);
-    digitalWrite(stepPin, HIGH);
-    digitalWrite(stepPin, LOW);
+    writeDirection(!inverse);
+    writeStep();
 #endif
     stepperStepPosition--;
   }
   
   while (stepperStepTargetPosition > stepperStepPosition) {    
 #ifndef SIMULATION
-    digitalWrite(dirPin, inverse);
-    digitalWrite(stepPin, HIGH);
-    digitalWrite(stepPin, LOW);
+    writeDirection(inverse);
+    writeStep();
 #endif
     stepperStepPosition++;
   }
+  stepperStepQueuedPosition = stepperStepPosition;
+}
+
+int RampsStepper::takeSteps() {
+  int steps = stepperStepTargetPosition - stepperStepQueuedPosition;
+  stepperStepQueuedPosition = stepperStepTargetPosition;
+  return steps;
+}
+
+void RampsStepper::setDirection(bool forward) {
+  stepDelta = forward ? 1 : -1;
+#ifndef SIMULATION
+  writeDirection(forward ? inverse : !inverse);
+#endif
+}
+
+void RampsStepper::step() {
+#ifndef SIMULATION
+  writeStep();
+#endif
+  stepperStepPosition += stepDelta;
 }
 
 void RampsStepper::setReductionRatio(float gearRatio, int stepsPerRev) {
@@ -1,9 +1,12 @@
 #ifndef RAMPSSTEPPER_H_
 #define RAMPSSTEPPER_H_
+#include "config.h"
+#include "fastPin.h"
 
+// Posición y pasos de un motor; los pines los pone RampsStepperPins al compilar
 class RampsStepper {
 public:
-  RampsStepper(int aStepPin, int aDirPin, int aEnablePin, bool aInverse);
+  RampsStepper(bool aInverse);
   void enable(bool value = true);
     
   bool isOnPosition() const;
@@ -18,17 +21,43 @@ public:
   void stepRelativeRad(float rad);
 
   void update();
+  // STEP_ISR: StepGenerator saca de aquí los pasos hasta el target (takeSteps) y
+  // los da desde la interrupción (setDirection y step)
+  int takeSteps();
+  void setDirection(bool forward);
+  void step();
   void setReductionRatio(float gearRatio, int stepsPerRev);
   bool getState() const;
+protected:
+  virtual void writeEnable(bool level) = 0;
+  virtual void writeDirection(bool level) = 0;
+  virtual void writeStep() = 0; // un pulso
 private:
   int stepperStepTargetPosition;
-  int stepperStepPosition;
-  int stepPin;
-  int dirPin;
-  int enablePin;  
+  volatile int stepperStepPosition; // pasos dados (la interrupción la cambia con STEP_ISR)
+  int stepperStepQueuedPosition;    // donde queda con los pasos ya entregados a StepGenerator
+  int stepDelta;                    // +1 o -1, dirección del segmento en curso
   bool inverse;
   float radToStepFactor;
   bool state;
 };
 
+// RampsStepperPins<X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN>: escribe con FastPin
+template <int STEP_PIN, int DIR_PIN, int ENABLE_PIN>
+class RampsStepperPins : public RampsStepper {
+public:
+  RampsStepperPins(bool aInverse) : RampsStepper(aInverse) {
+#ifndef SIMULATION
+    FastPin<STEP_PIN>::setOutput();
+    FastPin<DIR_PIN>::setOutput();
+    FastPin<ENABLE_PIN>::setOutput();
+#endif
+    enable(false);
+  }
+protected:
+  void writeEnable(bool level) { FastPin<ENABLE_PIN>::write(level); }
+  void writeDirection(bool level) { FastPin<DIR_PIN>::write(level); }
+  void writeStep() { FastPin<STEP_PIN>::pulse(); }
+};
+
 #endif
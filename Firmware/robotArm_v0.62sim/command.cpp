@@ -11,28 +11,80 @@ Command::Command() {
   new_command.valueF = 0;
   new_command.valueE = NAN;
   new_command.valueS = 0;
-  message = "";
+  message[0] = '\0';
+  length = 0;
+  overflow = false;
   isRelativeCoord = false;
 }
 
 bool Command::handleGcode() {
-  if (Serial.available()) {
+  // Lee todo lo que haya hasta el fin de línea; lo que siga queda en el buffer
+  // de Serial para la próxima llamada
+  while (Serial.available()) {
     char c = Serial.read();
     if (c == '\n') {
-       return false; 
+      continue;
     }
     if (c == '\r') {
-       bool b = processMessage(message);
-       message = "";
-       return b;
+      message[length] = '\0';
+      bool b;
+      if (overflow) {
+        Logger::logERROR("LINE TOO LONG");
+        b = false;
+      } else {
+        b = processMessage(message);
+      }
+      length = 0;
+      overflow = false;
+      return b;
+    }
+    if (length < MAX_LINE_LENGTH) {
+      message[length++] = c;
     } else {
-       message += c; 
+      overflow = true;
     }
   }
   return false;
 }
 
-bool Command::processMessage(String msg){
+// Como atof pero sin exponente (la E es un eje) y sin espacios: signo, dígitos y
+// un punto; para en el primer carácter que no sea eso. Toma hasta 9 cifras, más
+// de las que guarda un float, y escala con una sola multiplicación o división.
+static float parseValue(const char* p) {
+  bool negative = false;
+  if (*p == '+' || *p == '-') {
+    negative = *p == '-';
+    p++;
+  }
+  unsigned long mantissa = 0;
+  int exponent = 0;
+  bool fraction = false;
+  for (;; p++) {
+    if (*p == '.' && !fraction) {
+      fraction = true;
+    } else if (isDigit(*p)) {
+      if (mantissa < 100000000UL) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (fraction) {
+          exponent--;
+        }
+      } else if (!fraction) {
+        exponent++;
+      }
+    } else {
+      break;
+    }
+  }
+  float value = mantissa;
+  float scale = 1;
+  for (int i = abs(exponent); i > 0; i--) {
+    scale *= 10;
+  }
+  value = exponent < 0 ? value / scale : value * scale;
+  return negative ? -value : value;
+}
+
+bool Command::processMessage(char* msg){
 
   new_command.valueX = NAN; 
   new_command.valueY = NAN;
@@ -40,40 +92,34 @@ bool Command::processMessage(String msg){
   new_command.valueE = NAN;
   new_command.valueF = 0;
   new_command.valueS = 0;  
-  msg.toUpperCase();
-  msg.replace(" ", "");
-  int active_index = 0;
-  new_command.id = msg[active_index];
+  // Mayúsculas y sin espacios, sobre el mismo buffer
+  char* out = msg;
+  for (const char* in = msg; *in; in++) {
+    if (*in != ' ') {
+      *out++ = toupper(*in);
+    }
+  }
+  *out = '\0';
+  new_command.id = msg[0];
   if((new_command.id != 'G') && (new_command.id != 'M')){
     printErr();
     return false;
   }
 
-  active_index++;
-  int temp_index = active_index;
-  while (temp_index<msg.length() && !isAlpha(msg[temp_index])){
-    temp_index++;
-  }
-  new_command.num = msg.substring(active_index, temp_index).toInt();
-  active_index = temp_index;
-  temp_index++;
-  while (temp_index<msg.length()){
-    while (!isAlpha(msg[temp_index]) || msg[temp_index]=='.'){
-      temp_index++;
-      if (temp_index == msg.length()){
-        break;
-      }
+  new_command.num = atoi(msg + 1);
+  // Cada letra empieza un valor que llega hasta la letra siguiente; una letra
+  // suelta al final de la línea no cuenta
+  for (const char* p = msg + 1; *p; p++) {
+    if (isAlpha(*p) && p[1] != '\0') {
+      value_segment(*p, p + 1);
     }
-    value_segment(msg.substring(active_index, temp_index));
-    active_index = temp_index;
-    temp_index++;
   }
   return true;
 }
 
-void Command::value_segment(String msg_segment){
-  float msg_value = msg_segment.substring(1).toFloat();
-  switch (msg_segment[0]){
+void Command::value_segment(char letter, const char* value){
+  float msg_value = parseValue(value);
+  switch (letter){
     case 'X': new_command.valueX = msg_value; break;
     case 'Y': new_command.valueY = msg_value; break;
     case 'Z': new_command.valueZ = msg_value; break;
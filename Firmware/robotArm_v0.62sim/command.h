@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include "interpolation.h"
+#include "config.h"
 
 struct Cmd {
   char id;
@@ -19,8 +20,9 @@ class Command {
   public:
     Command();
     bool handleGcode();
-    bool processMessage(String msg);
-    void value_segment(String msg_segment);
+    // Sin String: la línea se arma en message y se parte ahí mismo
+    bool processMessage(char* msg);
+    void value_segment(char letter, const char* value);
     Cmd getCmd() const;
     void cmdGetPosition(Point pos, Point pos_offset, float highRad, float lowRad, float rotRad, bool onFan, bool onMotors);
     void cmdToRelative();
@@ -29,7 +31,9 @@ class Command {
     Cmd new_command;
 
   private: 
-    String message;
+    char message[MAX_LINE_LENGTH + 1];
+    byte length;
+    bool overflow; // la línea no entró en message: se descarta entera
 };
 
 void cmdMove(Cmd(&cmd), Point pos, Point pos_offset, bool isRelativeCoord);
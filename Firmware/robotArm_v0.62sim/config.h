@@ -48,6 +48,13 @@
 #define INVERSE_Z_STEPPER true // CHANGE IF STEPPER MOVES OTHER WAY
 #define INVERSE_E0_STEPPER false // CHANGE IF STEPPER MOVES OTHER WAY
 
+//STEP GENERATION SETTINGS:
+#define STEP_ISR true // "true": STEPS FROM A TIMER2 INTERRUPT, ALL AXES TOGETHER (BRESENHAM) AND EVENLY TIMED. "false": RampsStepper::update() BURSTS FROM loop()
+#define MAX_STEP_RATE 10000 // MAX STEPS PER SECOND OF THE FASTEST AXIS IN A SEGMENT (STEP_ISR)
+#define STEP_QUEUE_SIZE 8 // SEGMENTS (ONE PER loop() WITH MOTION) WAITING FOR THE INTERRUPT (STEP_ISR)
+#define STEP_SEGMENT_MAX_US 30000 // LONGEST TIME ONE SEGMENT IS SPREAD OVER, E.G. AFTER BEING IDLE (STEP_ISR)
+// TIMER2 IS NOT USED BY Servo (TIMER1, ON MEGA ALSO 3/4/5) BUT IS USED BY tone() AND analogWrite() ON PINS 9/10 (MEGA) OR 3/11 (UNO): DO NOT USE THEM WITH STEP_ISR
+
 //RAIL SETTINGS:
 #define RAIL false // E0 STEPPER USED AS RAIL. SET TO 'false' IF ROBOT ARM IS STATIONARY.
 #define STEPS_PER_MM_RAIL 80.0 // STEPS PER MM FOR RAIL MOTOR
@@ -81,6 +88,7 @@
 
 //COMMAND QUEUE SETTINGS
 #define QUEUE_SIZE 15
+#define MAX_LINE_LENGTH 96 // CHARACTERS PER G-CODE LINE (WITHOUT \r), LONGER LINES ARE REJECTED
 
 //PRINT REPLY SETTING
 #define PRINT_REPLY true // "true" TO PRINT MSG AFTER ONE COMMAND IS PROCESSED
@@ -91,6 +99,13 @@
 //0: FLAT SPEED CURVE (CONSTANT SPEED PER MOVEMENT, SUITABLE FOR REALTIME CONTROL SOFTWARE)
 //1: ARCTAN APPROX (SLIGHT BELL CURVE ACCELERATION & DECELERATION)
 //2: COSIN APPROX (TOTAL BELL CURVE ACCEL FROM 0 & DECEL FROM 0, SUITABLE FOR PRESET COMMAND MOVEMENTS)
+//3: LOOK-AHEAD TRAPEZOID (CONSTANT ACCELERATION, F IS CRUISE SPEED, QUEUED G0/G1 BLEND WITHOUT STOPPING)
+//   ONLY FASTER THAN 2 WITH SEVERAL G0/G1 QUEUED; SENDING ONE LINE PER OK (runProgram) IT IS SLOWER
+#define ACCELERATION 400.0 // MM/S^2 FOR SPEED_PROFILE 3 (COSIN PROFILE PEAKS AROUND 490 WITH DEFAULT SPEEDS)
+#define JUNCTION_DEVIATION 0.05 // MAX MM THE PATH MAY CUT A CORNER WHEN BLENDING (SPEED_PROFILE 3)
+
+//INVERSE KINEMATICS SETTING
+#define TABLE_IK true // "true": ATAN TABLE INSTEAD OF SOFT-FLOAT asin/acos/hypot (ERROR BELOW 5E-5 RAD, 1/10 STEP). "false": libm VERSION
 
 
 //LOG SETTINGS
@@ -1,9 +1,13 @@
 #ifndef ENDSTOP_H_
 #define ENDSTOP_H_
+#include <Arduino.h>
+#include "fastPin.h"
 
+// Endstop<X_MIN_PIN, X_DIR_PIN, X_STEP_PIN, X_ENABLE_PIN>: pines resueltos al compilar
+template <int MIN_PIN, int DIR_PIN, int STEP_PIN, int EN_PIN>
 class Endstop {
   public:
-    Endstop(int a_min_pin, int a_dir_pin, int a_step_pin, int a_en_pin, int a_switch_input, int a_step_offset, int a_home_dwell, int a_check_delay);
+    Endstop(int a_switch_input, int a_step_offset, int a_home_dwell, int a_check_delay);
     void home(bool dir);
     void homeOffset(bool dir);
     void oneStepToEndstop(bool dir);
@@ -11,10 +15,6 @@ class Endstop {
     bool checkDelay();
 
   private:
-    int min_pin;
-    int dir_pin;
-    int step_pin;
-    int en_pin;
     int switch_input;
     int home_dwell;
     int step_offset;
@@ -23,4 +23,90 @@ class Endstop {
     bool bCheckDelay;
 };
 
+template <int MIN_PIN, int DIR_PIN, int STEP_PIN, int EN_PIN>
+Endstop<MIN_PIN, DIR_PIN, STEP_PIN, EN_PIN>::Endstop(int a_switch_input, int a_step_offset, int a_home_dwell, int a_check_delay){
+  switch_input = a_switch_input;
+  home_dwell = a_home_dwell;
+  step_offset = a_step_offset;
+  check_delay = a_check_delay;
+  bCheckDelay = false;
+  FastPin<MIN_PIN>::setInputPullup();
+}
+
+template <int MIN_PIN, int DIR_PIN, int STEP_PIN, int EN_PIN>
+void Endstop<MIN_PIN, DIR_PIN, STEP_PIN, EN_PIN>::home(bool dir) {
+  FastPin<EN_PIN>::low();
+  delayMicroseconds(5);
+  FastPin<DIR_PIN>::write(dir==1);
+  delayMicroseconds(5);
+
+  // analiza si en un tiempo dado los endstops cambian de estado
+  // si no: fallo electromecanico
+  bCheckDelay = false;
+  long cDelay = 0;
+/* en v51 
+  bState = FastPin<MIN_PIN>::read();
+  while (bState != switch_input) {
+    FastPin<STEP_PIN>::pulse();
+    delayMicroseconds(home_dwell);
+    bState = FastPin<MIN_PIN>::read();
+    cDelay += home_dwell;
+    if(cDelay/1000000 > check_delay and bState != switch_input){
+      bCheckDelay = true;
+      break;
+    }
+  }
+  homeOffset(dir);
+*/
+/*  bState = !(FastPin<MIN_PIN>::read() ^ switch_input);
+  while (!bState) {
+    FastPin<STEP_PIN>::pulse();
+    delayMicroseconds(home_dwell);
+    bState = !(FastPin<MIN_PIN>::read() ^ switch_input);
+    cDelay += home_dwell;
+    if(!bState and cDelay/1000000 > check_delay){
+      bCheckDelay = true;
+      break;
+    }
+  }
+  homeOffset(dir);
+  */
+}
+
+template <int MIN_PIN, int DIR_PIN, int STEP_PIN, int EN_PIN>
+void Endstop<MIN_PIN, DIR_PIN, STEP_PIN, EN_PIN>::homeOffset(bool dir){
+  FastPin<DIR_PIN>::write(dir!=1);
+  delayMicroseconds(5);
+  for (int i = 1; i <= step_offset; i++) {
+    FastPin<STEP_PIN>::pulse();
+    delayMicroseconds(home_dwell);
+  }
+}
+
+template <int MIN_PIN, int DIR_PIN, int STEP_PIN, int EN_PIN>
+void Endstop<MIN_PIN, DIR_PIN, STEP_PIN, EN_PIN>::oneStepToEndstop(bool dir){
+  FastPin<EN_PIN>::low();
+  delayMicroseconds(5);
+  FastPin<DIR_PIN>::write(dir==1);
+  delayMicroseconds(5);
+  bState = !(FastPin<MIN_PIN>::read() ^ switch_input);
+
+  if (!bState) {
+    FastPin<STEP_PIN>::pulse();
+    delayMicroseconds(home_dwell);
+  }
+  bState = !(FastPin<MIN_PIN>::read() ^ switch_input);
+}
+
+template <int MIN_PIN, int DIR_PIN, int STEP_PIN, int EN_PIN>
+bool Endstop<MIN_PIN, DIR_PIN, STEP_PIN, EN_PIN>::state(){
+  bState = !(FastPin<MIN_PIN>::read() ^ switch_input);
+  return bState;
+}
+
+template <int MIN_PIN, int DIR_PIN, int STEP_PIN, int EN_PIN>
+bool Endstop<MIN_PIN, DIR_PIN, STEP_PIN, EN_PIN>::checkDelay(){
+  return bCheckDelay;
+}
+
 #endif
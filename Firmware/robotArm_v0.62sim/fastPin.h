@@ -0,0 +1,149 @@
+#ifndef FASTPIN_H_
+#define FASTPIN_H_
+#include <Arduino.h>
+
+// Pines resueltos al compilar: FastPin<X_STEP_PIN>::high() es una escritura
+// directa al registro PORTx en lugar de digitalWrite, que busca puerto y máscara
+// en tablas y apaga el PWM en cada llamada (varios us en AVR). El número de pin
+// es el de Arduino, como en pinout.h y pinout_uno.h. Con pin -1 no hace nada y
+// en placas sin tabla (ESP8266) sigue con digitalWrite/digitalRead.
+
+// Puerto ('A'...'L', 0 si no hay) y bit de cada pin, como pins_arduino.h
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+constexpr char fastPinPort(int pin) {
+  return pin < 0 || pin > 69 ? 0 : "EEEEGEHHHHBBBBJJHHDDDDAAAAAAAACCCCCCCCDGGGLLLLLLLLBBBBFFFFFFFFKKKKKKKK"[pin];
+}
+constexpr byte fastPinBit(int pin) {
+  return pin < 0 || pin > 69 ? 0 : "0145533456456710103210012345677654321072107654321032100123456701234567"[pin] - '0';
+}
+#elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+constexpr char fastPinPort(int pin) {
+  return pin < 0 || pin > 19 ? 0 : "DDDDDDDDBBBBBBCCCCCC"[pin];
+}
+constexpr byte fastPinBit(int pin) {
+  return pin < 0 || pin > 19 ? 0 : "01234567012345012345"[pin] - '0';
+}
+#else
+constexpr char fastPinPort(int pin) {
+  return 0;
+}
+constexpr byte fastPinBit(int pin) {
+  return 0;
+}
+#endif
+
+// Registros de cada puerto; sin puerto, uno de mentira que nadie lee
+template <char P> struct FastPort {
+  static volatile uint8_t& out() { static volatile uint8_t none; return none; }
+  static volatile uint8_t& ddr() { return out(); }
+  static volatile uint8_t& in() { return out(); }
+};
+
+#define FAST_PORT(letter, portReg, ddrReg, pinReg) \
+  template <> struct FastPort<letter> { \
+    static volatile uint8_t& out() { return portReg; } \
+    static volatile uint8_t& ddr() { return ddrReg; } \
+    static volatile uint8_t& in() { return pinReg; } \
+  };
+#ifdef PORTA
+FAST_PORT('A', PORTA, DDRA, PINA)
+#endif
+#ifdef PORTB
+FAST_PORT('B', PORTB, DDRB, PINB)
+#endif
+#ifdef PORTC
+FAST_PORT('C', PORTC, DDRC, PINC)
+#endif
+#ifdef PORTD
+FAST_PORT('D', PORTD, DDRD, PIND)
+#endif
+#ifdef PORTE
+FAST_PORT('E', PORTE, DDRE, PINE)
+#endif
+#ifdef PORTF
+FAST_PORT('F', PORTF, DDRF, PINF)
+#endif
+#ifdef PORTG
+FAST_PORT('G', PORTG, DDRG, PING)
+#endif
+#ifdef PORTH
+FAST_PORT('H', PORTH, DDRH, PINH)
+#endif
+#ifdef PORTJ
+FAST_PORT('J', PORTJ, DDRJ, PINJ)
+#endif
+#ifdef PORTK
+FAST_PORT('K', PORTK, DDRK, PINK)
+#endif
+#ifdef PORTL
+FAST_PORT('L', PORTL, DDRL, PINL)
+#endif
+#undef FAST_PORT
+
+template <int PIN> class FastPin {
+public:
+  static const char PORT = fastPinPort(PIN);
+  static const byte MASK = 1 << fastPinBit(PIN);
+
+  static void setOutput() {
+    if (PORT) {
+      set(FastPort<PORT>::ddr(), true);
+    } else if (PIN >= 0) {
+      pinMode(PIN, OUTPUT);
+    }
+  }
+  static void setInputPullup() {
+    if (PORT) {
+      set(FastPort<PORT>::ddr(), false);
+      set(FastPort<PORT>::out(), true);
+    } else if (PIN >= 0) {
+      pinMode(PIN, INPUT_PULLUP);
+    }
+  }
+  static void write(bool value) {
+    if (PORT) {
+      set(FastPort<PORT>::out(), value);
+    } else if (PIN >= 0) {
+      digitalWrite(PIN, value ? HIGH : LOW);
+    }
+  }
+  static void high() { write(true); }
+  static void low() { write(false); }
+  static bool read() {
+    if (PORT) {
+      return (FastPort<PORT>::in() & MASK) != 0;
+    }
+    return PIN >= 0 && digitalRead(PIN) == HIGH;
+  }
+  // Pulso de paso para A4988/DRV8825 (alto al menos 1 us)
+  static void pulse() {
+    high();
+    if (PORT) {
+      delayMicroseconds(1);
+    }
+    low();
+  }
+
+private:
+  // Los puertos de I/O bajos (A-G) se cambian con sbi/cbi, que es atómico; los
+  // de memoria (H-L en la MEGA) se leen y escriben: sin interrupciones en el
+  // medio, porque la de StepGenerator escribe en los mismos puertos
+  static void set(volatile uint8_t& reg, bool value) {
+#if defined(__AVR__)
+    if (PORT >= 'H') {
+      uint8_t oldSREG = SREG;
+      cli();
+      reg = value ? (reg | MASK) : (reg & ~MASK);
+      SREG = oldSREG;
+      return;
+    }
+#endif
+    if (value) {
+      reg |= MASK;
+    } else {
+      reg &= ~MASK;
+    }
+  }
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include "config.h"
 #include "queue.h"
 #include "logger.h"
+#include "profileTables.h"
 
 Interpolation::Interpolation(){
   pos_offset.xmm = 0.0;
@@ -14,6 +15,43 @@ Interpolation::Interpolation(){
   yPosmm = 0.0;
   zPosmm = 0.0;
   ePosmm = 0.0;
+
+  target.xmm = 0.0;
+  target.ymm = 0.0;
+  target.zmm = 0.0;
+  target.emm = 0.0;
+  length = 0.0;
+  exitSpeed = 0.0;
+  for (byte i = 0; i < 3; i++) {
+    phaseEndUs[i] = 0;
+    phaseBase[i] = phaseSpeed[i] = phaseAccel[i] = 0.0;
+  }
+  durationUs = phaseSteps = phaseRate = 0;
+  phaseShift = 0;
+  endSpeed = 0.0;
+  endTime = 0;
+}
+
+float moveLength(Point p0, Point p1) {
+  float a = (p1.xmm - p0.xmm);
+  float b = (p1.ymm - p0.ymm);
+  float c = (p1.zmm - p0.zmm);
+  float e = abs(p1.emm - p0.emm);
+  float dist = sqrt(a*a + b*b + c*c);
+  if (dist < e) {
+    dist = e; 
+  }
+  return dist;
+}
+
+float moveNominalSpeed(float dist, float v) {
+  if (v < 5) { //includes 0 = default value
+    v = sqrt(dist) * 10; //set a good value for v
+  }
+  if (v < 5) {
+     v = 5; 
+  }
+  return v;
 }
 
 //G92 POSITION OFFSET FUNCTIONS
@@ -71,35 +109,25 @@ void Interpolation::setInterpolation(float p1x, float p1y, float p1z, float p1e,
 }
 
 void Interpolation::setInterpolation(Point p1, float v) {
-  Point p0;
-  p0.xmm = xStartmm + xDelta;
-  p0.ymm = yStartmm + yDelta;
-  p0.zmm = zStartmm + zDelta;
-  p0.emm = eStartmm + eDelta;
-  setInterpolation(p0, p1, v);
+  setInterpolation(target, p1, v);
 }
 
 void Interpolation::setInterpolation(Point p0, Point p1, float av) {
-  v = av; //mm/s
-  
-  float a = (p1.xmm - p0.xmm);
-  float b = (p1.ymm - p0.ymm);
-  float c = (p1.zmm - p0.zmm);
-  float e = abs(p1.emm - p0.emm);
-  float dist = sqrt(a*a + b*b + c*c);
+  float dist = moveLength(p0, p1);
+  v = moveNominalSpeed(dist, av); //mm/s
 
-  if (dist < e) {
-    dist = e; 
-  }
-
-  if (v < 5) { //includes 0 = default value
-    v = sqrt(dist) * 10; //set a good value for v
-  }
-  if (v < 5) {
-     v = 5; 
+  // Sigue sin frenar al anterior si éste terminó en movimiento en p0 (planificado
+  // por setExitSpeed) y no pasó tiempo en el medio
+  unsigned long now = micros();
+  float entry = 0.0;
+  if (SPEED_PROFILE == 3 && endSpeed > 0 && (now - endTime) < 50000L &&
+      p0.xmm == target.xmm && p0.ymm == target.ymm && p0.zmm == target.zmm && p0.emm == target.emm) {
+    entry = endSpeed;
+    now = endTime; // el tiempo que pasó desde el final ya cuenta para éste
   }
-  
-  tmul = v / dist;
+  endSpeed = 0.0;
+  target = p1;
+  length = dist;
   
   xStartmm = p0.xmm;
   yStartmm = p0.ymm;
@@ -111,9 +139,128 @@ void Interpolation::setInterpolation(Point p0, Point p1, float av) {
   zDelta = (p1.zmm - p0.zmm);
   eDelta = (p1.emm - p0.emm);
    
+  if (SPEED_PROFILE == 3) {
+    planProfile(entry, 0.0);
+  } else {
+    planDuration(dist / v);
+  }
   state = 0;
   
-  startTime = micros();
+  startTime = now;
+}
+
+// Los perfiles 0-2 dependen sólo de la fracción de la duración que pasó: se
+// calcula una vez el factor para obtenerla de micros() con una multiplicación
+void Interpolation::planDuration(float seconds) {
+  durationUs = seconds * 1000000.0;
+  phaseShift = 0;
+  phaseSteps = durationUs;
+  while (phaseSteps > 65535) {
+    phaseSteps >>= 1;
+    phaseShift++;
+  }
+  phaseRate = phaseSteps > 0 ? 2147483648UL / phaseSteps : 0;
+}
+
+// Trapecio: acelera desde entry hasta v (o menos si no alcanza el largo), sigue
+// a v y frena hasta exit, todo con ACCELERATION
+void Interpolation::planProfile(float entry, float exit) {
+  float acc = ACCELERATION;
+  float maxExit = sqrt(entry * entry + 2 * acc * length); // acelerando todo el tramo
+  if (exit > maxExit) {
+    exit = maxExit;
+  }
+  float minExit2 = entry * entry - 2 * acc * length;      // frenando todo el tramo
+  if (minExit2 > exit * exit) {
+    exit = sqrt(minExit2);
+  }
+  float peak = max(v, max(entry, exit));
+  float up = (peak * peak - entry * entry) / (2 * acc);
+  float down = (peak * peak - exit * exit) / (2 * acc);
+  if (up + down > length) {
+    peak = sqrt((2 * acc * length + entry * entry + exit * exit) * 0.5);
+    up = (peak * peak - entry * entry) / (2 * acc);
+    down = length - up;
+  }
+  exitSpeed = exit;
+
+  // Coeficientes en fracción del largo, para no dividir en cada loop()
+  float inv = length > 0 ? 1.0 / length : 0.0;
+  phaseBase[0] = 0.0;
+  phaseSpeed[0] = entry * inv;
+  phaseAccel[0] = 0.5 * acc * inv;
+  phaseBase[1] = up * inv;
+  phaseSpeed[1] = peak * inv;
+  phaseAccel[1] = 0.0;
+  phaseBase[2] = (length - down) * inv;
+  phaseSpeed[2] = peak * inv;
+  phaseAccel[2] = -0.5 * acc * inv;
+
+  float cruiseTime = peak > 0 ? (length - up - down) / peak : 0.0;
+  phaseEndUs[0] = (peak - entry) / acc * 1000000.0;
+  phaseEndUs[1] = phaseEndUs[0] + (unsigned long)(cruiseTime * 1000000.0);
+  phaseEndUs[2] = phaseEndUs[1] + (unsigned long)((peak - exit) / acc * 1000000.0);
+  durationUs = phaseEndUs[2];
+}
+
+// Tramo del trapecio en que cae elapsed (3 si ya terminó) y t en s desde su inicio
+byte Interpolation::profilePhase(unsigned long elapsed, float& t) const {
+  unsigned long phaseStart = 0;
+  for (byte i = 0; i < 3; i++) {
+    if (elapsed < phaseEndUs[i]) {
+      t = (elapsed - phaseStart) * 0.000001;
+      return i;
+    }
+    phaseStart = phaseEndUs[i];
+  }
+  t = 0.0;
+  return 3;
+}
+
+void Interpolation::setExitSpeed(float exit) {
+  if (SPEED_PROFILE != 3 || state != 0 || length <= 0) {
+    return;
+  }
+  unsigned long now = micros();
+  float t;
+  byte phase = profilePhase(now - startTime, t);
+  if (phase == 3) {
+    return; // ya terminó: el próximo loop lo cierra
+  }
+  // Lo que falta se planifica de nuevo desde la posición y velocidad de ahora
+  float progress = phaseBase[phase] + t * (phaseSpeed[phase] + t * phaseAccel[phase]);
+  float speed = (phaseSpeed[phase] + 2 * t * phaseAccel[phase]) * length;
+  xStartmm += progress * xDelta;
+  yStartmm += progress * yDelta;
+  zStartmm += progress * zDelta;
+  eStartmm += progress * eDelta;
+  xDelta = target.xmm - xStartmm;
+  yDelta = target.ymm - yStartmm;
+  zDelta = target.zmm - zStartmm;
+  eDelta = target.emm - eStartmm;
+  length -= progress * length;
+  planProfile(speed, exit);
+  startTime = now;
+}
+
+float Interpolation::getNominalSpeed() const {
+  return v;
+}
+
+float Interpolation::getLength() const {
+  return length;
+}
+
+Point Interpolation::getTargetmm() const {
+  return target;
+}
+
+void Interpolation::getDirection(float dir[4]) const {
+  float n = sqrt(xDelta * xDelta + yDelta * yDelta + zDelta * zDelta + eDelta * eDelta);
+  dir[X_AXIS] = n > 0 ? xDelta / n : 0;
+  dir[Y_AXIS] = n > 0 ? yDelta / n : 0;
+  dir[Z_AXIS] = n > 0 ? zDelta / n : 0;
+  dir[E_AXIS] = n > 0 ? eDelta / n : 0;
 }
 
 void Interpolation::setCurrentPos(Point p) {
@@ -125,40 +272,69 @@ void Interpolation::setCurrentPos(Point p) {
   yDelta = 0;
   zDelta = 0;
   eDelta = 0;
+  target = p;
+  length = 0;
+  endSpeed = 0;
+}
+
+// Interpolación lineal en una tabla de profileTables.h; phase de 0 a 65535
+static unsigned int profileLookup(const uint16_t* table, unsigned int phase) {
+  unsigned int i = phase >> PROFILE_TABLE_SHIFT;
+  unsigned int a = pgm_read_word(table + i);
+  unsigned int b = pgm_read_word(table + i + 1);
+  unsigned long frac = phase & ((1 << PROFILE_TABLE_SHIFT) - 1);
+  return a + (unsigned int)(((b - a) * frac) >> PROFILE_TABLE_SHIFT);
 }
 
 void Interpolation::updateActualPosition() {
   if (state != 0) {
     return;
   }    
-  long microsek = micros();
-  float t = (microsek - startTime) / 1000000.0;
+  unsigned long elapsed = micros() - startTime;
   float progress;
+  unsigned long steps = elapsed >> phaseShift;
+  unsigned int phase = steps < phaseSteps ? (unsigned int)((steps * phaseRate) >> 15) : 0;
   switch (SPEED_PROFILE){
     // FLAT SPEED CURVE
     case 0:
-      progress = t * tmul;
-      if (progress >= 1.0){
+      progress = phase * (1.0 / 65536.0);
+      if (steps >= phaseSteps) {
         progress = 1.0;
         state = 1;
       }
       break;
     // ARCTAN APPROX
     case 1:
-      progress = atan((PI * t * tmul) - (PI * 0.5)) * 0.5 + 0.5;
-      if (progress >= 1.0) {
+      phase = profileLookup(ARCTAN_PROFILE, phase);
+      progress = phase * (1.0 / 65536.0);
+      if (steps >= phaseSteps || phase >= PROFILE_END) {
         progress = 1.0; 
         state = 1;
       }
       break;
     // COSIN APPROX
     case 2:
-      progress = -cos(t * tmul * PI) * 0.5 + 0.5;
-      if ((t * tmul) >= 1.0) {
+      progress = profileLookup(COSIN_PROFILE, phase) * (1.0 / 65536.0);
+      if (steps >= phaseSteps) {
         progress = 1.0; 
         state = 1;
       }
       break;
+    // LOOK-AHEAD TRAPEZOID
+    case 3:
+      {
+        float t;
+        byte part = profilePhase(elapsed, t);
+        if (part == 3) {
+          progress = 1.0;
+          state = 1;
+          endSpeed = exitSpeed;
+          endTime = startTime + durationUs;
+        } else {
+          progress = phaseBase[part] + t * (phaseSpeed[part] + t * phaseAccel[part]);
+        }
+      }
+      break;
   }
   pos_tracker[X_AXIS] = xStartmm + progress * xDelta;
   pos_tracker[Y_AXIS] = yStartmm + progress * yDelta;
@@ -185,6 +361,9 @@ void Interpolation::updateActualPosition() {
     yDelta = 0;
     zDelta = 0;
     eDelta = 0;
+    target = getPosmm();
+    length = 0;
+    endSpeed = 0;
   }
   //FOR DECIPHERING SPEED CURVE
   //Serial.print("xPosmm:");
@@ -13,6 +13,11 @@ struct Point {
   float zmm;
   float emm;
 };
+
+// Largo de un movimiento como lo recorre la interpolación: el mayor entre XYZ y E
+float moveLength(Point p0, Point p1);
+// Velocidad (mm/s) de un movimiento con F = v; sin F se elige según el largo
+float moveNominalSpeed(float dist, float v);
 class Interpolation {
 public:
   //void resetInterpolation(float px, float py, float pz);
@@ -29,6 +34,14 @@ public:
   
   void updateActualPosition();
   bool isFinished() const;
+
+  // SPEED_PROFILE 3: vuelve a planificar lo que falta del movimiento en curso
+  // para terminarlo a exitSpeed (mm/s) en lugar de detenerse
+  void setExitSpeed(float exitSpeed);
+  float getNominalSpeed() const;
+  float getLength() const;
+  Point getTargetmm() const;
+  void getDirection(float dir[4]) const; // unitario en XYZE
   
   float getXPosmm() const;
   float getYPosmm() const;
@@ -41,11 +54,15 @@ public:
   Point getPosOffset() const;
 
 private:
+  void planProfile(float entry, float exit);
+  void planDuration(float seconds);
+  byte profilePhase(unsigned long elapsed, float& t) const;
+
   Point pos_offset;
   float pos_tracker[4];
   byte state;
   
-  long startTime;  
+  unsigned long startTime;  
   
   float xStartmm;
   float yStartmm;
@@ -60,7 +77,26 @@ private:
   float zPosmm;
   float ePosmm;
   float v;
-  float tmul;
+
+  // SPEED_PROFILE 0-2: fase en punto fijo (65536 = fin del movimiento) como
+  // ((micros transcurridos >> phaseShift) * phaseRate) >> 15, sin float
+  unsigned long durationUs;
+  unsigned long phaseSteps; // durationUs >> phaseShift, menos de 65536
+  unsigned long phaseRate;  // 2^31 / phaseSteps
+  byte phaseShift;
+
+  // SPEED_PROFILE 3: trapecio de velocidad sobre el largo del movimiento. En cada
+  // tramo (acelera, crucero, frena) el progreso es
+  // phaseBase + t * (phaseSpeed + t * phaseAccel), con t en s desde su inicio
+  Point target;
+  float length;
+  float exitSpeed;
+  unsigned long phaseEndUs[3];
+  float phaseBase[3];
+  float phaseSpeed[3];
+  float phaseAccel[3];
+  float endSpeed;   // velocidad con que terminó el último movimiento
+  unsigned long endTime;
 };
 
 #endif
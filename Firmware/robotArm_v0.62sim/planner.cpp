@@ -0,0 +1,72 @@
+#include "planner.h"
+#include "config.h"
+#include <Arduino.h>
+
+float junctionSpeed(const float u0[4], const float u1[4]) {
+  float cosTheta = -(u0[X_AXIS] * u1[X_AXIS] + u0[Y_AXIS] * u1[Y_AXIS] + u0[Z_AXIS] * u1[Z_AXIS] + u0[E_AXIS] * u1[E_AXIS]);
+  if (cosTheta > 0.999999) {
+    return 0.0; // vuelve por el mismo camino
+  }
+  if (cosTheta < -0.999999) {
+    return 1e9; // sigue derecho: sólo limitan las velocidades de los movimientos
+  }
+  // Arco tangente a los dos tramos a JUNCTION_DEVIATION del vértice, recorrido
+  // con aceleración centrípeta ACCELERATION
+  float sinHalfTheta = sqrt(0.5 * (1.0 - cosTheta));
+  return sqrt(ACCELERATION * JUNCTION_DEVIATION * sinHalfTheta / (1.0 - sinHalfTheta));
+}
+
+float lookAheadExitSpeed(const Interpolation& interpolator, const Queue<Cmd>& queue, bool isRelativeCoord) {
+  if (SPEED_PROFILE != 3 || interpolator.isFinished() || interpolator.getLength() <= 0) {
+    return 0.0;
+  }
+  // Máxima entrada y largo de cada movimiento en cola, hasta el primer comando que
+  // no es G0/G1 (cambia el modo, el offset o espera con el brazo quieto)
+  float entryMax[QUEUE_SIZE];
+  float length[QUEUE_SIZE];
+  int count = 0;
+  Point from = interpolator.getTargetmm();
+  Point offset = interpolator.getPosOffset();
+  float dir[4];
+  float nextDir[4];
+  interpolator.getDirection(dir);
+  float speed = interpolator.getNominalSpeed();
+  for (int i = 0; i < queue.getUsedSpace() && count < QUEUE_SIZE; i++) {
+    Cmd cmd = queue.peek(i);
+    if (cmd.id != 'G' || (cmd.num != 0 && cmd.num != 1)) {
+      break;
+    }
+    cmdMove(cmd, from, offset, isRelativeCoord);
+    Point to;
+    to.xmm = cmd.valueX;
+    to.ymm = cmd.valueY;
+    to.zmm = cmd.valueZ;
+    to.emm = cmd.valueE;
+    float dist = moveLength(from, to);
+    if (dist <= 0) {
+      break;
+    }
+    float dx = to.xmm - from.xmm, dy = to.ymm - from.ymm, dz = to.zmm - from.zmm, de = to.emm - from.emm;
+    float n = sqrt(dx * dx + dy * dy + dz * dz + de * de);
+    nextDir[X_AXIS] = dx / n;
+    nextDir[Y_AXIS] = dy / n;
+    nextDir[Z_AXIS] = dz / n;
+    nextDir[E_AXIS] = de / n;
+    float nextSpeed = moveNominalSpeed(dist, cmd.valueF);
+    entryMax[count] = min(junctionSpeed(dir, nextDir), min(speed, nextSpeed));
+    length[count] = dist;
+    count++;
+    from = to;
+    for (int a = 0; a < 4; a++) {
+      dir[a] = nextDir[a];
+    }
+    speed = nextSpeed;
+  }
+
+  // De atrás hacia adelante: cada entrada es la que permite frenar a tiempo
+  float exit = 0.0;
+  for (int i = count - 1; i >= 0; i--) {
+    exit = min(entryMax[i], sqrt(exit * exit + 2 * ACCELERATION * length[i]));
+  }
+  return exit; // entrada del primero en cola = salida del movimiento en curso
+}
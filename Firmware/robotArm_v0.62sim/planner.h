@@ -0,0 +1,17 @@
+#ifndef PLANNER_H_
+#define PLANNER_H_
+
+#include "interpolation.h"
+#include "command.h"
+#include "queue.h"
+
+// Máxima velocidad (mm/s) para pasar de la dirección u0 a la u1 sin que la
+// trayectoria se aparte más de JUNCTION_DEVIATION del vértice
+float junctionSpeed(const float u0[4], const float u1[4]);
+
+// SPEED_PROFILE 3: velocidad con que puede terminar el movimiento en curso
+// mirando los G0/G1 que le siguen en la cola, de modo que siempre se pueda
+// frenar al final del último conocido. 0 si no hay movimientos en cola.
+float lookAheadExitSpeed(const Interpolation& interpolator, const Queue<Cmd>& queue, bool isRelativeCoord);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef PROFILE_TABLES_H_
+#define PROFILE_TABLES_H_
+#include <Arduino.h>
+
+// Progreso de SPEED_PROFILE 1 y 2 en punto fijo: entrada k es el progreso (de 0
+// a 65535 = 1) en la fracción k / PROFILE_TABLE_STEPS de la duración del
+// movimiento. Entre entradas se interpola lineal (error menor a 5e-5 del largo).
+// Generadas con:
+//   ARCTAN: atan(PI * k / 128 - PI / 2) * 0.5 + 0.5, recortado a [0, 1]
+//   COSIN:  -cos(PI * k / 128) * 0.5 + 0.5
+#define PROFILE_TABLE_STEPS 128
+#define PROFILE_TABLE_SHIFT 9 // 65536 / PROFILE_TABLE_STEPS = 1 << 9
+#define PROFILE_END 65535
+
+const uint16_t ARCTAN_PROFILE[PROFILE_TABLE_STEPS + 1] PROGMEM = {
+      0,   107,   347,   592,   843,  1100,  1363,  1632,  1907,  2188,  2477,  2772,
+   3074,  3384,  3701,  4026,  4359,  4700,  5049,  5407,  5774,  6149,  6535,  6929,
+   7334,  7748,  8173,  8609,  9055,  9512,  9981, 10460, 10952, 11455, 11971, 12498,
+  13038, 13591, 14156, 14734, 15325, 15928, 16544, 17174, 17815, 18470, 19136, 19815,
+  20506, 21209, 21923, 22647, 23382, 24127, 24881, 25644, 26415, 27193, 27977, 28767,
+  29561, 30360, 31161, 31964, 32768, 33572, 34375, 35176, 35975, 36769, 37559, 38343,
+  39121, 39892, 40655, 41409, 42154, 42889, 43613, 44327, 45030, 45721, 46400, 47066,
+  47721, 48362, 48992, 49608, 50211, 50802, 51380, 51945, 52498, 53038, 53565, 54081,
+  54584, 55076, 55555, 56024, 56481, 56927, 57363, 57788, 58202, 58607, 59001, 59387,
+  59762, 60129, 60487, 60836, 61177, 61510, 61835, 62152, 62462, 62764, 63059, 63348,
+  63629, 63904, 64173, 64436, 64693, 64944, 65189, 65429, 65535
+};
+
+const uint16_t COSIN_PROFILE[PROFILE_TABLE_STEPS + 1] PROGMEM = {
+      0,    10,    39,    89,   158,   246,   355,   482,   630,   796,   982,  1187,
+   1411,  1654,  1915,  2196,  2494,  2811,  3146,  3499,  3869,  4257,  4662,  5084,
+   5522,  5977,  6448,  6935,  7438,  7956,  8489,  9036,  9598, 10173, 10762, 11365,
+  11980, 12608, 13248, 13900, 14563, 15237, 15922, 16617, 17321, 18035, 18758, 19489,
+  20228, 20975, 21729, 22489, 23256, 24028, 24806, 25588, 26375, 27166, 27960, 28757,
+  29556, 30357, 31160, 31964, 32768, 33572, 34376, 35179, 35980, 36779, 37576, 38370,
+  39161, 39948, 40730, 41508, 42280, 43047, 43807, 44561, 45308, 46047, 46778, 47501,
+  48215, 48919, 49614, 50299, 50973, 51636, 52288, 52928, 53556, 54171, 54774, 55363,
+  55938, 56500, 57047, 57580, 58098, 58601, 59088, 59559, 60014, 60452, 60874, 61279,
+  61667, 62037, 62390, 62725, 63042, 63340, 63621, 63882, 64125, 64349, 64554, 64740,
+  64906, 65054, 65181, 65290, 65378, 65447, 65497, 65526, 65535
+};
+
+#endif
@@ -7,6 +7,7 @@ public:
   ~Queue();
   bool push(Element elem);
   Element pop();
+  Element peek(int i) const; // i = 0 es el próximo pop()
   bool isFull() const;
   bool isEmpty() const;
   int getFreeSpace() const;
@@ -52,6 +53,11 @@ Element Queue<Element>::pop() {
   return data[(s) % len];
 }
 
+template <typename Element>
+Element Queue<Element>::peek(int i) const {
+  return data[(start + i) % len];
+}
+
 template <typename Element>
 bool Queue<Element>::isFull() const {
   return count >= len;
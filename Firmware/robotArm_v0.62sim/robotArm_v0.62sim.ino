@@ -34,8 +34,10 @@
 #include "logger.h"
 #include "robotGeometry.h"
 #include "interpolation.h"
+#include "planner.h"
 #include "fanControl.h"
 #include "RampsStepper.h"
+#include "stepGenerator.h"
 #include "queue.h"
 #include "command.h"
 #include "byj_gripper.h"
@@ -44,18 +46,21 @@
 #include "endstop.h"
 
 //STEPPER OBJECTS
-RampsStepper stepperHigher(X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN, INVERSE_X_STEPPER);
-RampsStepper stepperLower(Y_STEP_PIN, Y_DIR_PIN, Y_ENABLE_PIN, INVERSE_Y_STEPPER);
-RampsStepper stepperRotate(Z_STEP_PIN, Z_DIR_PIN, Z_ENABLE_PIN, INVERSE_Z_STEPPER);
+RampsStepperPins<X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN> stepperHigher(INVERSE_X_STEPPER);
+RampsStepperPins<Y_STEP_PIN, Y_DIR_PIN, Y_ENABLE_PIN> stepperLower(INVERSE_Y_STEPPER);
+RampsStepperPins<Z_STEP_PIN, Z_DIR_PIN, Z_ENABLE_PIN> stepperRotate(INVERSE_Z_STEPPER);
+
+//STEP_ISR: PASOS DE TODOS LOS EJES DESDE LA INTERRUPCIÓN DE TIMER2
+StepGenerator stepGenerator;
 
 //RAIL OBJECTS
-RampsStepper stepperRail(E0_STEP_PIN, E0_DIR_PIN, E0_ENABLE_PIN, INVERSE_E0_STEPPER);
-Endstop endstopE0(E0_MIN_PIN, E0_DIR_PIN, E0_STEP_PIN, E0_ENABLE_PIN, E0_MIN_INPUT, E0_HOME_STEPS, HOME_DWELL, E0_CHECK_DELAY);
+RampsStepperPins<E0_STEP_PIN, E0_DIR_PIN, E0_ENABLE_PIN> stepperRail(INVERSE_E0_STEPPER);
+Endstop<E0_MIN_PIN, E0_DIR_PIN, E0_STEP_PIN, E0_ENABLE_PIN> endstopE0(E0_MIN_INPUT, E0_HOME_STEPS, HOME_DWELL, E0_CHECK_DELAY);
 
 //ENDSTOP OBJECTS
-Endstop endstopX(X_MIN_PIN, X_DIR_PIN, X_STEP_PIN, X_ENABLE_PIN, X_MIN_INPUT, X_HOME_STEPS, HOME_DWELL, X_CHECK_DELAY);
-Endstop endstopY(Y_MIN_PIN, Y_DIR_PIN, Y_STEP_PIN, Y_ENABLE_PIN, Y_MIN_INPUT, Y_HOME_STEPS, HOME_DWELL, Y_CHECK_DELAY);
-Endstop endstopZ(Z_MIN_PIN, Z_DIR_PIN, Z_STEP_PIN, Z_ENABLE_PIN, Z_MIN_INPUT, Z_HOME_STEPS, HOME_DWELL, Z_CHECK_DELAY);
+Endstop<X_MIN_PIN, X_DIR_PIN, X_STEP_PIN, X_ENABLE_PIN> endstopX(X_MIN_INPUT, X_HOME_STEPS, HOME_DWELL, X_CHECK_DELAY);
+Endstop<Y_MIN_PIN, Y_DIR_PIN, Y_STEP_PIN, Y_ENABLE_PIN> endstopY(Y_MIN_INPUT, Y_HOME_STEPS, HOME_DWELL, Y_CHECK_DELAY);
+Endstop<Z_MIN_PIN, Z_DIR_PIN, Z_STEP_PIN, Z_ENABLE_PIN> endstopZ(Z_MIN_INPUT, Z_HOME_STEPS, HOME_DWELL, Z_CHECK_DELAY);
 
 //EQUIPMENT OBJECTS
 BYJ_Gripper byj_gripper(BYJ_PIN_0, BYJ_PIN_1, BYJ_PIN_2, BYJ_PIN_3, BYJ_GRIP_STEPS);
@@ -102,6 +107,16 @@ void setup()
   stepperRotate.setPositionRad(0);        // 0°
   stepperRail.setPosition(0);
 
+  if (STEP_ISR) {
+    stepGenerator.attach(stepperRotate);
+    stepGenerator.attach(stepperLower);
+    stepGenerator.attach(stepperHigher);
+    if (RAIL) {
+      stepGenerator.attach(stepperRail);
+    }
+    stepGenerator.begin();
+  }
+
 //******* control de compilacion simplificada, para usar el firmware sólo como gestor de comandos
 #ifndef SIMULATION
   if (HOME_ON_BOOT) { //HOME DURING SETUP() IF HOME_ON_BOOT ENABLED
@@ -144,17 +159,26 @@ void loop() {
   if (RAIL){
     stepperRail.stepToPositionMM(interpolator.getEPosmm(), STEPS_PER_MM_RAIL);
   }
-  stepperRotate.update();
-  stepperLower.update();
-  stepperHigher.update();
-  if (RAIL){
-    stepperRail.update();
+  if (STEP_ISR) {
+    stepGenerator.update();
+  } else {
+    stepperRotate.update();
+    stepperLower.update();
+    stepperHigher.update();
+    if (RAIL){
+      stepperRail.update();
+    }
   }
   fan.update();
 
   if (!queue.isFull()) {
     if (command.handleGcode()) {
       queue.push(command.getCmd());
+      // Un movimiento nuevo en cola puede dejar terminar el actual sin frenar
+      Cmd pushed = command.getCmd();
+      if (pushed.id == 'G' && (pushed.num == 0 || pushed.num == 1)) {
+        interpolator.setExitSpeed(lookAheadExitSpeed(interpolator, queue, command.isRelativeCoord));
+      }
     }
   }
   if ((!queue.isEmpty()) && interpolator.isFinished()) {
@@ -172,6 +196,12 @@ void loop() {
 //  }
 }
 
+#if STEP_ISR && defined(__AVR__)
+ISR(TIMER2_COMPA_vect) {
+  stepGenerator.onTimer();
+}
+#endif
+
 void executeCommand(Cmd cmd) {
 
   if (cmd.id == -1) {
@@ -188,6 +218,7 @@ void executeCommand(Cmd cmd) {
       posoffset = interpolator.getPosOffset();      
       cmdMove(cmd, interpolator.getPosmm(), posoffset, command.isRelativeCoord);
       interpolator.setInterpolation(cmd.valueX, cmd.valueY, cmd.valueZ, cmd.valueE, cmd.valueF);
+      interpolator.setExitSpeed(lookAheadExitSpeed(interpolator, queue, command.isRelativeCoord));
       Logger::logINFO("LINEAR MOVE: [X:" + String(cmd.valueX-posoffset.xmm) + " Y:" + String(cmd.valueY-posoffset.ymm) + " Z:" + String(cmd.valueZ-posoffset.zmm) + " E:" + String(cmd.valueE-posoffset.emm) + "]");
       break;
     case 4: 
@@ -308,6 +339,7 @@ void setStepperEnable(bool enable){
 }
 
 void homeSequence(){
+  stepGenerator.flush(); // los endstops mueven los motores por su cuenta
   setStepperEnable(false);
   fan.enable(true);
   
@@ -358,6 +390,7 @@ void homeSequence(){
 
 //DUE TO UNO CNC SHIELD LIMIT, 1 EN PIN SERVES 3 MOTORS, HENCE DIFFERENT HOMESEQUENCE IS REQUIRED
 void homeSequence_UNO(){
+  stepGenerator.flush();
   if (HOME_Y_STEPPER && HOME_X_STEPPER){
     while (!endstopY.state() || !endstopX.state()){
       endstopY.oneStepToEndstop(!INVERSE_Y_STEPPER);
@@ -1,19 +1,67 @@
 #include "robotGeometry.h"
+#include "config.h"
 
 #include <math.h>
 #include <Arduino.h>
 
+// atan(k / 128) en 1/65536 rad, k de 0 a 128
+static const uint16_t IK_ATAN[129] PROGMEM = {
+      0,   512,  1024,  1536,  2047,  2559,  3070,  3580,  4091,  4600,  5110,  5618,
+   6126,  6633,  7140,  7645,  8150,  8653,  9156,  9657, 10158, 10657, 11155, 11652,
+  12147, 12641, 13133, 13624, 14114, 14601, 15088, 15572, 16055, 16536, 17015, 17492,
+  17968, 18441, 18913, 19382, 19850, 20315, 20779, 21240, 21699, 22156, 22610, 23062,
+  23512, 23960, 24406, 24849, 25289, 25727, 26163, 26597, 27028, 27456, 27882, 28306,
+  28727, 29145, 29561, 29975, 30386, 30794, 31200, 31603, 32003, 32401, 32797, 33190,
+  33580, 33968, 34353, 34735, 35115, 35492, 35867, 36239, 36608, 36975, 37340, 37701,
+  38060, 38417, 38771, 39123, 39472, 39818, 40162, 40503, 40842, 41178, 41512, 41844,
+  42172, 42499, 42823, 43145, 43464, 43780, 44095, 44407, 44716, 45024, 45328, 45631,
+  45931, 46229, 46525, 46818, 47109, 47398, 47685, 47969, 48251, 48531, 48809, 49085,
+  49359, 49630, 49899, 50167, 50432, 50695, 50956, 51215, 51472
+};
+
+// atan2 sin atan() de float: el cociente del menor sobre el mayor se busca en
+// IK_ATAN (interpolando, error menor a 1.5e-5 rad) y el octante sale de los signos
+static float tableAtan2(float y, float x) {
+  float ay = fabs(y);
+  float ax = fabs(x);
+  if (ay == 0 && ax == 0) {
+    return 0.0;
+  }
+  float k = (ay < ax ? ay / ax : ax / ay) * 128; // 0 a 128
+  byte i = k;
+  float a = pgm_read_word(IK_ATAN + i);
+  if (i < 128) {
+    a += (pgm_read_word(IK_ATAN + i + 1) - a) * (k - i);
+  }
+  a *= 1.0 / 65536.0;
+  if (ay > ax) {
+    a = PI * 0.5 - a;
+  }
+  if (x < 0) {
+    a = PI - a;
+  }
+  return y < 0 ? -a : a;
+}
+
 RobotGeometry::RobotGeometry(float a_ee_offset, float a_low_shank_length, float a_high_shank_length) {
   ee_offset = a_ee_offset;
   low_shank_length = a_low_shank_length;
   high_shank_length = a_high_shank_length;
+  xmm = ymm = zmm = 0.0;
+  rot = low = high = 0.0;
+  solved = false;
 }
 
 void RobotGeometry::set(float axmm, float aymm, float azmm) {
+  // loop() lo llama en cada vuelta: sólo se resuelve si cambió el destino
+  if (solved && axmm == xmm && aymm == ymm && azmm == zmm) {
+    return;
+  }
   xmm = axmm;
   ymm = aymm;
   zmm = azmm; 
   calculateGrad();
+  solved = true;
 }
 
 float RobotGeometry::getXmm() const {
@@ -41,6 +89,9 @@ float RobotGeometry::getHighRad() const {
 }
 
 void RobotGeometry::calculateGrad() {
+   if (TABLE_IK && calculateGradTable()) {
+     return;
+   }
    float rrot_ee =  hypot(xmm, ymm);    
    float rrot = rrot_ee - ee_offset; //radius from Top View
    float rside = hypot(rrot, zmm);  //radius from Side View. Use rrot instead of ymm..for everything
@@ -59,3 +110,37 @@ void RobotGeometry::calculateGrad() {
    }
    high = high + low;
 }
+
+// Lo mismo que calculateGrad con dos sqrt y tableAtan2: cada asin/acos es un
+// atan2 de catetos que ya se tienen, y el seno de los ángulos del triángulo de
+// los brazos sale de su área (Herón) sin calcular rside. Devuelve false fuera
+// de alcance, donde calculateGrad sigue en float como antes.
+bool RobotGeometry::calculateGradTable() {
+  float rrot_ee = sqrt(xmm * xmm + ymm * ymm);
+  if (rrot_ee == 0) {
+    return false;
+  }
+  float rrot = rrot_ee - ee_offset; //radius from Top View
+  float rside_2 = rrot * rrot + zmm * zmm; //radius from Side View, al cuadrado
+  float low_2 = sq(low_shank_length);
+  float high_2 = sq(high_shank_length);
+
+  // 2 * low * high * sin(codo) = 2 * low * rside * sin(hombro) = 4 * área
+  float outer = sq(low_shank_length + high_shank_length) - rside_2;
+  float inner = rside_2 - sq(low_shank_length - high_shank_length);
+  if (!(outer > 0 && inner > 0)) {
+    return false;
+  }
+  float area4 = sqrt(outer * inner);
+  float elbow = tableAtan2(area4, low_2 + high_2 - rside_2);
+  float shoulder = tableAtan2(area4, low_2 - high_2 + rside_2);
+
+  rot = tableAtan2(xmm, fabs(ymm));
+  if (zmm > 0) {
+    low = tableAtan2(fabs(rrot), zmm) - shoulder;
+  } else {
+    low = PI - tableAtan2(rrot, -zmm) - shoulder;
+  }
+  high = PI - elbow + low;
+  return true;
+}
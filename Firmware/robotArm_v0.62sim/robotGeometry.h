@@ -13,6 +13,7 @@ public:
   float getHighRad() const;
 private:
   void calculateGrad();
+  bool calculateGradTable();
   float ee_offset;
   float low_shank_length;
   float high_shank_length;
@@ -22,6 +23,7 @@ private:
   float rot;
   float low;
   float high;
+  bool solved; // rot, low y high corresponden a xmm, ymm, zmm
 };
 
 #endif
@@ -0,0 +1,149 @@
+#include "stepGenerator.h"
+
+StepGenerator::StepGenerator() {
+  axisCount = 0;
+  head = tail = 0;
+  lastUpdate = 0;
+  count = remaining = 0;
+  interval = wait = 0;
+  for (byte a = 0; a < STEP_MAX_AXES; a++) {
+    axes[a] = 0;
+    delta[a] = error[a] = 0;
+  }
+}
+
+void StepGenerator::attach(RampsStepper& stepper) {
+  if (axisCount < STEP_MAX_AXES) {
+    axes[axisCount++] = &stepper;
+  }
+}
+
+void StepGenerator::begin() {
+  lastUpdate = micros();
+#if defined(__AVR__)
+  noInterrupts();
+  TCCR2A = _BV(WGM21); // CTC con OCR2A
+  TCCR2B = _BV(CS22);  // prescaler 64
+  TCNT2 = 0;
+  setTimer(STEP_IDLE_TICKS);
+  TIMSK2 |= _BV(OCIE2A);
+  interrupts();
+#endif
+}
+
+void StepGenerator::setTimer(unsigned int ticks) {
+  wait = ticks;
+  armTimer();
+}
+
+// Próximo tramo de la espera. Un resto corto se junta con el tramo anterior
+// para no programar un OCR2A que el contador ya pasó.
+void StepGenerator::armTimer() {
+  unsigned int ticks = wait;
+  if (ticks > 2 * STEP_TIMER_MAX) {
+    ticks = STEP_TIMER_MAX;
+  } else if (ticks > STEP_TIMER_MAX) {
+    ticks /= 2;
+  }
+  wait -= ticks;
+#if defined(__AVR__)
+  OCR2A = ticks - 1;
+#endif
+}
+
+void StepGenerator::update() {
+  unsigned long now = micros();
+  byte next = (tail + 1) % STEP_QUEUE_SIZE;
+  if (next == head) {
+    return;
+  }
+  Segment& s = segments[tail];
+  unsigned int most = 0;
+  for (byte a = 0; a < axisCount; a++) {
+    s.steps[a] = axes[a]->takeSteps();
+    unsigned int n = abs(s.steps[a]);
+    if (n > most) {
+      most = n;
+    }
+  }
+  unsigned long duration = now - lastUpdate;
+  lastUpdate = now;
+  if (most == 0) {
+    return;
+  }
+  // Los pasos de esta vuelta se reparten en lo que tardó, que es lo que tardará la próxima
+  if (duration > STEP_SEGMENT_MAX_US) {
+    duration = STEP_SEGMENT_MAX_US;
+  }
+  unsigned long ticks = duration * (STEP_TIMER_HZ / 1000L) / 1000L / most;
+  if (ticks < STEP_TIMER_HZ / MAX_STEP_RATE) {
+    ticks = STEP_TIMER_HZ / MAX_STEP_RATE;
+  }
+  if (ticks > 65535) {
+    ticks = 65535;
+  }
+  s.count = most;
+  s.interval = ticks;
+  // segments[] no es volatile: el segmento tiene que quedar escrito antes de publicarlo
+  __asm__ __volatile__("" ::: "memory");
+  tail = next;
+#if !defined(__AVR__)
+  flush(); // sin Timer2 (ESP8266) salen enseguida, como con RampsStepper::update()
+#endif
+}
+
+bool StepGenerator::isIdle() const {
+  // remaining es de dos bytes en AVR: se lee sin que la interrupción lo cambie a medias
+  noInterrupts();
+  bool idle = head == tail && remaining == 0;
+  interrupts();
+  return idle;
+}
+
+void StepGenerator::flush() {
+#if defined(__AVR__)
+  while (!isIdle()) {
+  }
+#else
+  while (!isIdle()) {
+    onTimer();
+  }
+#endif
+}
+
+void StepGenerator::onTimer() {
+  if (wait > 0) {
+    armTimer();
+    return;
+  }
+  if (remaining == 0) {
+    if (head == tail) {
+      setTimer(STEP_IDLE_TICKS);
+      return;
+    }
+    // El segmento se lee después de ver que update() lo publicó
+    __asm__ __volatile__("" ::: "memory");
+    const Segment& s = segments[head];
+    count = s.count;
+    for (byte a = 0; a < axisCount; a++) {
+      delta[a] = abs(s.steps[a]);
+      error[a] = count / 2;
+      if (delta[a] > 0) {
+        axes[a]->setDirection(s.steps[a] > 0);
+      }
+    }
+    interval = s.interval;
+    head = (head + 1) % STEP_QUEUE_SIZE;
+    remaining = count;
+  }
+  // Un paso del eje dominante; cada otro eje da delta pasos cada count
+  for (byte a = 0; a < axisCount; a++) {
+    error[a] += delta[a];
+    if (error[a] >= count) {
+      error[a] -= count;
+      axes[a]->step();
+    }
+  }
+  remaining--;
+  setTimer(interval);
+}
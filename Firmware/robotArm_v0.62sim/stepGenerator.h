@@ -0,0 +1,55 @@
+#ifndef STEPGENERATOR_H_
+#define STEPGENERATOR_H_
+#include <Arduino.h>
+#include "config.h"
+#include "RampsStepper.h"
+
+#define STEP_MAX_AXES 4
+#define STEP_TIMER_HZ (F_CPU / 64) // Timer2 con prescaler 64: 4 us por tick a 16 MHz
+#define STEP_TIMER_MAX 256         // Timer2 es de 8 bits: las esperas más largas van en tramos
+#define STEP_IDLE_TICKS 50         // cada cuánto mira la cola cuando no tiene pasos
+
+// STEP_ISR: los pasos que loop() pide a los motores en una vuelta forman un
+// segmento; la interrupción de Timer2 (Servo usa Timer1, y en MEGA también
+// 3, 4 y 5) los da repartidos en el tiempo que tardó
+// esa vuelta (a lo sumo MAX_STEP_RATE pasos/s en el eje que más se mueve) y
+// los demás ejes avanzan con Bresenham, juntos con el dominante.
+class StepGenerator {
+public:
+  StepGenerator();
+  void attach(RampsStepper& stepper);
+  void begin();
+
+  // Desde loop(), después de stepToPosition*: pasa a la cola lo que cambiaron
+  // los targets. Con la cola llena no hace nada y los pasos quedan para la próxima.
+  void update();
+  bool isIdle() const;
+  void flush(); // espera a que se hayan dado todos los pasos en cola
+
+  void onTimer(); // desde ISR(TIMER2_COMPA_vect)
+private:
+  struct Segment {
+    int steps[STEP_MAX_AXES];
+    unsigned int count;    // pasos del eje que más se mueve
+    unsigned int interval; // ticks entre pasos
+  };
+  void setTimer(unsigned int ticks);
+  void armTimer();
+
+  RampsStepper* axes[STEP_MAX_AXES];
+  byte axisCount;
+  Segment segments[STEP_QUEUE_SIZE];
+  volatile byte head; // próximo segmento de la interrupción
+  volatile byte tail; // próximo lugar libre para update()
+  unsigned long lastUpdate;
+
+  // Segmento en curso, sólo lo toca la interrupción
+  unsigned int delta[STEP_MAX_AXES];
+  unsigned int error[STEP_MAX_AXES];
+  unsigned int count;
+  unsigned int interval; // ticks entre pasos del segmento en curso
+  unsigned int wait;     // ticks que faltan de la espera, después del tramo programado
+  volatile unsigned int remaining;
+};
+
+#endif
@@ -0,0 +1,171 @@
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+//
+// Minimal header-only microbenchmark harness for the XmlRpc++ core.
+//
+// Each benchmark is a callable run in a loop. The iteration count is
+// calibrated so one sample takes about minTime seconds; several samples are
+// taken and the median and minimum time per operation are reported, as a
+// text table or as one JSON object per line (--json) for comparing runs.
+//
+
+#ifndef MAKEDEPEND
+# include <algorithm>
+# include <chrono>
+# include <functional>
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <string>
+# include <vector>
+#endif
+
+namespace bench {
+
+  //! Keep the compiler from optimizing away a value that is otherwise unused
+  template <class T>
+  inline void doNotOptimize(T const& value)
+  {
+#if defined(__GNUC__)
+    __asm__ __volatile__("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+  }
+
+  //! Measurements of one benchmark
+  struct Result {
+    std::string name;
+    long iterations;          //!< per sample
+    double nsPerOpMedian;
+    double nsPerOpMin;
+    double bytesPerOp;        //!< 0 if not meaningful
+  };
+
+  //! Registers benchmarks and runs the ones selected on the command line
+  class Runner {
+  public:
+    typedef std::function<void(long iterations)> Body;
+
+    Runner() : _minTime(0.2), _samples(5), _json(false) {}
+
+    //! Add a benchmark. body runs the operation 'iterations' times;
+    //! bytesPerOp (input or output size) enables a throughput column.
+    void add(std::string const& name, Body body, double bytesPerOp = 0.0)
+    {
+      Entry e;
+      e.name = name;
+      e.body = body;
+      e.bytesPerOp = bytesPerOp;
+      _entries.push_back(e);
+    }
+
+    //! Parse --json, --filter=substr, --min-time=seconds and --samples=n.
+    //! Returns false (after printing usage) on an unknown option.
+    bool parseArgs(int argc, char* argv[])
+    {
+      for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (strcmp(a, "--json") == 0)
+          _json = true;
+        else if (strncmp(a, "--filter=", 9) == 0)
+          _filter = a + 9;
+        else if (strncmp(a, "--min-time=", 11) == 0)
+          _minTime = atof(a + 11);
+        else if (strncmp(a, "--samples=", 10) == 0)
+          _samples = std::max(1, atoi(a + 10));
+        else {
+          fprintf(stderr, "Usage: %s [--json] [--filter=substr] [--min-time=seconds] [--samples=n]\n", argv[0]);
+          return false;
+        }
+      }
+      return true;
+    }
+
+    //! Run the selected benchmarks, printing each result as it completes
+    std::vector<Result> run()
+    {
+      std::vector<Result> results;
+      if ( ! _json)
+        printf("%-32s %12s %14s %14s %12s\n", "benchmark", "iterations", "ns/op (med)", "ns/op (min)", "MB/s");
+
+      for (size_t i = 0; i < _entries.size(); ++i) {
+        Entry& e = _entries[i];
+        if ( ! _filter.empty() && e.name.find(_filter) == std::string::npos)
+          continue;
+
+        Result r = measure(e);
+        results.push_back(r);
+        print(r);
+      }
+      return results;
+    }
+
+  private:
+    struct Entry {
+      std::string name;
+      Body body;
+      double bytesPerOp;
+    };
+
+    static double seconds(long iterations, Body& body)
+    {
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      body(iterations);
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    Result measure(Entry& e)
+    {
+      // Grow the iteration count until a sample takes long enough to time reliably
+      long n = 1;
+      double t = seconds(n, e.body);
+      while (t < _minTime && n < (1L << 40)) {
+        double scale = (t > 0.0) ? 1.4 * _minTime / t : 100.0;
+        n = std::max(n + 1, long(n * std::min(scale, 100.0)));
+        t = seconds(n, e.body);
+      }
+
+      std::vector<double> perOp;
+      perOp.push_back(t / n);
+      for (int s = 1; s < _samples; ++s)
+        perOp.push_back(seconds(n, e.body) / n);
+      std::sort(perOp.begin(), perOp.end());
+
+      Result r;
+      r.name = e.name;
+      r.iterations = n;
+      r.nsPerOpMedian = 1e9 * perOp[perOp.size() / 2];
+      r.nsPerOpMin = 1e9 * perOp.front();
+      r.bytesPerOp = e.bytesPerOp;
+      return r;
+    }
+
+    void print(Result const& r)
+    {
+      double mbs = (r.bytesPerOp > 0.0) ? r.bytesPerOp / r.nsPerOpMedian * 1e9 / 1e6 : 0.0;
+      if (_json)
+        printf("{\"name\":\"%s\",\"iterations\":%ld,\"ns_per_op\":%.2f,\"ns_per_op_min\":%.2f,"
+               "\"bytes_per_op\":%.0f,\"mb_per_s\":%.2f}\n",
+               r.name.c_str(), r.iterations, r.nsPerOpMedian, r.nsPerOpMin, r.bytesPerOp, mbs);
+      else if (r.bytesPerOp > 0.0)
+        printf("%-32s %12ld %14.1f %14.1f %12.1f\n", r.name.c_str(), r.iterations,
+               r.nsPerOpMedian, r.nsPerOpMin, mbs);
+      else
+        printf("%-32s %12ld %14.1f %14.1f %12s\n", r.name.c_str(), r.iterations,
+               r.nsPerOpMedian, r.nsPerOpMin, "-");
+      fflush(stdout);
+    }
+
+    std::vector<Entry> _entries;
+    std::string _filter;
+    double _minTime;
+    int _samples;
+    bool _json;
+  };
+
+} // namespace bench
+
+#endif // _BENCH_H_
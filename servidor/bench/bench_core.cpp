@@ -0,0 +1,200 @@
+/* bench_core.cpp : microbenchmarks del nucleo XMLRPC (XmlRpcValue, XmlRpcUtil, XmlRpcDispatch).
+   Uso: bench_core [--json] [--filter=texto] [--min-time=segundos] [--samples=n]
+
+   Los corpus se generan de forma deterministica, asi los resultados de dos
+   corridas (o dos versiones del codigo) son comparables.
+*/
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "XmlRpc.h"
+#include "XmlRpcDispatch.h"
+#include "XmlRpcSocket.h"
+#include "XmlRpcSource.h"
+using namespace XmlRpc;
+
+#include "bench.h"
+
+
+// Generador pseudoaleatorio fijo (LCG) para los corpus
+static unsigned semilla = 12345u;
+static unsigned aleatorio() {
+  semilla = semilla * 1103515245u + 12345u;
+  return (semilla >> 8) & 0xffffff;
+}
+
+
+// Struct chico, como el resultado de getPosition
+static XmlRpcValue structChico() {
+  XmlRpcValue v;
+  v["ok"] = XmlRpcValue(true);
+  v["mode"] = "ABS";
+  v["x"] = 100.25;
+  v["y"] = -12.5;
+  v["z"] = 48.0;
+  v["e"] = 0.0;
+  v["motorsEnabled"] = XmlRpcValue(true);
+  v["fanEnabled"] = XmlRpcValue(false);
+  v["message"] = "Posición obtenida";
+  return v;
+}
+
+
+// Arreglo de 10k elementos mezclando enteros, reales y cadenas
+static XmlRpcValue arreglo10k() {
+  XmlRpcValue v;
+  v.setSize(10000);
+  for (int i = 0; i < 10000; ++i) {
+    switch (i % 3) {
+      case 0: v[i] = int(aleatorio()) - 8000000; break;
+      case 1: v[i] = double(aleatorio()) / 4096.0; break;
+      case 2: v[i] = "punto_" + std::to_string(i); break;
+    }
+  }
+  return v;
+}
+
+
+// Bloque binario de 1 MiB
+static XmlRpcValue blob1MiB() {
+  std::vector<char> datos(1 << 20);
+  for (size_t i = 0; i < datos.size(); ++i)
+    datos[i] = char(aleatorio());
+  return XmlRpcValue(&datos[0], int(datos.size()));
+}
+
+
+// Parametros de un system.multicall con 200 llamadas de estructuras anidadas
+static XmlRpcValue multicallProfundo() {
+  XmlRpcValue calls;
+  calls.setSize(200);
+  for (int i = 0; i < 200; ++i) {
+    XmlRpcValue anidado = structChico();
+    for (int d = 0; d < 8; ++d) {
+      XmlRpcValue nivel;
+      nivel["depth"] = d;
+      nivel["child"] = anidado;
+      nivel["path"][0] = double(i);
+      nivel["path"][1] = double(d);
+      anidado = nivel;
+    }
+    calls[i]["methodName"] = (i % 2) ? "move" : "getPosition";
+    calls[i]["params"][0] = anidado;
+  }
+  return calls;
+}
+
+
+// 64 KiB de texto: con caracteres a escapar cada tanto, o sin ninguno
+static std::string texto64k(bool conMarcado) {
+  const char* especiales = "<>&'\"";
+  std::string s;
+  s.reserve(1 << 16);
+  while (s.size() < (1u << 16)) {
+    unsigned r = aleatorio();
+    if (conMarcado && r % 10 == 0)
+      s += especiales[r % 5];
+    else
+      s += char('a' + r % 26);
+  }
+  return s;
+}
+
+
+// Mide toXml y fromXml de un valor
+static void valor(bench::Runner& runner, const std::string& nombre, XmlRpcValue v) {
+  std::string xml = v.toXml();
+  runner.add("value/" + nombre + "/toXml", [v](long n) {
+    for (long i = 0; i < n; ++i) {
+      std::string s = v.toXml();
+      bench::doNotOptimize(s);
+    }
+  }, double(xml.size()));
+  runner.add("value/" + nombre + "/fromXml", [xml](long n) {
+    for (long i = 0; i < n; ++i) {
+      int offset = 0;
+      XmlRpcValue r;
+      bench::doNotOptimize(r.fromXml(xml, &offset));
+    }
+  }, double(xml.size()));
+}
+
+
+// Fuente que descarta lo que llega, para medir un ciclo del dispatcher
+class FuenteEco : public XmlRpcSource {
+public:
+  FuenteEco(int fd) : XmlRpcSource(fd) {}
+  unsigned handleEvent(unsigned) {
+    std::string s;
+    bool eof;
+    XmlRpcSocket::nbRead(getfd(), s, &eof);
+    return XmlRpcDispatch::ReadableEvent;
+  }
+};
+
+
+// Un ciclo de work(): un evento listo entre 'inactivas' fuentes sin actividad
+static void dispatcher(bench::Runner& runner, int inactivas) {
+  runner.add("dispatch/work/" + std::to_string(inactivas) + "_idle", [inactivas](long n) {
+    XmlRpcDispatch disp;
+    std::vector<int> fds;
+    std::vector<FuenteEco*> fuentes;
+    for (int i = 0; i <= inactivas; ++i) {
+      int par[2];
+      if ( ! XmlRpcSocket::socketPair(par)) return;
+      fds.push_back(par[0]);
+      fds.push_back(par[1]);
+      fuentes.push_back(new FuenteEco(par[0]));
+      disp.addSource(fuentes.back(), XmlRpcDispatch::ReadableEvent);
+    }
+    int activa = fds[1];
+    for (long i = 0; i < n; ++i) {
+      XmlRpcSocket::sendByte(activa);
+      disp.work(0.0);
+    }
+    disp.clear();
+    for (size_t i = 0; i < fuentes.size(); ++i)
+      delete fuentes[i];
+    for (size_t i = 1; i < fds.size(); i += 2)
+      XmlRpcSocket::close(fds[i]);
+  });
+}
+
+
+int main(int argc, char* argv[])
+{
+  bench::Runner runner;
+  if ( ! runner.parseArgs(argc, argv))
+    return -1;
+
+  XmlRpc::setVerbosity(0);
+
+  valor(runner, "small_struct", structChico());
+  valor(runner, "array_10k", arreglo10k());
+  valor(runner, "base64_1MiB", blob1MiB());
+  valor(runner, "multicall_200x8", multicallProfundo());
+
+  std::string marcado = texto64k(true);
+  std::string plano = texto64k(false);
+  std::string codificado = XmlRpcUtil::xmlEncode(marcado);
+
+  runner.add("util/xmlEncode/markup_64k", [marcado](long n) {
+    for (long i = 0; i < n; ++i) bench::doNotOptimize(XmlRpcUtil::xmlEncode(marcado));
+  }, double(marcado.size()));
+  runner.add("util/xmlEncode/plain_64k", [plano](long n) {
+    for (long i = 0; i < n; ++i) bench::doNotOptimize(XmlRpcUtil::xmlEncode(plano));
+  }, double(plano.size()));
+  runner.add("util/xmlDecode/markup_64k", [codificado](long n) {
+    for (long i = 0; i < n; ++i) bench::doNotOptimize(XmlRpcUtil::xmlDecode(codificado));
+  }, double(codificado.size()));
+  runner.add("util/xmlDecode/plain_64k", [plano](long n) {
+    for (long i = 0; i < n; ++i) bench::doNotOptimize(XmlRpcUtil::xmlDecode(plano));
+  }, double(plano.size()));
+
+  dispatcher(runner, 0);
+  dispatcher(runner, 64);
+
+  runner.run();
+  return 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include "Robot.h"
+#include "../lib/XmlRpcSource.h"
+
+namespace RPCServer {
+
+// Lo que el proceso saliente entrega al nuevo
+struct HandoffState {
+    std::vector<int> listeners;   // sockets en escucha del servidor, el puerto principal primero
+    std::vector<int> connections; // conexiones keep-alive sin pedido en curso
+    int controlFd = -1;           // socket de control, para el reinicio siguiente
+    SerialHandoff serial;         // puerto serie abierto (fd -1 si el robot no estaba conectado)
+};
+
+/**
+ * @brief Reinicio en caliente: el proceso nuevo hereda los sockets y el puerto serie.
+ *
+ * El servidor en ejecución escucha en un socket unix de control. Un proceso nuevo
+ * arrancado con la misma ruta se conecta; el viejo deja de aceptar conexiones,
+ * termina los pedidos en curso y le pasa (SCM_RIGHTS) los sockets en escucha, las
+ * conexiones keep-alive, el socket de control y el puerto serie abierto. Las
+ * conexiones nuevas esperan en la cola de accept mientras tanto: ningún cliente
+ * es rechazado ni desconectado, y el robot no se reinicia.
+ *
+ * Cada mensaje lleva una línea por descriptor ("listen", "conn", "control",
+ * "serial <baud> <absoluto> <motores> <fan> <puerto>"); el último es "end".
+ */
+class HotRestart {
+public:
+    // Proceso nuevo: si hay un servidor escuchando en path le pide sus descriptores,
+    // esperando hasta timeoutMs a que termine lo pendiente. false si no hay ninguno.
+    static bool takeOver(const std::string& path, HandoffState& state, int timeoutMs);
+
+    // Crea el socket de control en path (reemplaza el archivo de un servidor que ya
+    // no corre). Devuelve -1 si falla o si otro servidor lo está usando.
+    static int listen(const std::string& path);
+
+    // Proceso saliente: entrega los descriptores por la conexión de control
+    static bool handOver(int fd, const HandoffState& state);
+};
+
+/**
+ * @brief Socket de control en el dispatcher del servidor: acepta el pedido del
+ * proceso nuevo y lo informa con la conexión aceptada.
+ */
+class HandoffListener : public XmlRpc::XmlRpcSource {
+    std::function<void(int)> onRequest_;
+public:
+    HandoffListener(int fd, std::function<void(int)> onRequest)
+      : XmlRpc::XmlRpcSource(fd), onRequest_(std::move(onRequest)) {}
+    unsigned handleEvent(unsigned eventType) override;
+};
+
+} // namespace RPCServer
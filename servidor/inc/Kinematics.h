@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Workspace.h"
+#include "WorkerPool.h"
+
+namespace RPCServer {
+
+class ReachabilityGrid;
+
+// Ángulos de los motores en radianes, como RobotGeometry::getRotRad/getLowRad/getHighRad
+struct JointAngles {
+    float rot = 0;
+    float low = 0;
+    float high = 0;
+};
+
+// Puntos cartesianos en estructura de arreglos (mm): x[i], y[i], z[i], e[i]
+struct PointBatch {
+    std::vector<float> x, y, z, e;
+
+    size_t size() const { return x.size(); }
+    void resize(size_t n) { x.resize(n); y.resize(n); z.resize(n); e.resize(n, 0.0f); }
+};
+
+// Resultado de un lote; los ángulos de un punto inalcanzable quedan en 0
+struct JointBatch {
+    std::vector<float> rot, low, high;
+    std::vector<uint8_t> reachable;
+    size_t reachableCount = 0;
+
+    size_t size() const { return rot.size(); }
+};
+
+/**
+ * @brief Cinemática inversa del brazo en el servidor.
+ *
+ * solve() es RobotGeometry::calculateGrad del firmware tal cual, para un punto.
+ * solveBatch() calcula lo mismo para miles de puntos: recorre los arreglos en
+ * bloques fijos, sin saltos y con asin/acos polinómicos propios para que el
+ * compilador use SIMD, y reparte los lotes grandes en el WorkerPool. Difiere de
+ * solve() en menos de 5e-4 rad, lo mismo que solve() del cálculo en double
+ * (acos cerca de 1 amplifica el redondeo) y menos de un micropaso.
+ *
+ * Un punto es alcanzable si está dentro del espacio de trabajo del firmware
+ * (ArmGeometry::isAllowedPosition) y sus tres ángulos son números.
+ */
+class InverseKinematics {
+public:
+    explicit InverseKinematics(const ArmGeometry& geometry = ArmGeometry());
+
+    // Sin pool los lotes se calculan en el hilo que llama
+    void setPool(WorkerPool* pool) { pool_ = pool; }
+    // solve() consulta la grilla en lugar de la cuenta exacta del espacio de trabajo
+    void setGrid(const ReachabilityGrid* grid) { grid_ = grid; }
+    const ArmGeometry& getGeometry() const { return geometry_; }
+
+    // Devuelve si el punto es alcanzable; angles se completa igual
+    bool solve(float x, float y, float z, float e, JointAngles& angles) const;
+
+    void solveBatch(const PointBatch& points, JointBatch& joints) const;
+
+private:
+    void solveRange(const PointBatch& points, JointBatch& joints, size_t from, size_t to) const;
+
+    ArmGeometry geometry_;
+    WorkerPool* pool_ = nullptr;
+    const ReachabilityGrid* grid_ = nullptr;
+};
+
+} // namespace RPCServer
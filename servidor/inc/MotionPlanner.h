@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "Workspace.h"
+
+namespace RPCServer {
+
+// Límites de SPEED_PROFILE 3; los de Firmware/robotArm_v0.62sim/config.h
+struct MotionLimits {
+    float acceleration = 400.0f;      // ACCELERATION (mm/s^2)
+    float junctionDeviation = 0.05f;  // JUNCTION_DEVIATION (mm)
+    int queueSize = 15;               // QUEUE_SIZE: movimientos que el firmware puede ver adelante
+};
+
+// moveLength y moveNominalSpeed de interpolation.cpp: el largo es el mayor entre
+// XYZ y E, y sin F (o con menos de 5 mm/s) la velocidad depende del largo
+float moveLength(const MoveSegment& move);
+float moveNominalSpeed(float dist, float feed);
+
+// Tiempo de ciclo de un programa (segundos) con cada forma de planificar
+struct CycleTimeReport {
+    size_t commands = 0;
+    size_t segments = 0;          // movimientos G0/G1
+    size_t chains = 0;            // tramos de movimientos seguidos que pueden enlazarse
+    double pathMm = 0;
+    double dwellSeconds = 0;      // G4, sumado a todos los tiempos
+    double cosineSeconds = 0;     // SPEED_PROFILE 2: cada movimiento en dist / v, parando en cada vértice
+    double cosinePeakAcceleration = 0; // la mayor que exige el perfil coseno (mm/s^2)
+    double stopSeconds = 0;       // trapecio con ACCELERATION parando en cada vértice
+    int horizon = 1;              // movimientos en cola que ve el firmware
+    double lookAheadSeconds = 0;  // SPEED_PROFILE 3 con esa cola
+    double queueSeconds = 0;      // con la cola llena (QUEUE_SIZE)
+    double unlimitedSeconds = 0;  // viendo el programa entero
+    double elapsedMs = 0;
+};
+
+/**
+ * @brief Planificador con anticipación del firmware (SPEED_PROFILE 3) en el servidor.
+ *
+ * Reproduce los movimientos del programa como ProgramValidator y calcula las
+ * velocidades de paso entre ellos como lookAheadExitSpeed de planner.cpp: el
+ * límite de desvío en la esquina (junctionSpeed), el F de los dos movimientos y
+ * lo que permite frenar antes del último movimiento a la vista. Cada movimiento
+ * es un trapecio de aceleración constante (Interpolation::planProfile).
+ *
+ * El firmware sólo ve lo que hay en su cola. runProgram envía una línea por
+ * "OK" y el firmware responde al empezar cada comando, así que la cola tiene un
+ * movimiento por delante (horizonte 1); con más horizonte se ve cuánto se ganaría
+ * enviando más líneas adelantadas. No se cuenta el tiempo de G28.
+ */
+class MotionPlanner {
+public:
+    explicit MotionPlanner(const ArmGeometry& geometry = ArmGeometry(),
+                           const MotionLimits& limits = MotionLimits());
+
+    const ArmGeometry& getGeometry() const { return geometry_; }
+    const MotionLimits& getLimits() const { return limits_; }
+
+    // horizon se limita a [1, queueSize]
+    CycleTimeReport estimate(const ProgramCommand* begin, const ProgramCommand* end,
+                             const ReplayState& start, int horizon = 1) const;
+
+    // Máxima velocidad (mm/s) para pasar de la dirección unitaria u0 a la u1
+    float junctionSpeed(const float u0[4], const float u1[4]) const;
+    // Duración del trapecio de un movimiento, con entry y exit ajustados como en el firmware
+    float profileTime(float length, float speed, float entry, float exit) const;
+
+private:
+    struct Move {
+        float length;
+        float speed;     // nominal, moveNominalSpeed del firmware
+        float entryMax;  // 0 si empieza parado
+    };
+
+    // Velocidad de salida de cada movimiento viendo hasta horizon movimientos adelante
+    // (0 = todos)
+    void exitSpeeds(const std::vector<Move>& moves, size_t horizon, std::vector<float>& exits) const;
+    double chainTime(const std::vector<Move>& moves, const std::vector<float>& exits) const;
+
+    ArmGeometry geometry_;
+    MotionLimits limits_;
+};
+
+} // namespace RPCServer
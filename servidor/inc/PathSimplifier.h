@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "ProgramStore.h"
+#include "Workspace.h"
+
+namespace RPCServer {
+
+struct SimplifyReport {
+    float tolerance = 0;
+    size_t commandsBefore = 0;
+    size_t commandsAfter = 0;
+    size_t movesBefore = 0;       // G0/G1
+    size_t movesAfter = 0;
+    size_t serialBytesBefore = 0; // líneas de Robot::execute con "\r\n"
+    size_t serialBytesAfter = 0;
+    double elapsedMs = 0;
+};
+
+/**
+ * @brief Simplifica los tramos de movimientos seguidos antes de guardar un programa.
+ *
+ * Un tramo son G0/G1 consecutivos con el mismo número y el mismo F (lo corta
+ * cualquier otro comando, que puede cambiar el modo o el offset). Sobre los
+ * puntos del tramo, en coordenadas de la máquina (XYZE), se aplica
+ * Ramer-Douglas-Peucker: se quitan los puntos a menos de tolerance mm del
+ * segmento que une a los que quedan, así que la trayectoria nueva no se aparta
+ * más que eso de la original. Con tolerance 0 sólo se unen los puntos alineados
+ * (y los movimientos de largo 0).
+ *
+ * Cada comando que queda se reescribe para llegar al mismo punto sin los que se
+ * quitaron: en G90 con los ejes que el tramo cambió, en G91 con la suma de los
+ * desplazamientos. Sin F el firmware elige la velocidad según el largo del
+ * movimiento; al unir varios se pone el F que mantiene la duración.
+ */
+class PathSimplifier {
+public:
+    explicit PathSimplifier(const ArmGeometry& geometry = ArmGeometry());
+
+    SimplifyReport simplify(const ProgramCommand* begin, const ProgramCommand* end,
+                            const ReplayState& start, float tolerance,
+                            std::vector<ProgramCommand>& out) const;
+
+private:
+    ArmGeometry geometry_;
+};
+
+} // namespace RPCServer
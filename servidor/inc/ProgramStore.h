@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <sys/types.h>
+#include "../lib/XmlRpcBinarySink.h"
+
+namespace RPCServer {
+
+// Un comando G-code ya interpretado, como el Cmd del firmware. Los ejes ausentes
+// valen NaN, así se reenvían sólo los que tenía la línea original.
+struct ProgramCommand {
+    char id;          // 'G' o 'M'
+    char pad[3];
+    int32_t num;
+    float x, y, z, e, f, s;
+};
+static_assert(sizeof(ProgramCommand) == 32, "formato de programa en disco");
+
+// Encabezado del archivo compilado; le sigue el arreglo de comandos
+struct ProgramHeader {
+    char magic[4];    // "RPRG"
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+static_assert(sizeof(ProgramHeader) == 16, "formato de programa en disco");
+
+// Línea que envía Robot::execute: sólo los parámetros que tiene, con tres decimales
+std::string programCommandLine(const ProgramCommand& cmd);
+// Encabezado y comandos listos para ProgramStore::save
+void buildProgramImage(const ProgramCommand* begin, const ProgramCommand* end, std::vector<char>& image);
+// Encabezado, versión y cantidad coinciden con el tamaño, y cada comando es 'G' o 'M'
+bool isValidProgramImage(const char* data, size_t size);
+
+/**
+ * @brief Traduce texto G-code a la imagen binaria que guarda ProgramStore.
+ *
+ * Acepta el texto en partes (feed) para compilar mientras llega el parámetro
+ * base64. Ignora comentarios (';' y paréntesis), números de línea (N) y
+ * checksums ('*'); cualquier otra letra que el firmware no use es un error.
+ */
+class ProgramCompiler {
+public:
+    ProgramCompiler();
+    void feed(const char* data, size_t len);
+    // Procesa la última línea. false si hubo un error (ver getError)
+    bool finish();
+    const std::string& getError() const { return error_; }
+    size_t getCount() const { return count_; }
+    // Encabezado y comandos listos para ProgramStore::save; deja vacío al compilador
+    void takeImage(std::vector<char>& image);
+
+private:
+    bool compileLine(const char* p, const char* end);
+
+    std::string partial_;  // línea incompleta al final de lo recibido
+    std::vector<char> image_;
+    size_t count_ = 0;
+    int lineNo_ = 0;
+    std::string error_;
+};
+
+/**
+ * @brief Programa compilado mapeado en memoria (sólo lectura).
+ *
+ * El arreglo se recorre directo desde el archivo: repetir un programa no vuelve
+ * a interpretar texto ni a copiarlo. Sigue válido aunque el archivo se reemplace.
+ */
+class MappedProgram {
+public:
+    // Lanza std::runtime_error si el archivo no existe o no es un programa válido
+    explicit MappedProgram(const std::string& path);
+    ~MappedProgram();
+    MappedProgram(const MappedProgram&) = delete;
+    MappedProgram& operator=(const MappedProgram&) = delete;
+
+    const ProgramCommand* begin() const { return commands_; }
+    const ProgramCommand* end() const { return commands_ + count_; }
+    size_t size() const { return count_; }
+
+private:
+    void* map_ = nullptr;
+    size_t mapSize_ = 0;
+    const ProgramCommand* commands_ = nullptr;
+    size_t count_ = 0;
+};
+
+/**
+ * @brief Programas subidos con uploadProgram, uno por archivo en un directorio.
+ *
+ * Los programas se mapean una vez y quedan en caché hasta que se reemplazan.
+ * Se usa desde el hilo del servidor (save) y desde el del scheduler (load).
+ */
+class ProgramStore {
+public:
+    explicit ProgramStore(const std::string& directory);
+
+    void setDirectory(const std::string& directory);
+    const std::string& getDirectory() const { return directory_; }
+
+    // Letras, dígitos, '_' y '-', hasta 64 caracteres
+    static bool isValidName(const std::string& name);
+
+    // Guarda la imagen (archivo temporal y rename) reemplazando la anterior.
+    // Lanza std::runtime_error si no es válida (isValidProgramImage) o no se puede escribir.
+    void save(const std::string& name, const std::vector<char>& image);
+
+    // Lanza std::runtime_error si el programa no existe o está dañado
+    std::shared_ptr<const MappedProgram> load(const std::string& name);
+
+private:
+    struct Cached {
+        std::shared_ptr<const MappedProgram> program;
+        ino_t inode;
+        time_t mtime;
+    };
+
+    std::string pathFor(const std::string& name) const;
+
+    std::string directory_;
+    std::mutex mutex_;
+    std::map<std::string, Cached> cache_;
+};
+
+/**
+ * @brief Sink de uploadProgram: compila el G-code a medida que se decodifica.
+ *
+ * El método recibe un struct con "image" (base64 compilado) y "commands", o con
+ * "error" si el texto no compila; el texto entero nunca queda en memoria.
+ */
+class ProgramUploadSink : public XmlRpc::XmlRpcBinarySink {
+    ProgramCompiler compiler_;
+public:
+    bool write(const char* data, size_t len) override;
+    bool finish(XmlRpc::XmlRpcValue& value) override;
+};
+
+} // namespace RPCServer
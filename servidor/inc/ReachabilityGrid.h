@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Workspace.h"
+
+namespace RPCServer {
+
+/**
+ * @brief Grilla de vóxeles precalculada del espacio de trabajo.
+ *
+ * Cada vóxel (cubo de voxelMm de lado) queda marcado como totalmente dentro,
+ * totalmente fuera o en el borde de la región que admite isAllowedPosition
+ * (sin el eje E, que se compara aparte). La clasificación es conservadora: se
+ * acota el módulo al cuadrado sobre todo el cubo, así que un vóxel "dentro" o
+ * "fuera" lo es para cualquier punto suyo; sólo los del borde necesitan la cuenta
+ * exacta. Dos bits por vóxel, unos 2.5 MB con 2 mm.
+ *
+ * Como la grilla depende sólo de la geometría, se guarda en disco con un hash de
+ * ArmGeometry en el nombre y el encabezado, y al arrancar se carga en lugar de
+ * recalcularla.
+ */
+class ReachabilityGrid {
+public:
+    enum Cell : uint8_t { Outside = 0, Inside = 1, Boundary = 2 };
+
+    static const float DEFAULT_VOXEL_MM;
+
+    // Sin construir: todo es borde y isAllowedPosition hace siempre la cuenta exacta
+    ReachabilityGrid() = default;
+
+    void build(const ArmGeometry& geometry, float voxelMm = DEFAULT_VOXEL_MM);
+    // false si el archivo no existe o es de otra geometría o resolución
+    bool load(const std::string& path, const ArmGeometry& geometry, float voxelMm = DEFAULT_VOXEL_MM);
+    void save(const std::string& path) const;
+    // Carga directory/alcance-<hash>.grid o la construye y la guarda ahí (si se puede)
+    void loadOrBuild(const ArmGeometry& geometry, const std::string& directory,
+                     float voxelMm = DEFAULT_VOXEL_MM);
+
+    static uint64_t geometryHash(const ArmGeometry& geometry, float voxelMm);
+    static std::string fileName(const ArmGeometry& geometry, float voxelMm);
+
+    bool isBuilt() const { return !cells_.empty(); }
+    const ArmGeometry& getGeometry() const { return geometry_; }
+
+    // O(1): índice del vóxel y dos bits. Fuera de la caja (o NaN) es Outside.
+    Cell classify(float x, float y, float z) const {
+        if (cells_.empty()) return Boundary;
+        float fx = (x - originX_) * inverseVoxel_;
+        float fy = (y - originY_) * inverseVoxel_;
+        float fz = (z - originZ_) * inverseVoxel_;
+        if (!(fx >= 0 && fx < float(nx_) && fy >= 0 && fy < float(ny_) && fz >= 0 && fz < float(nz_)))
+            return Outside;
+        size_t index = (size_t(fz) * ny_ + size_t(fy)) * nx_ + size_t(fx);
+        return Cell((cells_[index >> 5] >> ((index & 31) * 2)) & 3);
+    }
+
+    // Mismo resultado que ArmGeometry::isAllowedPosition; la cuenta exacta sólo en el borde
+    bool isAllowedPosition(float x, float y, float z, float e) const {
+        Cell c = classify(x, y, z);
+        if (c == Boundary) return geometry_.isAllowedPosition(x, y, z, e);
+        return c == Inside && e <= geometry_.railLength;
+    }
+
+    // Para el log y las métricas
+    size_t countCells(Cell c) const;
+    size_t bytes() const { return cells_.size() * sizeof(uint64_t); }
+    bool isFromCache() const { return fromCache_; }
+    double getBuildMs() const { return buildMs_; }
+
+private:
+    void setBounds(const ArmGeometry& geometry, float voxelMm);
+
+    ArmGeometry geometry_;
+    float voxelMm_ = 0;
+    float inverseVoxel_ = 0;
+    float originX_ = 0, originY_ = 0, originZ_ = 0;
+    uint32_t nx_ = 0, ny_ = 0, nz_ = 0;
+    std::vector<uint64_t> cells_; // 32 vóxeles de 2 bits por palabra, x más rápido
+    bool fromCache_ = false;
+    double buildMs_ = 0;
+};
+
+} // namespace RPCServer
@@ -2,15 +2,19 @@
 #include <string>
 #include <vector>
 #include <mutex>
+#include <atomic>
 #include "SerialPort.h"
 
 namespace RPCServer {
 
+struct ProgramCommand;
+
 // Estructura para respuesta de posición (M114)
 struct RobotPosition {
     bool valid = false;
     std::string mode; // "ABSOLUTE" o "RELATIVE"
     double x = 0.0, y = 0.0, z = 0.0, e = 0.0;
+    bool hasCoordinates = false; // x/y/z/e se leyeron de la respuesta (no sólo el modo)
     bool motorsEnabled = false;
     bool fanEnabled = false;
     std::vector<std::string> rawLines; // líneas originales para debug
@@ -23,27 +27,57 @@ struct EndstopStatus {
     std::vector<std::string> rawLines;
 };
 
+// Puerto serie abierto y estado conocido del robot, para pasarlos a otro proceso (reinicio en caliente)
+struct SerialHandoff {
+    int fd = -1; // -1 si el robot no estaba conectado
+    std::string port;
+    int baud = 0;
+    bool absolute = true;
+    bool motorsOn = false;
+    bool fanOn = false;
+};
+
 class Robot {
     SerialPort serial_;
     bool manual_ = true;
     bool absolute_ = true;
-    bool motorsOn_ = false;
+    // Los escribe el hilo del scheduler y los lee el dispatcher (waitForStateChange)
+    std::atomic<bool> motorsOn_{false};
+    std::atomic<bool> fanOn_{false};
+    bool workOffset_ = false; // un G92 de un programa movió el origen (no se sigue el valor)
+    EndstopStatus lastEndstops_;
+    std::atomic<int> stateVersion_{0}; // se incrementa con cada cambio de estado observable
     std::mutex ioMutex_;
 public:
     bool connect(const std::string& port, int baud);
     void disconnect();
     bool isConnected() const;
+    // Reinicio en caliente: entrega el puerto abierto (sin cerrarlo) o lo toma de otro proceso
+    SerialHandoff releaseSerial();
+    bool adoptSerial(const SerialHandoff& handoff);
     bool setMode(bool manual, bool absolute); // manual se deja por compatibilidad
     bool enableMotors(bool on);
     bool home();
     bool move(double x, double y, double z, double vel);
     bool endEffector(bool on);
+    // Envía un comando de un programa compilado (ProgramStore) y actualiza el estado
+    bool execute(const ProgramCommand& cmd);
     
     // Nuevos métodos para consulta de estado (respuestas multilínea)
     RobotPosition getPosition();
     EndstopStatus getEndstops();
+
+    // Versión del estado (movimiento completado, motores, efector, endstops...).
+    // Permite a los clientes esperar cambios en lugar de consultar periódicamente.
+    int getStateVersion() const { return stateVersion_.load(); }
+    bool getMotorsOn() const { return motorsOn_; }
+    bool getFanOn() const { return fanOn_; }
+    bool isAbsolute() const { return absolute_; }
+    bool hasWorkOffset() const { return workOffset_; }
     
 private:
+    void bumpStateVersion() { ++stateVersion_; }
+
     // Método original (compatible con código existente)
     bool sendAndWaitOk(const std::string& line, int timeoutMs = 5000);
     
@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include "../lib/XmlRpcValue.h"
+
+namespace RPCServer {
+
+// Clases de prioridad: un comando de una clase siempre se ejecuta antes que
+// cualquier comando pendiente de una clase posterior. Al encolar uno de Safety se
+// cancelan los de Control y Motion que esperaban.
+enum class CommandPriority {
+    Safety = 0,   // detener motores, desconectar
+    Control,      // conectar, habilitar motores
+    Motion,       // movimientos y todo lo que depende de su orden (modo, home, efector)
+    Telemetry     // consultas de estado (M114, M119)
+};
+
+constexpr int COMMAND_PRIORITY_COUNT = 4;
+
+const char* priorityName(CommandPriority p);
+
+// Métricas de una clase de prioridad
+struct LaneStats {
+    int depth = 0;              // comandos en cola ahora
+    int capacity = 0;           // límite de la cola (admisión)
+    int maxDepth = 0;           // máximo observado
+    unsigned long admitted = 0;
+    unsigned long rejected = 0; // rechazados por cola llena
+    unsigned long executed = 0;
+    unsigned long cancelled = 0; // retirados de la cola sin ejecutar
+};
+
+/**
+ * @brief Planificador de comandos por robot con colas acotadas por prioridad.
+ *
+ * Un único hilo trabajador ejecuta los comandos (que acceden al puerto serie),
+ * siempre tomando primero la clase de mayor prioridad. Así un enableMotors(false)
+ * adelanta a una ráfaga de move() pendientes, y la sobrecarga se rechaza de
+ * inmediato en lugar de acumular demoras.
+ */
+class RobotScheduler {
+public:
+    typedef std::function<void(XmlRpc::XmlRpcValue& result)> Job;
+
+    // onComplete se invoca desde el hilo trabajador al terminar cada comando
+    explicit RobotScheduler(std::function<void()> onComplete = std::function<void()>());
+    ~RobotScheduler();
+
+    RobotScheduler(const RobotScheduler&) = delete;
+    RobotScheduler& operator=(const RobotScheduler&) = delete;
+
+    void setCapacity(CommandPriority p, int capacity);
+
+    // Encola un comando. Devuelve un ticket > 0, o -1 si la cola de su clase está llena.
+    int submit(CommandPriority p, Job job);
+
+    // true si el comando del ticket terminó (o el ticket no existe)
+    bool isDone(int ticket);
+
+    // Retira el resultado de un comando terminado. Devuelve false si no terminó
+    // o no existe; error queda con el mensaje si el comando lanzó una excepción.
+    bool takeResult(int ticket, XmlRpc::XmlRpcValue& result, std::string& error);
+
+    // El cliente dejó de esperar el comando. Si todavía estaba en cola se retira
+    // y devuelve true; si ya se está ejecutando no se puede detener, su resultado
+    // se descarta al terminar y devuelve false.
+    bool cancel(int ticket);
+
+    LaneStats getStats(CommandPriority p);
+
+    // true si no hay comandos en cola ni en ejecución
+    bool isIdle();
+
+    // true si hay comandos de la clase p esperando. Un comando largo (runProgram)
+    // lo consulta entre pasos para ceder ante una parada de seguridad.
+    bool hasPending(CommandPriority p);
+
+private:
+    struct Pending {
+        int ticket;
+        Job job;
+    };
+    struct Completed {
+        bool done = false;
+        bool abandoned = false; // cancel() con el comando en ejecución
+        XmlRpc::XmlRpcValue result;
+        std::string error;
+        std::chrono::steady_clock::time_point finishedAt;
+    };
+
+    void workerLoop();
+    void pruneAbandoned();
+    int cancelPending(CommandPriority p, const std::string& reason);
+
+    std::function<void()> onComplete_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Pending> lanes_[COMMAND_PRIORITY_COUNT];
+    LaneStats stats_[COMMAND_PRIORITY_COUNT];
+    std::map<int, Completed> results_;
+    int nextTicket_ = 1;
+    bool stopping_ = false;
+    std::thread worker_;
+};
+
+} // namespace RPCServer
@@ -1,10 +1,11 @@
 #pragma once
 #include <string>
+#include <atomic>
 
 namespace RPCServer {
 class SerialPort {
     int fd_;
-    bool opened_;
+    std::atomic<bool> opened_; // isOpen() se consulta desde otros hilos
     std::string port_;
     int baud_;
 public:
@@ -13,6 +14,13 @@ public:
     bool open(const std::string& port, int baud);
     void close();
     bool isOpen() const;
+
+    // Reinicio en caliente: el puerto pasa abierto y configurado de un proceso al otro,
+    // sin la espera de open() ni el reset de la placa
+    bool adopt(int fd, const std::string& port, int baud);
+    int release(); // devuelve el fd abierto y deja de usarlo (-1 si no estaba abierto)
+    const std::string& getPortName() const { return port_; }
+    int getBaud() const { return baud_; }
     bool writeLine(const std::string& line);
     std::string readLine(int timeoutMs = 500);
 
@@ -17,14 +17,24 @@ private:
     std::unique_ptr<ServerModel> model;
 
     void displayUsage(const std::string& programName) const {
-        std::cerr << "Uso: " << programName << " <puerto>\n";
+        std::cerr << "Uso: " << programName << " <puerto> [direccion ...] [--handoff ruta] [--programs dir]\n";
         std::cerr << "  puerto: Puerto en el que el servidor escuchará conexiones\n";
-        std::cerr << "Ejemplo: " << programName << " 8080\n";
+        std::cerr << "  direccion: Otras direcciones donde escuchar: unix:/ruta, [::]:puerto, ip:puerto\n";
+        std::cerr << "  --handoff: Socket de control del reinicio en caliente; si ya hay un servidor\n";
+        std::cerr << "             en esa ruta, se heredan sus sockets, conexiones y puerto serie\n";
+        std::cerr << "  --programs: Directorio de los programas de uploadProgram (por defecto ./programas)\n";
+        std::cerr << "Ejemplo: " << programName << " 8080 unix:/tmp/servidor_rpc.sock [::]:8080 --handoff /tmp/servidor_rpc.ctl\n";
     }
 
     void displayStartupInfo() const {
         std::cout << "=== Servidor RPC Iniciado ===" << std::endl;
         std::cout << "Puerto: " << model->getPort() << std::endl;
+        for (const std::string& address : model->getListenAddresses()) {
+            std::cout << "También en: " << address << std::endl;
+        }
+        if (!model->getHandoffPath().empty()) {
+            std::cout << "Reinicio en caliente: " << model->getHandoffPath() << std::endl;
+        }
         std::cout << "Métodos disponibles:" << std::endl;
         std::cout << "  - ServerTest: Prueba de conexión" << std::endl;
         std::cout << "  - Eco: Echo con saludo personalizado" << std::endl;
@@ -57,7 +67,7 @@ public:
     int run(int argc, char* argv[]) {
         try {
             // Validar argumentos
-            if (argc != 2) {
+            if (argc < 2) {
                 displayUsage(argv[0]);
                 return 1;
             }
@@ -67,6 +77,24 @@ public:
 
             // Crear modelo con configuración
             auto config = std::make_unique<ServerConfig>(port, true, 5);
+            for (int i = 2; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "--handoff") {
+                    if (i + 1 >= argc) {
+                        displayUsage(argv[0]);
+                        return 1;
+                    }
+                    config->setHandoffPath(argv[++i]);
+                } else if (arg == "--programs") {
+                    if (i + 1 >= argc) {
+                        displayUsage(argv[0]);
+                        return 1;
+                    }
+                    config->setProgramDirectory(argv[++i]);
+                } else {
+                    config->addListenAddress(arg);
+                }
+            }
             model = std::make_unique<ServerModel>(std::move(config));
 
             // Iniciar servidor
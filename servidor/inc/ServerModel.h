@@ -4,9 +4,21 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <chrono>
+#include <unistd.h>
 #include "../lib/XmlRpc.h"
+#include "../lib/XmlRpcSocket.h"
 #include "RPCExceptions.h"
 #include "Robot.h"
+#include "RobotScheduler.h"
+#include "HotRestart.h"
+#include "ProgramStore.h"
+#include "Workspace.h"
+#include "Kinematics.h"
+#include "ReachabilityGrid.h"
+#include "MotionPlanner.h"
+#include "PathSimplifier.h"
+#include "WorkerPool.h"
 
 namespace RPCServer {
 
@@ -22,18 +34,58 @@ private:
     int port;
     bool introspectionEnabled;
     int verbosityLevel;
+    int responseCacheSize;  // Respuestas cacheadas de métodos idempotentes (0 = deshabilitado)
+    int motionQueueCapacity; // Movimientos pendientes admitidos antes de rechazar con fault
+    int listenBacklog;       // Conexiones en espera de accept antes de que el sistema las rechace
+    bool tcpNoDelay;         // Desactiva Nagle: las respuestas chicas salen sin demora
+    bool tcpKeepAlive;       // Detecta clientes caídos en conexiones inactivas
+    int socketBufferSize;    // SO_SNDBUF/SO_RCVBUF de cada conexión en bytes (0 = del sistema)
+    int maxHeaderSize;       // Encabezado HTTP más largo aceptado (si no, 431)
+    int maxRequestSize;      // Cuerpo más largo aceptado (si no, 413 sin leerlo)
+    std::vector<std::string> listenAddresses; // Direcciones extra: "unix:/ruta", "[::]:8080", "127.0.0.1:8081"
+    std::string handoffPath;  // Socket de control del reinicio en caliente ("" = deshabilitado)
+    int drainTimeoutMs;       // Espera máxima de los pedidos en curso al entregar el servidor
+    std::string programDirectory; // Programas compilados de uploadProgram
 
 public:
     ServerConfig(int serverPort = 8080, bool enableIntrospection = true, int verbosity = 5)
-        : port(serverPort), introspectionEnabled(enableIntrospection), verbosityLevel(verbosity) {}
+        : port(serverPort), introspectionEnabled(enableIntrospection), verbosityLevel(verbosity),
+          responseCacheSize(64), motionQueueCapacity(32), listenBacklog(128),
+          tcpNoDelay(true), tcpKeepAlive(true), socketBufferSize(0),
+          maxHeaderSize(16 * 1024), maxRequestSize(64 * 1024 * 1024), drainTimeoutMs(30000),
+          programDirectory("programas") {}
 
     int getPort() const { return port; }
     bool isIntrospectionEnabled() const { return introspectionEnabled; }
     int getVerbosityLevel() const { return verbosityLevel; }
+    int getResponseCacheSize() const { return responseCacheSize; }
+    int getMotionQueueCapacity() const { return motionQueueCapacity; }
+    int getListenBacklog() const { return listenBacklog; }
+    bool isTcpNoDelay() const { return tcpNoDelay; }
+    bool isTcpKeepAlive() const { return tcpKeepAlive; }
+    int getSocketBufferSize() const { return socketBufferSize; }
+    int getMaxHeaderSize() const { return maxHeaderSize; }
+    int getMaxRequestSize() const { return maxRequestSize; }
+    const std::vector<std::string>& getListenAddresses() const { return listenAddresses; }
+    const std::string& getHandoffPath() const { return handoffPath; }
+    int getDrainTimeoutMs() const { return drainTimeoutMs; }
+    const std::string& getProgramDirectory() const { return programDirectory; }
 
     void setPort(int newPort) { port = newPort; }
     void setIntrospectionEnabled(bool enabled) { introspectionEnabled = enabled; }
     void setVerbosityLevel(int level) { verbosityLevel = level; }
+    void setResponseCacheSize(int entries) { responseCacheSize = entries; }
+    void setMotionQueueCapacity(int commands) { motionQueueCapacity = commands; }
+    void setListenBacklog(int connections) { listenBacklog = connections; }
+    void setTcpNoDelay(bool enabled) { tcpNoDelay = enabled; }
+    void setTcpKeepAlive(bool enabled) { tcpKeepAlive = enabled; }
+    void setSocketBufferSize(int bytes) { socketBufferSize = bytes; }
+    void setMaxHeaderSize(int bytes) { maxHeaderSize = bytes; }
+    void setMaxRequestSize(int bytes) { maxRequestSize = bytes; }
+    void addListenAddress(const std::string& address) { listenAddresses.push_back(address); }
+    void setHandoffPath(const std::string& path) { handoffPath = path; }
+    void setDrainTimeoutMs(int ms) { drainTimeoutMs = ms; }
+    void setProgramDirectory(const std::string& directory) { programDirectory = directory; }
 };
 
 /**
@@ -60,6 +112,9 @@ public:
     ServerTestMethod(XmlRpc::XmlRpcServer* server)
         : ServiceMethod("ServerTest", "Respondo quien soy cuando no hay argumentos", server) {}
 
+    // Respuesta constante: el servidor la sirve desde su caché de respuestas
+    bool isCacheable() override { return true; }
+
     void execute(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
         try {
             result = "Hi, soy el servidor RPC !!";
@@ -122,12 +177,74 @@ public:
 
 // ========== Métodos del Robot ==========
 
-class ConnectRobotMethod : public ServiceMethod {
+/**
+ * @brief Base de los métodos que acceden al puerto serie del robot.
+ *
+ * El comando se encola en el RobotScheduler con la prioridad que indique la
+ * subclase y la conexión queda estacionada (sin bloquear el servidor) hasta que
+ * el hilo trabajador lo ejecuta. Si la cola de su clase está llena se responde
+ * un fault de inmediato, para que el cliente reintente o reduzca la tasa.
+ */
+class ScheduledRobotMethod : public ServiceMethod {
+protected:
     Robot* robot;
+    RobotScheduler* scheduler;
+
+    // Prioridad del comando (puede depender de los parámetros)
+    virtual CommandPriority priority(XmlRpc::XmlRpcValue& params) = 0;
+    // Ejecución real, desde el hilo trabajador del scheduler
+    virtual void run(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) = 0;
+    // Espera máxima del cliente, contando el tiempo en cola
+    virtual int timeoutMs() { return COMMAND_TIMEOUT_MS; }
+
 public:
-    ConnectRobotMethod(XmlRpc::XmlRpcServer* server, Robot* r)
-      : ServiceMethod("connectRobot", "Conecta al puerto serie del robot", server), robot(r) {}
-    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+    static const int COMMAND_TIMEOUT_MS = 120000;
+
+    ScheduledRobotMethod(const std::string& name, const std::string& description,
+                         XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s)
+      : ServiceMethod(name, description, server), robot(r), scheduler(s) {}
+
+    bool mustWait(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& waitState, double* msTimeout) override {
+        if (!waitState.valid()) {
+            XmlRpc::XmlRpcValue args = params;
+            CommandPriority p = priority(params);
+            int ticket = scheduler->submit(p, [this, args](XmlRpc::XmlRpcValue& result) mutable {
+                run(args, result);
+            });
+            if (ticket < 0)
+                throw XmlRpc::XmlRpcException(_name + ": cola '" + priorityName(p) + "' llena, reintente más tarde");
+            waitState = ticket;
+            *msTimeout = timeoutMs();
+        }
+        return !scheduler->isDone(int(waitState));
+    }
+
+    void executeWaited(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& waitState, XmlRpc::XmlRpcValue& result) override {
+        std::string error;
+        if (!scheduler->takeResult(int(waitState), result, error)) {
+            // El cliente recibe un fault: el comando no debe ejecutarse después
+            if (scheduler->cancel(int(waitState)))
+                throw XmlRpc::XmlRpcException(_name + ": el comando no llegó a ejecutarse a tiempo y se canceló");
+            throw XmlRpc::XmlRpcException(_name + ": el comando no terminó a tiempo (sigue en ejecución)");
+        }
+        if (!error.empty())
+            throw XmlRpc::XmlRpcException(error);
+    }
+
+    // Solo se llega acá desde system.multicall, que ejecuta en el hilo del dispatcher:
+    // se rechaza para no saltear las colas ni bloquear el servidor mientras responde el robot
+    void execute(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& /*result*/) override {
+        throw XmlRpc::XmlRpcException(_name + ": no se admite dentro de system.multicall, llámelo directamente");
+    }
+};
+
+class ConnectRobotMethod : public ScheduledRobotMethod {
+public:
+    ConnectRobotMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s)
+      : ScheduledRobotMethod("connectRobot", "Conecta al puerto serie del robot", server, r, s) {}
+protected:
+    CommandPriority priority(XmlRpc::XmlRpcValue& /*params*/) override { return CommandPriority::Control; }
+    void run(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
         try {
             if (params.size() < 1) throw InvalidParametersException("connectRobot", "port:string [, baud:int=115200]");
             std::string port = std::string(params[0]);
@@ -141,23 +258,26 @@ public:
     }
 };
 
-class DisconnectRobotMethod : public ServiceMethod {
-    Robot* robot;
+class DisconnectRobotMethod : public ScheduledRobotMethod {
 public:
-    DisconnectRobotMethod(XmlRpc::XmlRpcServer* server, Robot* r)
-      : ServiceMethod("disconnectRobot", "Desconecta el puerto serie", server), robot(r) {}
-    void execute(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
+    DisconnectRobotMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s)
+      : ScheduledRobotMethod("disconnectRobot", "Desconecta el puerto serie", server, r, s) {}
+protected:
+    CommandPriority priority(XmlRpc::XmlRpcValue& /*params*/) override { return CommandPriority::Safety; }
+    void run(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
         try { robot->disconnect(); result["ok"]=true; result["message"]="Desconectado"; }
         catch (const std::exception& e) { throw MethodExecutionException("disconnectRobot", e.what()); }
     }
 };
 
-class SetModeMethod : public ServiceMethod {
-    Robot* robot;
+class SetModeMethod : public ScheduledRobotMethod {
 public:
-    SetModeMethod(XmlRpc::XmlRpcServer* server, Robot* r)
-      : ServiceMethod("setMode", "Configura modo manual/absoluto", server), robot(r) {}
-    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+    SetModeMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s)
+      : ScheduledRobotMethod("setMode", "Configura modo manual/absoluto", server, r, s) {}
+protected:
+    // Afecta la interpretación de los movimientos encolados: mismo carril que move
+    CommandPriority priority(XmlRpc::XmlRpcValue& /*params*/) override { return CommandPriority::Motion; }
+    void run(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
         try {
             if (params.size() < 2) throw InvalidParametersException("setMode", "manual:bool, absolute:bool");
             if (!robot->isConnected()) { result["ok"]=false; result["message"]="No conectado"; return; }
@@ -168,12 +288,18 @@ public:
     }
 };
 
-class EnableMotorsMethod : public ServiceMethod {
-    Robot* robot;
+class EnableMotorsMethod : public ScheduledRobotMethod {
 public:
-    EnableMotorsMethod(XmlRpc::XmlRpcServer* server, Robot* r)
-      : ServiceMethod("enableMotors", "Enciende/Apaga motores", server), robot(r) {}
-    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+    EnableMotorsMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s)
+      : ScheduledRobotMethod("enableMotors", "Enciende/Apaga motores", server, r, s) {}
+protected:
+    // Apagar motores es la parada de seguridad: adelanta a todo lo pendiente
+    CommandPriority priority(XmlRpc::XmlRpcValue& params) override {
+        if (params.size() >= 1 && params[0].getType() == XmlRpc::XmlRpcValue::TypeBoolean && !bool(params[0]))
+            return CommandPriority::Safety;
+        return CommandPriority::Control;
+    }
+    void run(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
         try {
             if (params.size() < 1) throw InvalidParametersException("enableMotors", "on:bool");
             if (!robot->isConnected()) { result["ok"]=false; result["message"]="No conectado"; return; }
@@ -184,12 +310,13 @@ public:
     }
 };
 
-class HomeMethod : public ServiceMethod {
-    Robot* robot;
+class HomeMethod : public ScheduledRobotMethod {
 public:
-    HomeMethod(XmlRpc::XmlRpcServer* server, Robot* r)
-      : ServiceMethod("home", "Homing del robot", server), robot(r) {}
-    void execute(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
+    HomeMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s)
+      : ScheduledRobotMethod("home", "Homing del robot", server, r, s) {}
+protected:
+    CommandPriority priority(XmlRpc::XmlRpcValue& /*params*/) override { return CommandPriority::Motion; }
+    void run(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
         try {
             if (!robot->isConnected()) { result["ok"]=false; result["message"]="No conectado"; return; }
             bool ok = robot->home();
@@ -198,28 +325,44 @@ public:
     }
 };
 
-class MoveMethod : public ServiceMethod {
-    Robot* robot;
+/**
+ * @brief Movimiento cartesiano.
+ *
+ * En modo absoluto y sin G92 el destino son coordenadas de la máquina: si la
+ * grilla de alcance dice que está fuera del espacio de trabajo se responde sin
+ * enviar nada (el firmware frenaría el brazo en el borde). En modo relativo o con
+ * un G92 de un programa el servidor no conoce el destino y lo decide el firmware.
+ */
+class MoveMethod : public ScheduledRobotMethod {
+    const ReachabilityGrid* grid;
 public:
-    MoveMethod(XmlRpc::XmlRpcServer* server, Robot* r)
-      : ServiceMethod("move", "Movimiento cartesiano", server), robot(r) {}
-    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+    MoveMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s, const ReachabilityGrid* g)
+      : ScheduledRobotMethod("move", "Movimiento cartesiano", server, r, s), grid(g) {}
+protected:
+    CommandPriority priority(XmlRpc::XmlRpcValue& /*params*/) override { return CommandPriority::Motion; }
+    void run(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
         try {
             if (params.size() < 4) throw InvalidParametersException("move", "x:double, y:double, z:double, vel:double");
             if (!robot->isConnected()) { result["ok"]=false; result["message"]="No conectado"; return; }
             double x = double(params[0]), y = double(params[1]), z = double(params[2]), vel = double(params[3]);
+            if (robot->isAbsolute() && !robot->hasWorkOffset() &&
+                !grid->isAllowedPosition(float(x), float(y), float(z), 0.0f)) {
+                result["ok"]=false; result["message"]="Destino fuera del espacio de trabajo"; return;
+            }
             bool ok = robot->move(x,y,z,vel);
             result["ok"]=ok; result["message"]= ok ? "Movimiento enviado" : "Fallo move";
         } catch (const std::exception& e) { throw MethodExecutionException("move", e.what()); }
     }
 };
 
-class EndEffectorMethod : public ServiceMethod {
-    Robot* robot;
+class EndEffectorMethod : public ScheduledRobotMethod {
 public:
-    EndEffectorMethod(XmlRpc::XmlRpcServer* server, Robot* r)
-      : ServiceMethod("endEffector", "Activa/Desactiva efector final", server), robot(r) {}
-    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+    EndEffectorMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s)
+      : ScheduledRobotMethod("endEffector", "Activa/Desactiva efector final", server, r, s) {}
+protected:
+    // Debe respetar el orden respecto de los movimientos (tomar/soltar en destino)
+    CommandPriority priority(XmlRpc::XmlRpcValue& /*params*/) override { return CommandPriority::Motion; }
+    void run(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
         try {
             if (params.size() < 1) throw InvalidParametersException("endEffector", "on:bool");
             if (!robot->isConnected()) { result["ok"]=false; result["message"]="No conectado"; return; }
@@ -230,12 +373,13 @@ public:
     }
 };
 
-class GetPositionMethod : public ServiceMethod {
-    Robot* robot;
+class GetPositionMethod : public ScheduledRobotMethod {
 public:
-    GetPositionMethod(XmlRpc::XmlRpcServer* server, Robot* r)
-      : ServiceMethod("getPosition", "Obtiene posición actual del robot (M114)", server), robot(r) {}
-    void execute(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
+    GetPositionMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s)
+      : ScheduledRobotMethod("getPosition", "Obtiene posición actual del robot (M114)", server, r, s) {}
+protected:
+    CommandPriority priority(XmlRpc::XmlRpcValue& /*params*/) override { return CommandPriority::Telemetry; }
+    void run(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
         try {
             if (!robot->isConnected()) { result["ok"]=false; result["message"]="No conectado"; return; }
             auto pos = robot->getPosition();
@@ -256,12 +400,13 @@ public:
     }
 };
 
-class GetEndstopsMethod : public ServiceMethod {
-    Robot* robot;
+class GetEndstopsMethod : public ScheduledRobotMethod {
 public:
-    GetEndstopsMethod(XmlRpc::XmlRpcServer* server, Robot* r)
-      : ServiceMethod("getEndstops", "Obtiene estado de endstops (M119)", server), robot(r) {}
-    void execute(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
+    GetEndstopsMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s)
+      : ScheduledRobotMethod("getEndstops", "Obtiene estado de endstops (M119)", server, r, s) {}
+protected:
+    CommandPriority priority(XmlRpc::XmlRpcValue& /*params*/) override { return CommandPriority::Telemetry; }
+    void run(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
         try {
             if (!robot->isConnected()) { result["ok"]=false; result["message"]="No conectado"; return; }
             auto status = robot->getEndstops();
@@ -278,22 +423,584 @@ public:
     }
 };
 
+// Número XML-RPC que puede llegar como int o double
+inline float numberValue(XmlRpc::XmlRpcValue& v) {
+    if (v.getType() == XmlRpc::XmlRpcValue::TypeInt) return float(int(v));
+    return float(double(v));
+}
+
+/**
+ * @brief Cinemática inversa de muchos puntos a la vez, sin mover el robot.
+ *
+ * Recibe un arreglo de puntos, cada uno [x, y, z] o [x, y, z, e] (o un struct con
+ * esos campos), y responde los ángulos de los motores en radianes como los
+ * calcula el firmware y si cada punto es alcanzable. Pensado para planificadores
+ * y la interfaz web, que prueban miles de poses por cuadro. Se responde de
+ * inmediato, sin pasar por el scheduler.
+ */
+class SolveIKMethod : public ServiceMethod {
+    const InverseKinematics* kinematics;
+public:
+    SolveIKMethod(XmlRpc::XmlRpcServer* server, const InverseKinematics* ik)
+      : ServiceMethod("solveIK", "Cinemática inversa de un lote de puntos: points:array de [x, y, z(, e)]", server),
+        kinematics(ik) {}
+
+    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+        try {
+            if (params.size() < 1 || params[0].getType() != XmlRpc::XmlRpcValue::TypeArray)
+                throw InvalidParametersException("solveIK", "points:array de [x, y, z(, e)]");
+            auto started = std::chrono::steady_clock::now();
+            XmlRpc::XmlRpcValue& list = params[0];
+            PointBatch points;
+            points.resize(size_t(list.size()));
+            for (int i = 0; i < list.size(); ++i) {
+                XmlRpc::XmlRpcValue& p = list[i];
+                if (p.getType() == XmlRpc::XmlRpcValue::TypeStruct &&
+                    p.hasMember("x") && p.hasMember("y") && p.hasMember("z")) {
+                    points.x[i] = numberValue(p["x"]);
+                    points.y[i] = numberValue(p["y"]);
+                    points.z[i] = numberValue(p["z"]);
+                    if (p.hasMember("e")) points.e[i] = numberValue(p["e"]);
+                } else if (p.getType() == XmlRpc::XmlRpcValue::TypeArray && p.size() >= 3) {
+                    points.x[i] = numberValue(p[0]);
+                    points.y[i] = numberValue(p[1]);
+                    points.z[i] = numberValue(p[2]);
+                    if (p.size() > 3) points.e[i] = numberValue(p[3]);
+                } else {
+                    throw std::invalid_argument("el punto " + std::to_string(i) + " no es [x, y, z] ni {x, y, z}");
+                }
+            }
+
+            JointBatch joints;
+            kinematics->solveBatch(points, joints);
+
+            XmlRpc::XmlRpcValue& angles = result["angles"];
+            XmlRpc::XmlRpcValue& reachable = result["reachable"];
+            angles.setSize(int(joints.size()));
+            reachable.setSize(int(joints.size()));
+            for (size_t i = 0; i < joints.size(); ++i) {
+                XmlRpc::XmlRpcValue& a = angles[int(i)];
+                a.setSize(3);
+                a[0] = double(joints.rot[i]);
+                a[1] = double(joints.low[i]);
+                a[2] = double(joints.high[i]);
+                reachable[int(i)] = bool(joints.reachable[i]);
+            }
+            result["count"] = int(joints.size());
+            result["reachableCount"] = int(joints.reachableCount);
+            result["elapsedMs"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        } catch (const std::exception& e) {
+            throw XmlRpc::XmlRpcException(MethodExecutionException("solveIK", e.what()).what());
+        }
+    }
+};
+
+// Qué partes del estado inicial usa el programa (StartDependence) como struct XML-RPC
+inline XmlRpc::XmlRpcValue startDependenceToValue(const StartDependence& dep) {
+    XmlRpc::XmlRpcValue v;
+    v["position"] = dep.position;
+    v["mode"] = dep.mode;
+    v["offset"] = dep.offset;
+    return v;
+}
+
+// Resultado de ProgramValidator como struct XML-RPC
+inline XmlRpc::XmlRpcValue validationToValue(const ValidationReport& report) {
+    XmlRpc::XmlRpcValue v;
+    v["valid"] = report.valid;
+    v["commands"] = int(report.commands);
+    v["segments"] = int(report.segments);
+    v["samples"] = int(report.samples);
+    v["violations"] = int(report.violations);
+    v["unsupported"] = int(report.unsupported);
+    v["dependsOnStart"] = startDependenceToValue(report.dependsOn);
+    v["elapsedMs"] = report.elapsedMs;
+    if (!report.valid) {
+        XmlRpc::XmlRpcValue& first = v["firstViolation"];
+        first["command"] = report.first.command;
+        first["x"] = double(report.first.x);
+        first["y"] = double(report.first.y);
+        first["z"] = double(report.first.z);
+        first["e"] = double(report.first.e);
+    }
+    return v;
+}
+
+// Resultado de PathSimplifier como struct XML-RPC
+inline XmlRpc::XmlRpcValue simplifyToValue(const SimplifyReport& report) {
+    XmlRpc::XmlRpcValue v;
+    v["tolerance"] = double(report.tolerance);
+    v["commandsBefore"] = int(report.commandsBefore);
+    v["commandsAfter"] = int(report.commandsAfter);
+    v["movesBefore"] = int(report.movesBefore);
+    v["movesAfter"] = int(report.movesAfter);
+    v["serialBytesBefore"] = int(report.serialBytesBefore);
+    v["serialBytesAfter"] = int(report.serialBytesAfter);
+    v["elapsedMs"] = report.elapsedMs;
+    return v;
+}
+
+/**
+ * @brief Sube un programa G-code: se compila una vez y se guarda en el ProgramStore.
+ *
+ * El texto llega en base64 (o como string). Si es grande se compila a medida que
+ * se decodifica (ProgramUploadSink), sin guardar el texto. Se responde de
+ * inmediato, sin pasar por el scheduler: no usa el puerto serie. La respuesta
+ * incluye la validación contra el espacio de trabajo desde home.
+ *
+ * Con tolerance (mm, opcional) se simplifican los tramos de movimientos antes de
+ * guardar (PathSimplifier) y se informa cuántos comandos y bytes por el puerto
+ * serie se ahorraron.
+ */
+class UploadProgramMethod : public ServiceMethod {
+    ProgramStore* programs;
+    const ProgramValidator* validator;
+    const PathSimplifier* simplifier;
+public:
+    UploadProgramMethod(XmlRpc::XmlRpcServer* server, ProgramStore* store, const ProgramValidator* v,
+                        const PathSimplifier* ps)
+      : ServiceMethod("uploadProgram",
+                      "Guarda un programa G-code compilado: name:string, gcode:base64 [, tolerance:double]", server),
+        programs(store), validator(v), simplifier(ps) {}
+
+    XmlRpc::XmlRpcBinarySink* createBinarySink(int index) override {
+        return index == 0 ? new ProgramUploadSink() : 0;
+    }
+
+    // Lo que dejó ProgramUploadSink al compilar durante la lectura llega aparte de
+    // params: un struct enviado por el cliente no puede hacerse pasar por él
+    void executeStreamed(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& streamed,
+                         XmlRpc::XmlRpcValue& result) override {
+        XmlRpc::XmlRpcValue* compiled = streamed.size() > 0 && streamed[0].valid() ? &streamed[0] : nullptr;
+        upload(params, compiled, result);
+    }
+
+    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+        upload(params, nullptr, result);
+    }
+
+private:
+    void upload(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue* streamed, XmlRpc::XmlRpcValue& result) {
+        try {
+            if (params.size() < 2)
+                throw InvalidParametersException("uploadProgram", "name:string, gcode:base64 [, tolerance:double]");
+            std::string name = std::string(params[0]);
+            float tolerance = params.size() > 2 ? numberValue(params[2]) : -1.0f;
+            if (params.size() > 2 && !(tolerance >= 0))
+                throw InvalidParametersException("uploadProgram", "tolerance >= 0 en mm");
+            if (!ProgramStore::isValidName(name))
+                throw InvalidParametersException("uploadProgram", "nombre de letras, dígitos, '_' o '-'");
+
+            XmlRpc::XmlRpcValue& gcode = params[1];
+            XmlRpc::XmlRpcValue local;
+            XmlRpc::XmlRpcValue& compiled = streamed ? *streamed : local;
+            if (!streamed) {
+                if (gcode.getType() != XmlRpc::XmlRpcValue::TypeBase64 &&
+                    gcode.getType() != XmlRpc::XmlRpcValue::TypeString)
+                    throw InvalidParametersException("uploadProgram", "name:string, gcode:base64 [, tolerance:double]");
+                ProgramUploadSink sink;
+                if (gcode.getType() == XmlRpc::XmlRpcValue::TypeBase64) {
+                    XmlRpc::XmlRpcValue::BinaryData& text = gcode;
+                    if (!text.empty()) sink.write(text.data(), text.size());
+                } else {
+                    const std::string& text = gcode;
+                    sink.write(text.data(), text.size());
+                }
+                sink.finish(local);
+            }
+            if (compiled.hasMember("error")) {
+                result["ok"] = false;
+                result["message"] = std::string(compiled["error"]);
+                return;
+            }
+            if (!compiled.hasMember("image"))
+                throw InvalidParametersException("uploadProgram", "name:string, gcode:base64");
+
+            XmlRpc::XmlRpcValue::BinaryData& image = compiled["image"];
+            if (!isValidProgramImage(image.data(), image.size()))
+                throw std::runtime_error("el compilador no produjo un programa válido");
+            const ProgramCommand* commands = reinterpret_cast<const ProgramCommand*>(image.data() + sizeof(ProgramHeader));
+            size_t count = (image.size() - sizeof(ProgramHeader)) / sizeof(ProgramCommand);
+            if (tolerance >= 0 && startDependence(commands, commands + count).mode) {
+                // Los tramos unidos se escriben como suma (G91) o último valor (G90)
+                result["ok"] = false;
+                result["message"] = "Para simplificar, el programa debe fijar G90 o G91 antes del primer movimiento";
+                return;
+            }
+            if (tolerance >= 0) {
+                std::vector<ProgramCommand> simplified;
+                SimplifyReport simplify = simplifier->simplify(commands, commands + count,
+                                                               ReplayState::home(validator->getGeometry()),
+                                                               tolerance, simplified);
+                buildProgramImage(simplified.data(), simplified.data() + simplified.size(), image);
+                commands = reinterpret_cast<const ProgramCommand*>(image.data() + sizeof(ProgramHeader));
+                count = simplified.size();
+                result["simplification"] = simplifyToValue(simplify);
+            }
+            programs->save(name, image);
+            ValidationReport report = validator->validate(commands, commands + count, ReplayState::home(validator->getGeometry()));
+
+            result["ok"] = true;
+            result["name"] = name;
+            result["commands"] = int(count);
+            result["bytes"] = int(image.size());
+            result["validation"] = validationToValue(report);
+            result["message"] = !report.valid ? "Programa guardado; sale del espacio de trabajo desde home"
+                              : report.dependsOn.position || report.dependsOn.mode
+                                  ? "Programa guardado; validado desde home, depende de la posición o el modo inicial"
+                              : "Programa guardado";
+        } catch (const std::exception& e) {
+            // Fuera del scheduler sólo XmlRpcException se convierte en fault
+            throw XmlRpc::XmlRpcException(MethodExecutionException("uploadProgram", e.what()).what());
+        }
+    }
+};
+
+/**
+ * @brief Valida un programa guardado contra el espacio de trabajo, sin moverse.
+ *
+ * Se reproduce desde la posición de home en modo absoluto, como después de G28;
+ * dependsOnStart dice si desde otro estado el recorrido sería otro.
+ */
+class ValidateProgramMethod : public ServiceMethod {
+    ProgramStore* programs;
+    const ProgramValidator* validator;
+public:
+    ValidateProgramMethod(XmlRpc::XmlRpcServer* server, ProgramStore* store, const ProgramValidator* v)
+      : ServiceMethod("validateProgram", "Valida un programa contra el espacio de trabajo: name:string", server),
+        programs(store), validator(v) {}
+
+    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+        try {
+            if (params.size() < 1) throw InvalidParametersException("validateProgram", "name:string");
+            std::shared_ptr<const MappedProgram> program = programs->load(std::string(params[0]));
+            result = validationToValue(validator->validate(program->begin(), program->end(),
+                                                           ReplayState::home(validator->getGeometry())));
+        } catch (const std::exception& e) {
+            throw XmlRpc::XmlRpcException(MethodExecutionException("validateProgram", e.what()).what());
+        }
+    }
+};
+
+// Resultado de MotionPlanner como struct XML-RPC
+inline XmlRpc::XmlRpcValue cycleTimeToValue(const CycleTimeReport& report) {
+    XmlRpc::XmlRpcValue v;
+    v["commands"] = int(report.commands);
+    v["segments"] = int(report.segments);
+    v["chains"] = int(report.chains);
+    v["pathMm"] = report.pathMm;
+    v["dwellSeconds"] = report.dwellSeconds;
+    v["cosineSeconds"] = report.cosineSeconds;
+    v["cosinePeakAcceleration"] = report.cosinePeakAcceleration;
+    v["stopSeconds"] = report.stopSeconds;
+    v["horizon"] = report.horizon;
+    v["lookAheadSeconds"] = report.lookAheadSeconds;
+    v["queueSeconds"] = report.queueSeconds;
+    v["unlimitedSeconds"] = report.unlimitedSeconds;
+    // Contra el perfil que corre hoy (SPEED_PROFILE 2): < 1 si cambiar a 3 sería más lento
+    v["speedup"] = report.lookAheadSeconds > 0 ? report.cosineSeconds / report.lookAheadSeconds : 1.0;
+    v["elapsedMs"] = report.elapsedMs;
+    return v;
+}
+
+/**
+ * @brief Estima el tiempo de ciclo de un programa guardado, sin moverse.
+ *
+ * Compara parar en cada vértice (perfil coseno actual y trapecio con la misma
+ * aceleración) con el planificador con anticipación de SPEED_PROFILE 3, desde
+ * home (dependsOnStart dice si el programa usa el estado inicial). horizon es
+ * cuántos movimientos ve el firmware en cola (1 con runProgram).
+ */
+class EstimateCycleTimeMethod : public ServiceMethod {
+    ProgramStore* programs;
+    const MotionPlanner* planner;
+public:
+    EstimateCycleTimeMethod(XmlRpc::XmlRpcServer* server, ProgramStore* store, const MotionPlanner* p)
+      : ServiceMethod("estimateCycleTime", "Tiempo de ciclo de un programa: name:string [, horizon:int]", server),
+        programs(store), planner(p) {}
+
+    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+        try {
+            if (params.size() < 1) throw InvalidParametersException("estimateCycleTime", "name:string [, horizon:int]");
+            int horizon = params.size() > 1 ? int(params[1]) : 1;
+            std::shared_ptr<const MappedProgram> program = programs->load(std::string(params[0]));
+            result = cycleTimeToValue(planner->estimate(program->begin(), program->end(),
+                                                        ReplayState::home(planner->getGeometry()), horizon));
+            result["dependsOnStart"] = startDependenceToValue(startDependence(program->begin(), program->end()));
+        } catch (const std::exception& e) {
+            throw XmlRpc::XmlRpcException(MethodExecutionException("estimateCycleTime", e.what()).what());
+        }
+    }
+};
+
+/**
+ * @brief Ejecuta un programa subido con uploadProgram.
+ *
+ * Antes de mover nada se valida el programa entero desde el estado actual del
+ * robot (posición de M114, G90/G91); si algún punto sale del espacio de trabajo
+ * no se envía ningún comando. Un programa que usa el estado inicial no corre
+ * después de un G92 anterior: el servidor no conoce ese origen. Los comandos se envían
+ * directo desde el archivo mapeado, sin volver a interpretar texto. Ocupa el
+ * carril de movimientos hasta terminar, pero cede entre comandos ante una
+ * parada de seguridad (enableMotors(false), disconnect).
+ */
+class RunProgramMethod : public ScheduledRobotMethod {
+    ProgramStore* programs;
+    const ProgramValidator* validator;
+public:
+    static const int PROGRAM_TIMEOUT_MS = 3600000;
+
+    RunProgramMethod(XmlRpc::XmlRpcServer* server, Robot* r, RobotScheduler* s, ProgramStore* store,
+                     const ProgramValidator* v)
+      : ScheduledRobotMethod("runProgram", "Ejecuta un programa subido con uploadProgram: name:string", server, r, s),
+        programs(store), validator(v) {}
+protected:
+    CommandPriority priority(XmlRpc::XmlRpcValue& /*params*/) override { return CommandPriority::Motion; }
+    int timeoutMs() override { return PROGRAM_TIMEOUT_MS; }
+    void run(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+        try {
+            if (params.size() < 1) throw InvalidParametersException("runProgram", "name:string");
+            if (!robot->isConnected()) { result["ok"]=false; result["message"]="No conectado"; return; }
+            std::shared_ptr<const MappedProgram> program = programs->load(std::string(params[0]));
+
+            ReplayState start = ReplayState::home(validator->getGeometry());
+            StartDependence dep = startDependence(program->begin(), program->end());
+            if ((dep.position || dep.offset) && robot->hasWorkOffset()) {
+                // M114 informa la posición menos el offset, que no se conoce
+                result["ok"] = false;
+                result["executed"] = 0;
+                result["total"] = int(program->size());
+                result["message"] = "El programa depende de la posición inicial y un G92 anterior movió el origen";
+                return;
+            }
+            start.relative = !robot->isAbsolute();
+            if (dep.position) {
+                RobotPosition pos = robot->getPosition();
+                if (!pos.hasCoordinates) {
+                    result["ok"] = false;
+                    result["executed"] = 0;
+                    result["total"] = int(program->size());
+                    result["message"] = "No se pudo leer la posición inicial (M114)";
+                    return;
+                }
+                start.pos[0] = float(pos.x);
+                start.pos[1] = float(pos.y);
+                start.pos[2] = float(pos.z);
+                start.pos[3] = float(pos.e);
+                if (!pos.mode.empty()) start.relative = (pos.mode == "RELATIVE");
+            }
+
+            ValidationReport report = validator->validate(program->begin(), program->end(), start);
+            if (!report.valid) {
+                result["ok"] = false;
+                result["executed"] = 0;
+                result["total"] = int(program->size());
+                result["validation"] = validationToValue(report);
+                result["message"] = "El comando " + std::to_string(report.first.command) + " sale del espacio de trabajo";
+                return;
+            }
+
+            int executed = 0;
+            std::string message = "Programa ejecutado";
+            for (const ProgramCommand& cmd : *program) {
+                if (scheduler->hasPending(CommandPriority::Safety)) {
+                    message = "Interrumpido por un comando de seguridad";
+                    break;
+                }
+                if (!robot->execute(cmd)) {
+                    message = "Fallo en el comando " + std::to_string(executed + 1);
+                    break;
+                }
+                ++executed;
+            }
+            result["ok"] = (executed == int(program->size()));
+            result["executed"] = executed;
+            result["total"] = int(program->size());
+            result["message"] = message;
+        } catch (const std::exception& e) { throw MethodExecutionException("runProgram", e.what()); }
+    }
+};
+
+/**
+ * @brief Métricas de las colas de comandos (profundidad, rechazos, ejecutados).
+ *
+ * Se responde de inmediato, sin pasar por el scheduler.
+ */
+class GetSchedulerStatsMethod : public ServiceMethod {
+    RobotScheduler* scheduler;
+public:
+    GetSchedulerStatsMethod(XmlRpc::XmlRpcServer* server, RobotScheduler* s)
+      : ServiceMethod("getSchedulerStats", "Métricas de las colas de comandos del robot por prioridad", server), scheduler(s) {}
+    void execute(XmlRpc::XmlRpcValue& /*params*/, XmlRpc::XmlRpcValue& result) override {
+        const CommandPriority lanes[] = { CommandPriority::Safety, CommandPriority::Control,
+                                          CommandPriority::Motion, CommandPriority::Telemetry };
+        for (CommandPriority p : lanes) {
+            LaneStats st = scheduler->getStats(p);
+            XmlRpc::XmlRpcValue& lane = result[priorityName(p)];
+            lane["depth"] = st.depth;
+            lane["capacity"] = st.capacity;
+            lane["maxDepth"] = st.maxDepth;
+            lane["admitted"] = int(st.admitted);
+            lane["rejected"] = int(st.rejected);
+            lane["executed"] = int(st.executed);
+            lane["cancelled"] = int(st.cancelled);
+        }
+    }
+};
+
+/**
+ * @brief Long-poll: responde cuando cambia la versión de estado del robot o vence el timeout.
+ *
+ * La conexión queda estacionada en el dispatcher sin bloquear el hilo del servidor,
+ * evitando que el panel web consulte getPosition (M114) periódicamente.
+ */
+class WaitForStateChangeMethod : public ServiceMethod {
+    Robot* robot;
+    const bool* draining; // al entregar el servidor se responde sin esperar
+public:
+    static const int MAX_TIMEOUT_MS = 60000;
+
+    WaitForStateChangeMethod(XmlRpc::XmlRpcServer* server, Robot* r, const bool* drainFlag)
+      : ServiceMethod("waitForStateChange", "Espera un cambio de estado del robot: lastVersion:int, timeoutMs:int", server),
+        robot(r), draining(drainFlag) {}
+
+    bool mustWait(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& /*waitState*/, double* msTimeout) override {
+        if (params.size() < 2 || *draining) return false; // execute() informa el error
+        int lastVersion = int(params[0]);
+        int timeoutMs = int(params[1]);
+        if (robot->getStateVersion() != lastVersion) return false;
+        *msTimeout = (timeoutMs < MAX_TIMEOUT_MS) ? timeoutMs : MAX_TIMEOUT_MS;
+        return true;
+    }
+
+    void execute(XmlRpc::XmlRpcValue& params, XmlRpc::XmlRpcValue& result) override {
+        try {
+            if (params.size() < 2) throw InvalidParametersException("waitForStateChange", "lastVersion:int, timeoutMs:int");
+            int version = robot->getStateVersion();
+            result["ok"] = true;
+            result["version"] = version;
+            result["changed"] = (version != int(params[0]));
+            result["connected"] = robot->isConnected();
+            result["motorsEnabled"] = robot->getMotorsOn();
+            result["fanEnabled"] = robot->getFanOn();
+        } catch (const std::exception& e) { throw MethodExecutionException("waitForStateChange", e.what()); }
+    }
+};
+
 /**
  * @brief Clase modelo del servidor que gestiona el servidor RPC
  */
 class ServerModel {
 private:
+    std::unique_ptr<HandoffListener> handoffListener_; // antes que server: el dispatcher lo referencia
     std::unique_ptr<XmlRpc::XmlRpcServer> server;
     std::unique_ptr<ServerConfig> config;
     std::vector<std::unique_ptr<ServiceMethod>> methods;
     std::unique_ptr<Robot> robot_;
+    std::unique_ptr<ProgramStore> programs_;
+    WorkerPool workers_;        // antes que validator_ y kinematics_, que lo usan
+    ProgramValidator validator_;
+    InverseKinematics kinematics_;
+    MotionPlanner planner_;
+    PathSimplifier simplifier_;
+    ReachabilityGrid grid_;     // vacía hasta start(): mientras tanto todo es cuenta exacta
+    std::unique_ptr<RobotScheduler> scheduler_; // se destruye primero: su hilo usa robot_ y server
+    std::string handoffPath_; // archivo del socket de control, se borra al detener
+    int handoffClient_;       // proceso nuevo esperando la entrega (-1 si ninguno)
+    bool draining_;
     bool isRunning;
 
+    // Escucha del socket de control para el próximo reinicio en caliente
+    void watchHandoff(int fd) {
+        XmlRpc::XmlRpcSocket::getUnixPath(fd, handoffPath_);
+        XmlRpc::XmlRpcServer* srv = server.get();
+        handoffListener_ = std::make_unique<HandoffListener>(fd, [this, srv](int client) {
+            if (handoffClient_ >= 0) { ::close(client); return; }
+            handoffClient_ = client;
+            srv->exit();
+        });
+        server->addSource(handoffListener_.get(), XmlRpc::XmlRpcDispatch::ReadableEvent);
+    }
+
+    // Cada cuánto se retiran las conexiones que terminaron su pedido mientras se drena
+    static const int DRAIN_POLL_MS = 20;
+    // El proceso nuevo espera el drenaje y además esto: después del plazo el saliente
+    // todavía espera el comando en curso en el puerto serie (hasta 8 s) y envía todo
+    static const int HANDOFF_MARGIN_MS = 10000;
+
+    // Proceso nuevo: toma los sockets, las conexiones y el puerto serie del anterior
+    bool takeOver() {
+        HandoffState state;
+        if (!HotRestart::takeOver(config->getHandoffPath(), state, config->getDrainTimeoutMs() + HANDOFF_MARGIN_MS))
+            return false;
+        for (int fd : state.listeners) server->adoptListener(fd);
+        for (int fd : state.connections) server->adoptConnection(fd);
+        if (state.serial.fd >= 0 && !robot_->adoptSerial(state.serial)) ::close(state.serial.fd);
+        if (state.controlFd >= 0) watchHandoff(state.controlFd);
+        return true;
+    }
+
+    // Proceso saliente: deja de aceptar, termina los pedidos en curso y entrega todo.
+    // Devuelve false si la entrega falló y el servidor sigue atendiendo.
+    bool handOver() {
+        int client = handoffClient_;
+        handoffClient_ = -1;
+        server->removeSource(handoffListener_.get());
+
+        HandoffState state;
+        state.listeners = server->detachListeners();
+        draining_ = true;
+        server->notifyWaiting(); // los long-poll responden ya
+
+        // Las conexiones que quedan entre pedidos se retiran enseguida para que no
+        // lean el siguiente; las demás terminan el suyo y se retiran después
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config->getDrainTimeoutMs());
+        while (true) {
+            std::vector<int> idle = server->detachIdleConnections();
+            state.connections.insert(state.connections.end(), idle.begin(), idle.end());
+            if (server->getConnectionCount() == 0 && scheduler_->isIdle()) break;
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) break; // las que queden se cierran
+            // work() toma segundos y atiende eventos hasta cumplirlos: pasos cortos, sin pasar el plazo
+            server->work((left < DRAIN_POLL_MS ? left : DRAIN_POLL_MS) / 1000.0);
+        }
+
+        state.controlFd = handoffListener_->getfd();
+        state.serial = robot_->releaseSerial();
+        bool ok = HotRestart::handOver(client, state);
+        ::close(client);
+        draining_ = false;
+
+        if (!ok) {
+            // El proceso nuevo no está: seguir atendiendo con lo mismo
+            for (int fd : state.listeners) server->adoptListener(fd);
+            for (int fd : state.connections) server->adoptConnection(fd);
+            if (state.serial.fd >= 0 && !robot_->adoptSerial(state.serial)) ::close(state.serial.fd);
+            server->addSource(handoffListener_.get(), XmlRpc::XmlRpcDispatch::ReadableEvent);
+            return false;
+        }
+
+        // El nuevo proceso tiene sus propias copias; los archivos de los sockets unix son suyos
+        for (int fd : state.listeners) ::close(fd);
+        for (int fd : state.connections) ::close(fd);
+        if (state.serial.fd >= 0) ::close(state.serial.fd);
+        handoffListener_->close();
+        handoffPath_.clear();
+        return true;
+    }
+
 public:
     ServerModel(std::unique_ptr<ServerConfig> serverConfig)
-      : config(std::move(serverConfig)), isRunning(false) {
+      : config(std::move(serverConfig)), handoffClient_(-1), draining_(false), isRunning(false) {
         server = std::make_unique<XmlRpc::XmlRpcServer>();
         robot_ = std::make_unique<Robot>(); // inicializar robot
+        programs_ = std::make_unique<ProgramStore>(config->getProgramDirectory());
+        validator_.setPool(&workers_);
+        validator_.setGrid(&grid_);
+        kinematics_.setPool(&workers_);
+        kinematics_.setGrid(&grid_);
+        XmlRpc::XmlRpcServer* srv = server.get();
+        scheduler_ = std::make_unique<RobotScheduler>([srv]() { srv->wakeup(); });
         initializeMethods();
     }
     void initializeMethods() {
@@ -302,15 +1009,24 @@ public:
             methods.push_back(std::make_unique<EchoMethod>(server.get()));
             methods.push_back(std::make_unique<SumMethod>(server.get()));
             // Métodos del Robot (UML ServidorRPC)
-            methods.push_back(std::make_unique<ConnectRobotMethod>(server.get(), robot_.get()));
-            methods.push_back(std::make_unique<DisconnectRobotMethod>(server.get(), robot_.get()));
-            methods.push_back(std::make_unique<SetModeMethod>(server.get(), robot_.get()));
-            methods.push_back(std::make_unique<EnableMotorsMethod>(server.get(), robot_.get()));
-            methods.push_back(std::make_unique<HomeMethod>(server.get(), robot_.get()));
-            methods.push_back(std::make_unique<MoveMethod>(server.get(), robot_.get()));
-            methods.push_back(std::make_unique<EndEffectorMethod>(server.get(), robot_.get()));
-            methods.push_back(std::make_unique<GetPositionMethod>(server.get(), robot_.get()));
-            methods.push_back(std::make_unique<GetEndstopsMethod>(server.get(), robot_.get()));
+            methods.push_back(std::make_unique<ConnectRobotMethod>(server.get(), robot_.get(), scheduler_.get()));
+            methods.push_back(std::make_unique<DisconnectRobotMethod>(server.get(), robot_.get(), scheduler_.get()));
+            methods.push_back(std::make_unique<SetModeMethod>(server.get(), robot_.get(), scheduler_.get()));
+            methods.push_back(std::make_unique<EnableMotorsMethod>(server.get(), robot_.get(), scheduler_.get()));
+            methods.push_back(std::make_unique<HomeMethod>(server.get(), robot_.get(), scheduler_.get()));
+            methods.push_back(std::make_unique<MoveMethod>(server.get(), robot_.get(), scheduler_.get(), &grid_));
+            methods.push_back(std::make_unique<EndEffectorMethod>(server.get(), robot_.get(), scheduler_.get()));
+            methods.push_back(std::make_unique<GetPositionMethod>(server.get(), robot_.get(), scheduler_.get()));
+            methods.push_back(std::make_unique<GetEndstopsMethod>(server.get(), robot_.get(), scheduler_.get()));
+            methods.push_back(std::make_unique<WaitForStateChangeMethod>(server.get(), robot_.get(), &draining_));
+            methods.push_back(std::make_unique<GetSchedulerStatsMethod>(server.get(), scheduler_.get()));
+            methods.push_back(std::make_unique<UploadProgramMethod>(server.get(), programs_.get(), &validator_,
+                                                                    &simplifier_));
+            methods.push_back(std::make_unique<ValidateProgramMethod>(server.get(), programs_.get(), &validator_));
+            methods.push_back(std::make_unique<RunProgramMethod>(server.get(), robot_.get(), scheduler_.get(),
+                                                                 programs_.get(), &validator_));
+            methods.push_back(std::make_unique<SolveIKMethod>(server.get(), &kinematics_));
+            methods.push_back(std::make_unique<EstimateCycleTimeMethod>(server.get(), programs_.get(), &planner_));
         } catch (const std::exception& e) {
             throw ServerInitializationException("Falló la inicialización de métodos: " + std::string(e.what()));
         }
@@ -319,11 +1035,45 @@ public:
     void start() {
         try {
             XmlRpc::setVerbosity(config->getVerbosityLevel());
+            // Los mensajes se formatean y escriben en un hilo aparte
+            if (config->getVerbosityLevel() > 0)
+                XmlRpc::XmlRpcAsyncLog::start();
             server->enableIntrospection(config->isIntrospectionEnabled());
+            server->setResponseCacheSize(config->getResponseCacheSize());
+            scheduler_->setCapacity(CommandPriority::Motion, config->getMotionQueueCapacity());
+            server->setNoDelay(config->isTcpNoDelay());
+            server->setKeepAlive(config->isTcpKeepAlive());
+            server->setSocketBufferSizes(config->getSocketBufferSize(), config->getSocketBufferSize());
+            server->setMaxHeaderSize(config->getMaxHeaderSize());
+            server->setMaxRequestSize(config->getMaxRequestSize());
+            // Depende sólo de la geometría: se guarda junto a los programas y se reutiliza
+            grid_.loadOrBuild(validator_.getGeometry(), config->getProgramDirectory());
+
+            // Reinicio en caliente: si otro servidor atiende en la ruta de control, se hereda todo de él
+            if (!config->getHandoffPath().empty() && takeOver()) {
+                isRunning = true;
+                return;
+            }
             
-            if (!server->bindAndListen(config->getPort())) {
+            if (!server->bindAndListen(config->getPort(), config->getListenBacklog())) {
                 throw ServerBindingException(config->getPort(), "No se pudo vincular y escuchar");
             }
+
+            // Además del puerto TCP: sockets unix (clientes en el mismo host) e IPv6
+            for (const std::string& address : config->getListenAddresses()) {
+                std::string host;
+                int port = 0;
+                if (!XmlRpc::XmlRpcSocket::parseAddress(address, host, port) ||
+                    !server->listenOn(host, port, config->getListenBacklog())) {
+                    throw ServerBindingException(port, "No se pudo escuchar en " + address);
+                }
+            }
+
+            if (!config->getHandoffPath().empty()) {
+                int fd = HotRestart::listen(config->getHandoffPath());
+                if (fd < 0) throw ServerBindingException(config->getPort(), "No se pudo crear el socket de control " + config->getHandoffPath());
+                watchHandoff(fd);
+            }
             
             isRunning = true;
         } catch (const std::exception& e) {
@@ -337,7 +1087,10 @@ public:
         }
         
         try {
-            server->work(-1.0);
+            // work() vuelve antes si un proceso nuevo pide la entrega
+            do {
+                server->work(-1.0);
+            } while (handoffClient_ >= 0 && !handOver());
         } catch (const std::exception& e) {
             throw ServerInitializationException("Error de ejecución del servidor: " + std::string(e.what()));
         }
@@ -346,10 +1099,14 @@ public:
     void stop() {
         isRunning = false;
         server->shutdown();
+        if (!handoffPath_.empty()) ::unlink(handoffPath_.c_str());
+        XmlRpc::XmlRpcAsyncLog::stop();
     }
 
     bool getIsRunning() const { return isRunning; }
     int getPort() const { return config->getPort(); }
+    const std::vector<std::string>& getListenAddresses() const { return config->getListenAddresses(); }
+    const std::string& getHandoffPath() const { return config->getHandoffPath(); }
 };
 
 } // namespace RPCServer
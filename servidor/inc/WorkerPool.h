@@ -0,0 +1,56 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RPCServer {
+
+/**
+ * @brief Hilos fijos para repartir un cálculo en trozos (validación, cinemática).
+ *
+ * run() publica un trabajo de N trozos, los hilos del pool y el propio llamador
+ * toman el siguiente trozo libre, y run() vuelve cuando terminaron todos. Varios
+ * run() pueden estar en curso a la vez (un pedido RPC y el scheduler); cada uno
+ * avanza aunque el pool esté ocupado porque su llamador también trabaja.
+ */
+class WorkerPool {
+public:
+    // 0 = un hilo por núcleo, contando al llamador
+    explicit WorkerPool(int threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Hilos que pueden trabajar en un mismo run(), el llamador incluido
+    size_t size() const { return threads_.size() + 1; }
+
+    // Llama fn(0) ... fn(chunks - 1) repartidos entre los hilos; fn no debe lanzar
+    void run(size_t chunks, const std::function<void(size_t)>& fn);
+
+private:
+    struct Job {
+        const std::function<void(size_t)>* fn;
+        size_t chunks;
+        size_t next;
+        size_t done;
+    };
+
+    void workerLoop();
+    // Con el mutex tomado: reserva el siguiente trozo y saca el trabajo de la cola
+    // cuando ya no quedan
+    size_t claim(Job& job);
+
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable finished_;
+    std::deque<Job*> jobs_;
+    bool stop_ = false;
+    std::vector<std::thread> threads_;
+};
+
+} // namespace RPCServer
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "ProgramStore.h"
+#include "WorkerPool.h"
+
+namespace RPCServer {
+
+class ReachabilityGrid;
+
+/**
+ * @brief Geometría y límites de movimiento del brazo.
+ *
+ * Los valores por defecto son los de Firmware/robotArm_v0.62sim/config.h; si se
+ * cambian allí hay que cambiarlos aquí.
+ */
+struct ArmGeometry {
+    float lowShankLength = 120.0f;       // LOW_SHANK_LENGTH
+    float highShankLength = 120.0f;      // HIGH_SHANK_LENGTH
+    float endEffectorOffset = 50.0f;     // END_EFFECTOR_OFFSET
+    float zMin = -115.0f;                // Z_MIN
+    float zMax = 120.0f + 30.0f;         // Z_MAX
+    float shanksMinAngleCos = 0.791436948f;  // SHANKS_MIN_ANGLE_COS
+    float shanksMaxAngleCos = -0.774944489f; // SHANKS_MAX_ANGLE_COS
+    float railLength = 200.0f;           // RAIL_LENGTH
+    // Posición después de G28 (INITIAL_X/Y/Z/E0)
+    float initialX = 0.0f;
+    float initialY = 120.0f + 50.0f;
+    float initialZ = 120.0f;
+    float initialE = 0.0f;
+
+    float rMin() const; // R_MIN
+    float rMax() const; // R_MAX
+
+    // Interpolation::isAllowedPosition del firmware, con la misma aritmética en float
+    bool isAllowedPosition(float x, float y, float z, float e) const;
+};
+
+// Estado del firmware al empezar un programa: posición de la máquina, offset de
+// G92 y modo G90/G91. home() es el estado después de G28 en modo absoluto.
+struct ReplayState {
+    float pos[4];     // X Y Z E
+    float offset[4];
+    bool relative = false;
+
+    static ReplayState home(const ArmGeometry& geometry);
+};
+
+// Un movimiento G0/G1 del programa, con los extremos en coordenadas de la máquina
+struct MoveSegment {
+    float from[4];
+    float to[4];
+    float feed = 0;             // F de la línea; 0 si no tenía, como Cmd::valueF
+    int command = 0;            // 1 = primer comando del programa
+    bool joinsPrevious = false; // el comando anterior también fue un G0/G1
+};
+
+// Reproduce el programa como executeCommand/cmdMove del firmware (G90/G91, G92,
+// G28) y deja los movimientos en moves. Devuelve los comandos que el firmware
+// no reconoce.
+size_t replayMoves(const ArmGeometry& geometry, const ProgramCommand* begin, const ProgramCommand* end,
+                   const ReplayState& start, std::vector<MoveSegment>& moves);
+
+// Qué parte del estado inicial cambia el recorrido del programa. position: un
+// G0/G1 corre antes de que el programa fije todos los ejes (G28, coordenadas
+// absolutas); mode: un G0/G1 con coordenadas antes de G90/G91; offset:
+// coordenadas absolutas antes de un G92 del programa. Sin ninguna, replayMoves
+// da lo mismo desde cualquier estado.
+struct StartDependence {
+    bool position = false;
+    bool mode = false;
+    bool offset = false;
+
+    bool any() const { return position || mode || offset; }
+};
+
+StartDependence startDependence(const ProgramCommand* begin, const ProgramCommand* end);
+
+// Primer punto fuera del espacio de trabajo
+struct WorkspaceViolation {
+    int command = 0;  // 1 = primer comando del programa
+    float x = 0, y = 0, z = 0, e = 0;  // coordenadas de la máquina (sin el offset de G92)
+};
+
+struct ValidationReport {
+    bool valid = true;
+    size_t commands = 0;
+    size_t segments = 0;       // movimientos G0/G1
+    size_t samples = 0;        // puntos comprobados
+    size_t violations = 0;     // movimientos que salen del espacio de trabajo
+    WorkspaceViolation first;  // el primero de ellos (si valid es false)
+    size_t unsupported = 0;    // comandos que el firmware no reconoce
+    StartDependence dependsOn; // el resultado vale sólo para el estado inicial dado
+    double elapsedMs = 0;
+};
+
+/**
+ * @brief Comprueba un programa completo contra el espacio de trabajo antes de moverse.
+ *
+ * El firmware sólo descubre un punto inalcanzable durante el movimiento
+ * (isAllowedPosition) y sigue con el resto de la cola. El validador reproduce el
+ * programa como executeCommand/cmdMove (G90/G91, G92, G28), recorre cada
+ * movimiento en línea recta con un punto cada sampleMm, y reparte los
+ * movimientos entre varios hilos: primero se calculan los extremos de cada
+ * segmento (secuencial y barato) y después se muestrean en paralelo.
+ */
+class ProgramValidator {
+public:
+    explicit ProgramValidator(const ArmGeometry& geometry = ArmGeometry(), float sampleMm = 1.0f);
+
+    // Sin pool el muestreo corre en el hilo que llama
+    void setPool(WorkerPool* pool) { pool_ = pool; }
+    // Para ubicar el primer punto fuera de un movimiento que no pasó el muestreo rápido
+    void setGrid(const ReachabilityGrid* grid) { grid_ = grid; }
+    void setSampleMm(float mm) { sampleMm_ = mm; }
+    const ArmGeometry& getGeometry() const { return geometry_; }
+
+    ValidationReport validate(const ProgramCommand* begin, const ProgramCommand* end,
+                              const ReplayState& start) const;
+
+private:
+    struct ChunkResult {
+        size_t samples = 0;
+        size_t violations = 0;
+        WorkspaceViolation first;
+    };
+
+    void sampleChunk(const MoveSegment* begin, const MoveSegment* end, ChunkResult& out) const;
+
+    ArmGeometry geometry_;
+    float sampleMm_;
+    WorkerPool* pool_ = nullptr;
+    const ReachabilityGrid* grid_ = nullptr;
+};
+
+} // namespace RPCServer
@@ -0,0 +1,162 @@
+#include "HotRestart.h"
+#include "XmlRpcSocket.h"
+#include "XmlRpcDispatch.h"
+#include "XmlRpcUtil.h"
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace RPCServer {
+
+// Descriptores por mensaje (XmlRpcSocket::sendFds admite hasta 64)
+static const size_t FDS_PER_MESSAGE = 32;
+
+// SOCK_SEQPACKET conserva los límites de cada mensaje junto con sus descriptores
+static bool makeAddress(const std::string& path, sockaddr_un& addr) {
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+static int connectTo(const sockaddr_un& addr) {
+    int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void closeAll(HandoffState& state) {
+    for (int fd : state.listeners) ::close(fd);
+    for (int fd : state.connections) ::close(fd);
+    if (state.controlFd >= 0) ::close(state.controlFd);
+    if (state.serial.fd >= 0) ::close(state.serial.fd);
+    state = HandoffState();
+}
+
+bool HotRestart::takeOver(const std::string& path, HandoffState& state, int timeoutMs) {
+    sockaddr_un addr;
+    if (!makeAddress(path, addr)) return false;
+    int fd = connectTo(addr);
+    if (fd < 0) return false; // no hay servidor corriendo
+
+    timeval tv{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    state = HandoffState();
+    bool done = false;
+    while (!done) {
+        std::string data;
+        std::vector<int> fds;
+        if (!XmlRpc::XmlRpcSocket::recvFds(fd, data, fds)) {
+            XmlRpc::XmlRpcUtil::error("HotRestart::takeOver: no se completó la entrega (%s).",
+                                      XmlRpc::XmlRpcSocket::getErrorMsg().c_str());
+            for (int f : fds) ::close(f);
+            closeAll(state);
+            ::close(fd);
+            return false;
+        }
+
+        std::istringstream lines(data);
+        std::string line;
+        size_t next = 0;
+        while (std::getline(lines, line)) {
+            if (line == "end") { done = true; break; }
+            if (next >= fds.size()) break; // línea sin descriptor: se ignora
+            int passed = fds[next++];
+            if (line == "listen") state.listeners.push_back(passed);
+            else if (line == "conn") state.connections.push_back(passed);
+            else if (line == "control") state.controlFd = passed;
+            else if (line.compare(0, 7, "serial ") == 0) {
+                std::istringstream in(line.substr(7));
+                int absolute = 1, motors = 0, fan = 0;
+                in >> state.serial.baud >> absolute >> motors >> fan;
+                in.get(); // separador
+                std::getline(in, state.serial.port);
+                state.serial.absolute = absolute != 0;
+                state.serial.motorsOn = motors != 0;
+                state.serial.fanOn = fan != 0;
+                state.serial.fd = passed;
+            } else {
+                ::close(passed);
+            }
+        }
+        for (; next < fds.size(); ++next) ::close(fds[next]);
+    }
+
+    ::close(fd);
+    XmlRpc::XmlRpcUtil::log(1, "HotRestart::takeOver: %d sockets en escucha, %d conexiones, serie %s",
+                            int(state.listeners.size()), int(state.connections.size()),
+                            state.serial.fd >= 0 ? state.serial.port.c_str() : "-");
+    return true;
+}
+
+int HotRestart::listen(const std::string& path) {
+    sockaddr_un addr;
+    if (!makeAddress(path, addr)) return -1;
+
+    // Un archivo que nadie atiende quedó de un servidor que terminó
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = connectTo(addr);
+        if (probe >= 0) {
+            ::close(probe);
+            errno = EADDRINUSE;
+            return -1;
+        }
+        unlink(path.c_str());
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 4) != 0 ||
+        !XmlRpc::XmlRpcSocket::setNonBlocking(fd)) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool HotRestart::handOver(int fd, const HandoffState& state) {
+    std::vector<std::pair<std::string, int>> items;
+    for (int l : state.listeners) items.emplace_back("listen", l);
+    for (int c : state.connections) items.emplace_back("conn", c);
+    if (state.controlFd >= 0) items.emplace_back("control", state.controlFd);
+    if (state.serial.fd >= 0) {
+        std::ostringstream line;
+        line << "serial " << state.serial.baud << ' ' << int(state.serial.absolute) << ' '
+             << int(state.serial.motorsOn) << ' ' << int(state.serial.fanOn) << ' ' << state.serial.port;
+        items.emplace_back(line.str(), state.serial.fd);
+    }
+
+    for (size_t i = 0; i < items.size(); i += FDS_PER_MESSAGE) {
+        std::string data;
+        std::vector<int> fds;
+        for (size_t j = i; j < items.size() && j < i + FDS_PER_MESSAGE; ++j) {
+            data += items[j].first + "\n";
+            fds.push_back(items[j].second);
+        }
+        if (!XmlRpc::XmlRpcSocket::sendFds(fd, data, fds)) return false;
+    }
+    return XmlRpc::XmlRpcSocket::sendFds(fd, "end\n", std::vector<int>());
+}
+
+unsigned HandoffListener::handleEvent(unsigned /*eventType*/) {
+    int client = ::accept4(getfd(), nullptr, nullptr, SOCK_CLOEXEC);
+    if (client >= 0) {
+        // La entrega se hace con el socket bloqueante, fuera de work()
+        onRequest_(client);
+    }
+    return XmlRpc::XmlRpcDispatch::ReadableEvent;
+}
+
+} // namespace RPCServer
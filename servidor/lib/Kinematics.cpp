@@ -0,0 +1,152 @@
+#include "Kinematics.h"
+#include "ReachabilityGrid.h"
+#include <cmath>
+
+namespace RPCServer {
+
+// Por debajo de esto no vale la pena repartir un lote entre hilos
+static const size_t MIN_POINTS_PER_CHUNK = 4096;
+// Trozos por hilo
+static const size_t CHUNKS_PER_THREAD = 4;
+// Puntos calculados juntos; con -O2 gcc sólo vectoriza lazos de iteraciones conocidas
+// (el Makefile compila este archivo con -fno-math-errno -fno-trapping-math)
+static const int IK_BLOCK = 8;
+
+static const float IK_PI = 3.14159265358979f;  // PI de Arduino.h en float
+static const float IK_HALF_PI = 1.57079632679490f;
+
+static inline float sq(float v) { return v * v; }
+
+// RobotGeometry::calculateGrad con la aritmética del AVR (double es float)
+bool InverseKinematics::solve(float x, float y, float z, float e, JointAngles& angles) const {
+    const ArmGeometry& g = geometry_;
+    float rrot_ee = std::hypot(x, y);
+    float rrot = rrot_ee - g.endEffectorOffset; // radio visto desde arriba
+    float rside = std::hypot(rrot, z);          // radio visto de costado
+    float rside_2 = sq(rside);
+    float low_2 = sq(g.lowShankLength);
+    float high_2 = sq(g.highShankLength);
+
+    angles.rot = std::asin(x / rrot_ee);
+    angles.high = IK_PI - std::acos((low_2 + high_2 - rside_2) / (2 * g.lowShankLength * g.highShankLength));
+    if (z > 0) {
+        angles.low = std::acos(z / rside) - std::acos((low_2 - high_2 + rside_2) / (2 * g.lowShankLength * rside));
+    } else {
+        angles.low = IK_PI - std::asin(rrot / rside) - std::acos((low_2 - high_2 + rside_2) / (2 * g.lowShankLength * rside));
+    }
+    angles.high = angles.high + angles.low;
+
+    bool allowed = grid_ ? grid_->isAllowedPosition(x, y, z, e) : g.isAllowedPosition(x, y, z, e);
+    return allowed
+        && !std::isnan(angles.rot) && !std::isnan(angles.low) && !std::isnan(angles.high);
+}
+
+// asin(s) para 0 <= s <= 0.5, con z = s * s: polinomio de asinf de Cephes
+static inline float asinKernel(float s, float z) {
+    float p = (((4.2163199048e-2f * z + 2.4181311049e-2f) * z + 4.5470025998e-2f) * z
+               + 7.4953002686e-2f) * z + 1.6666752422e-1f;
+    return s + s * z * p;
+}
+
+// asin y acos sin saltos: para |x| > 0.5 se usa asin(x) = pi/2 - 2 asin(sqrt((1 - x) / 2)).
+// Fuera de [-1, 1] la raíz da NaN, como en la librería.
+static inline float asinFast(float x) {
+    float a = std::fabs(x);
+    bool big = a > 0.5f;
+    float z = big ? 0.5f * (1.0f - a) : a * a;
+    float s = big ? std::sqrt(z) : a;
+    float p = asinKernel(s, z);
+    float r = big ? IK_HALF_PI - 2.0f * p : p;
+    return x < 0 ? -r : r;
+}
+
+static inline float acosFast(float x) {
+    float a = std::fabs(x);
+    bool big = a > 0.5f;
+    float z = big ? 0.5f * (1.0f - a) : a * a;
+    float s = big ? std::sqrt(z) : a;
+    float p = asinKernel(s, z);
+    float nearOne = x < 0 ? IK_PI - 2.0f * p : 2.0f * p;
+    float nearZero = IK_HALF_PI - (x < 0 ? -p : p);
+    return big ? nearOne : nearZero;
+}
+
+InverseKinematics::InverseKinematics(const ArmGeometry& geometry) : geometry_(geometry) {}
+
+void InverseKinematics::solveBatch(const PointBatch& points, JointBatch& joints) const {
+    size_t n = points.size();
+    joints.rot.resize(n);
+    joints.low.resize(n);
+    joints.high.resize(n);
+    joints.reachable.resize(n);
+
+    size_t threads = pool_ ? pool_->size() : 1;
+    size_t chunks = n / MIN_POINTS_PER_CHUNK;
+    if (chunks > threads * CHUNKS_PER_THREAD) chunks = threads * CHUNKS_PER_THREAD;
+    if (chunks == 0) chunks = 1;
+    auto solveChunk = [&](size_t i) { solveRange(points, joints, n * i / chunks, n * (i + 1) / chunks); };
+    if (pool_) {
+        pool_->run(chunks, solveChunk);
+    } else {
+        for (size_t i = 0; i < chunks; ++i) solveChunk(i);
+    }
+
+    joints.reachableCount = 0;
+    for (uint8_t r : joints.reachable) joints.reachableCount += r;
+}
+
+void InverseKinematics::solveRange(const PointBatch& points, JointBatch& joints, size_t from, size_t to) const {
+    const float ee = geometry_.endEffectorOffset;
+    const float lowLength = geometry_.lowShankLength;
+    const float low_2 = sq(lowLength);
+    const float high_2 = sq(geometry_.highShankLength);
+    const float highCos = 1.0f / (2 * lowLength * geometry_.highShankLength);
+    const float rMax2 = sq(geometry_.rMax());
+    const float rMin2 = sq(geometry_.rMin());
+    const float zMin = geometry_.zMin, zMax = geometry_.zMax, railLength = geometry_.railLength;
+
+    for (size_t block = from; block < to; block += IK_BLOCK) {
+        // El último bloque repite el último punto
+        float x[IK_BLOCK], y[IK_BLOCK], z[IK_BLOCK], e[IK_BLOCK];
+        for (int j = 0; j < IK_BLOCK; ++j) {
+            size_t i = block + j < to ? block + j : to - 1;
+            x[j] = points.x[i];
+            y[j] = points.y[i];
+            z[j] = points.z[i];
+            e[j] = points.e[i];
+        }
+
+        float rot[IK_BLOCK], low[IK_BLOCK], high[IK_BLOCK];
+        int ok[IK_BLOCK];
+        for (int j = 0; j < IK_BLOCK; ++j) {
+            float r2 = x[j] * x[j] + y[j] * y[j];
+            float rrot_ee = std::sqrt(r2);
+            float rrot = rrot_ee - ee;
+            float rside_2 = rrot * rrot + z[j] * z[j];
+            float rside = std::sqrt(rside_2);
+            float elbow = acosFast((low_2 - high_2 + rside_2) / (2 * lowLength * rside));
+            float a = asinFast(x[j] / rrot_ee);
+            float c = z[j] > 0 ? acosFast(z[j] / rside) - elbow
+                               : IK_PI - asinFast(rrot / rside) - elbow;
+            float b = IK_PI - acosFast((low_2 + high_2 - rside_2) * highCos) + c;
+            // Mismo criterio que isAllowedPosition: el módulo al cuadrado es rrot^2 + z^2
+            bool allowed = (rside_2 <= rMax2) & (rside_2 >= rMin2) & (r2 > 0)
+                         & (z[j] >= zMin) & (z[j] <= zMax) & (e[j] <= railLength)
+                         & (a == a) & (b == b) & (c == c);
+            rot[j] = allowed ? a : 0.0f;
+            low[j] = allowed ? c : 0.0f;
+            high[j] = allowed ? b : 0.0f;
+            ok[j] = allowed;
+        }
+
+        size_t count = to - block < size_t(IK_BLOCK) ? to - block : size_t(IK_BLOCK);
+        for (size_t j = 0; j < count; ++j) {
+            joints.rot[block + j] = rot[j];
+            joints.low[block + j] = low[j];
+            joints.high[block + j] = high[j];
+            joints.reachable[block + j] = uint8_t(ok[j]);
+        }
+    }
+}
+
+} // namespace RPCServer
@@ -0,0 +1,155 @@
+#include "MotionPlanner.h"
+#include <chrono>
+#include <cmath>
+
+namespace RPCServer {
+
+static const double MP_PI = 3.14159265358979;
+
+float moveLength(const MoveSegment& s) {
+    float a = s.to[0] - s.from[0];
+    float b = s.to[1] - s.from[1];
+    float c = s.to[2] - s.from[2];
+    float e = std::fabs(s.to[3] - s.from[3]);
+    float dist = std::sqrt(a * a + b * b + c * c);
+    return dist < e ? e : dist;
+}
+
+float moveNominalSpeed(float dist, float v) {
+    if (v < 5) v = std::sqrt(dist) * 10; // sin F (0) o muy lento
+    if (v < 5) v = 5;
+    return v;
+}
+
+// Interpolation::getDirection: unitario en XYZE
+static void direction(const MoveSegment& s, float dir[4]) {
+    float d[4];
+    for (int a = 0; a < 4; ++a) d[a] = s.to[a] - s.from[a];
+    float n = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2] + d[3] * d[3]);
+    for (int a = 0; a < 4; ++a) dir[a] = n > 0 ? d[a] / n : 0;
+}
+
+MotionPlanner::MotionPlanner(const ArmGeometry& geometry, const MotionLimits& limits)
+  : geometry_(geometry), limits_(limits) {}
+
+float MotionPlanner::junctionSpeed(const float u0[4], const float u1[4]) const {
+    float cosTheta = -(u0[0] * u1[0] + u0[1] * u1[1] + u0[2] * u1[2] + u0[3] * u1[3]);
+    if (cosTheta > 0.999999f) return 0.0f;   // vuelve por el mismo camino
+    if (cosTheta < -0.999999f) return 1e9f;  // sigue derecho
+    float sinHalfTheta = std::sqrt(0.5f * (1.0f - cosTheta));
+    return std::sqrt(limits_.acceleration * limits_.junctionDeviation * sinHalfTheta / (1.0f - sinHalfTheta));
+}
+
+// Interpolation::planProfile
+float MotionPlanner::profileTime(float length, float speed, float entry, float exit) const {
+    if (length <= 0) return 0.0f;
+    float acc = limits_.acceleration;
+    float maxExit = std::sqrt(entry * entry + 2 * acc * length);
+    if (exit > maxExit) exit = maxExit;
+    float minExit2 = entry * entry - 2 * acc * length;
+    if (minExit2 > exit * exit) exit = std::sqrt(minExit2);
+    float peak = std::fmax(speed, std::fmax(entry, exit));
+    float up = (peak * peak - entry * entry) / (2 * acc);
+    float down = (peak * peak - exit * exit) / (2 * acc);
+    if (up + down > length) {
+        peak = std::sqrt((2 * acc * length + entry * entry + exit * exit) * 0.5f);
+        up = (peak * peak - entry * entry) / (2 * acc);
+        down = length - up;
+    }
+    float cruise = length - up - down;
+    return (peak - entry) / acc + (peak > 0 ? cruise / peak : 0.0f) + (peak - exit) / acc;
+}
+
+// lookAheadExitSpeed para cada movimiento: de atrás hacia adelante sobre los que
+// vería en cola, frenando hasta parar al final del último
+void MotionPlanner::exitSpeeds(const std::vector<Move>& moves, size_t horizon, std::vector<float>& exits) const {
+    const float acc = limits_.acceleration;
+    size_t n = moves.size();
+    exits.assign(n, 0.0f);
+    if (n == 0) return;
+    if (horizon == 0) {
+        for (size_t i = n - 1; i-- > 0;) {
+            const Move& next = moves[i + 1];
+            exits[i] = std::fmin(next.entryMax, std::sqrt(exits[i + 1] * exits[i + 1] + 2 * acc * next.length));
+        }
+        return;
+    }
+    for (size_t i = 0; i + 1 < n; ++i) {
+        size_t last = i + horizon < n - 1 ? i + horizon : n - 1;
+        float exit = 0.0f;
+        for (size_t j = last; j > i; --j)
+            exit = std::fmin(moves[j].entryMax, std::sqrt(exit * exit + 2 * acc * moves[j].length));
+        exits[i] = exit;
+    }
+}
+
+double MotionPlanner::chainTime(const std::vector<Move>& moves, const std::vector<float>& exits) const {
+    double total = 0;
+    float entry = 0.0f;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        total += profileTime(moves[i].length, moves[i].speed, entry, exits[i]);
+        entry = moves[i].length > 0 ? exits[i] : 0.0f;
+    }
+    return total;
+}
+
+CycleTimeReport MotionPlanner::estimate(const ProgramCommand* begin, const ProgramCommand* end,
+                                        const ReplayState& start, int horizon) const {
+    auto started = std::chrono::steady_clock::now();
+    CycleTimeReport report;
+    report.commands = size_t(end - begin);
+    if (horizon < 1) horizon = 1;
+    if (horizon > limits_.queueSize) horizon = limits_.queueSize;
+    report.horizon = horizon;
+
+    for (const ProgramCommand* c = begin; c != end; ++c)
+        if (c->id == 'G' && c->num == 4 && !std::isnan(c->s) && c->s > 0) report.dwellSeconds += c->s;
+
+    std::vector<MoveSegment> segments;
+    segments.reserve(report.commands);
+    replayMoves(geometry_, begin, end, start, segments);
+    report.segments = segments.size();
+
+    std::vector<Move> moves(segments.size());
+    float previousDir[4] = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < segments.size(); ++i) {
+        Move& m = moves[i];
+        m.length = moveLength(segments[i]);
+        m.speed = moveNominalSpeed(m.length, segments[i].feed);
+        float dir[4];
+        direction(segments[i], dir);
+        // El firmware corta la anticipación en un comando que no es G0/G1 y en un
+        // movimiento de largo 0
+        bool joins = i > 0 && segments[i].joinsPrevious && moves[i - 1].length > 0 && m.length > 0;
+        m.entryMax = joins ? std::fmin(junctionSpeed(previousDir, dir), std::fmin(moves[i - 1].speed, m.speed)) : 0.0f;
+        for (int a = 0; a < 4; ++a) previousDir[a] = dir[a];
+
+        if (m.length > 0) {
+            if (m.entryMax <= 0) ++report.chains;
+            report.pathMm += m.length;
+            report.cosineSeconds += m.length / m.speed;
+            // -cos(pi t / T) / 2: aceleración máxima pi^2 / 2 * v^2 / dist
+            double peak = MP_PI * MP_PI / 2 * double(m.speed) * m.speed / m.length;
+            if (peak > report.cosinePeakAcceleration) report.cosinePeakAcceleration = peak;
+            report.stopSeconds += profileTime(m.length, m.speed, 0.0f, 0.0f);
+        }
+    }
+
+    std::vector<float> exits;
+    exitSpeeds(moves, size_t(horizon), exits);
+    report.lookAheadSeconds = chainTime(moves, exits);
+    exitSpeeds(moves, size_t(limits_.queueSize), exits);
+    report.queueSeconds = chainTime(moves, exits);
+    exitSpeeds(moves, 0, exits);
+    report.unlimitedSeconds = chainTime(moves, exits);
+
+    report.cosineSeconds += report.dwellSeconds;
+    report.stopSeconds += report.dwellSeconds;
+    report.lookAheadSeconds += report.dwellSeconds;
+    report.queueSeconds += report.dwellSeconds;
+    report.unlimitedSeconds += report.dwellSeconds;
+    report.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
+
+} // namespace RPCServer
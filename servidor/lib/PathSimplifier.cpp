@@ -0,0 +1,171 @@
+#include "PathSimplifier.h"
+#include "MotionPlanner.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace RPCServer {
+
+// Con tolerancia 0 se unen los puntos a menos de esto de la recta (el redondeo
+// de las coordenadas en float y de los tres decimales de la línea)
+static const float COLLINEAR_MM = 0.001f;
+
+static bool isMove(const ProgramCommand& c) {
+    return c.id == 'G' && (c.num == 0 || c.num == 1);
+}
+
+// Mismo F, con NaN (sin F) igual a NaN
+static bool sameFeed(float a, float b) {
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Distancia de p al segmento ab en XYZE. Contra el segmento y no contra la recta:
+// un punto alineado pero más allá de un extremo (el brazo vuelve) se conserva.
+static float segmentDistance(const float* p, const float* a, const float* b) {
+    float ab[4], ap[4];
+    float ab2 = 0, dot = 0;
+    for (int i = 0; i < 4; ++i) {
+        ab[i] = b[i] - a[i];
+        ap[i] = p[i] - a[i];
+        ab2 += ab[i] * ab[i];
+        dot += ap[i] * ab[i];
+    }
+    float t = ab2 > 0 ? dot / ab2 : 0.0f;
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    float d2 = 0;
+    for (int i = 0; i < 4; ++i) {
+        float d = ap[i] - t * ab[i];
+        d2 += d * d;
+    }
+    return std::sqrt(d2);
+}
+
+// Ramer-Douglas-Peucker sin recursión: los extremos quedan siempre
+static void douglasPeucker(const std::vector<const float*>& points, float tolerance, std::vector<uint8_t>& keep) {
+    size_t n = points.size();
+    keep.assign(n, 0);
+    keep[0] = keep[n - 1] = 1;
+    std::vector<std::pair<size_t, size_t>> pending;
+    pending.emplace_back(0, n - 1);
+    while (!pending.empty()) {
+        size_t first = pending.back().first, last = pending.back().second;
+        pending.pop_back();
+        float worst = 0;
+        size_t index = first;
+        for (size_t i = first + 1; i < last; ++i) {
+            float d = segmentDistance(points[i], points[first], points[last]);
+            if (d > worst) {
+                worst = d;
+                index = i;
+            }
+        }
+        if (worst > tolerance) {
+            keep[index] = 1;
+            pending.emplace_back(first, index);
+            pending.emplace_back(index, last);
+        }
+    }
+}
+
+PathSimplifier::PathSimplifier(const ArmGeometry& geometry) : geometry_(geometry) {}
+
+SimplifyReport PathSimplifier::simplify(const ProgramCommand* begin, const ProgramCommand* end,
+                                        const ReplayState& start, float tolerance,
+                                        std::vector<ProgramCommand>& out) const {
+    auto started = std::chrono::steady_clock::now();
+    SimplifyReport report;
+    report.tolerance = tolerance;
+    report.commandsBefore = size_t(end - begin);
+    for (const ProgramCommand* c = begin; c != end; ++c)
+        report.serialBytesBefore += programCommandLine(*c).size() + 2;
+
+    std::vector<MoveSegment> segments;
+    segments.reserve(report.commandsBefore);
+    replayMoves(geometry_, begin, end, start, segments);
+    report.movesBefore = segments.size();
+
+    out.clear();
+    out.reserve(report.commandsBefore);
+    const float threshold = tolerance > COLLINEAR_MM ? tolerance : COLLINEAR_MM;
+    bool relative = start.relative;
+    size_t segment = 0;  // cada G0/G1 tiene su MoveSegment, en orden
+    std::vector<const float*> points;
+    std::vector<uint8_t> keep;
+    const ProgramCommand* c = begin;
+    while (c != end) {
+        if (!isMove(*c)) {
+            if (c->id == 'G' && (c->num == 90 || c->num == 91)) relative = (c->num == 91);
+            out.push_back(*c);
+            ++c;
+            continue;
+        }
+        const ProgramCommand* runEnd = c + 1;
+        while (runEnd != end && isMove(*runEnd) && runEnd->num == c->num && sameFeed(runEnd->f, c->f)) ++runEnd;
+        size_t count = size_t(runEnd - c);
+        const MoveSegment* moves = segments.data() + segment;
+        segment += count;
+
+        points.resize(count + 1);
+        points[0] = moves[0].from;
+        for (size_t i = 0; i < count; ++i) points[i + 1] = moves[i].to;
+        douglasPeucker(points, threshold, keep);
+
+        // Desde el último punto que quedó: ejes que se escribieron, último valor
+        // (G90) o suma (G91) y duración con la velocidad de cada movimiento
+        bool touched[4] = { false, false, false, false };
+        float last[4] = { 0, 0, 0, 0 };
+        double sum[4] = { 0, 0, 0, 0 };
+        double seconds = 0;
+        size_t previous = 0;
+        for (size_t i = 1; i <= count; ++i) {
+            const ProgramCommand& cmd = c[i - 1];
+            const float values[4] = { cmd.x, cmd.y, cmd.z, cmd.e };
+            for (int a = 0; a < 4; ++a) {
+                if (std::isnan(values[a])) continue;
+                touched[a] = true;
+                last[a] = values[a];
+                sum[a] += values[a];
+            }
+            float length = moveLength(moves[i - 1]);
+            if (length > 0) seconds += length / moveNominalSpeed(length, moves[i - 1].feed);
+            if (!keep[i]) continue;
+
+            ProgramCommand merged = cmd;
+            float* axes[4] = { &merged.x, &merged.y, &merged.z, &merged.e };
+            for (int a = 0; a < 4; ++a)
+                *axes[a] = !touched[a] ? NAN : relative ? float(sum[a]) : last[a];
+            // Sin F la velocidad saldría del largo nuevo: se fija la que conserva la duración
+            if (i - previous > 1 && moves[i - 1].feed < 5 && seconds > 0) {
+                MoveSegment span;
+                for (int a = 0; a < 4; ++a) {
+                    span.from[a] = points[previous][a];
+                    span.to[a] = points[i][a];
+                }
+                float speed = float(moveLength(span) / seconds);
+                merged.f = speed < 5 ? 5.0f : speed;
+            }
+            out.push_back(merged);
+
+            for (int a = 0; a < 4; ++a) {
+                touched[a] = false;
+                sum[a] = 0;
+            }
+            seconds = 0;
+            previous = i;
+        }
+        c = runEnd;
+    }
+
+    report.commandsAfter = out.size();
+    for (const ProgramCommand& cmd : out) {
+        if (isMove(cmd)) ++report.movesAfter;
+        report.serialBytesAfter += programCommandLine(cmd).size() + 2;
+    }
+    report.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
+
+} // namespace RPCServer
@@ -0,0 +1,303 @@
+#include "ProgramStore.h"
+#include "XmlRpcValue.h"
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace RPCServer {
+
+static const char PROGRAM_MAGIC[4] = { 'R', 'P', 'R', 'G' };
+static const uint32_t PROGRAM_FORMAT_VERSION = 1;
+static const size_t MAX_LINE_LENGTH = 256;
+static const size_t MAX_NAME_LENGTH = 64;
+
+std::string programCommandLine(const ProgramCommand& cmd) {
+    std::ostringstream ss; ss << std::fixed << std::setprecision(3);
+    ss << cmd.id << cmd.num;
+    const char letters[] = { 'X', 'Y', 'Z', 'E', 'F', 'S' };
+    const float values[] = { cmd.x, cmd.y, cmd.z, cmd.e, cmd.f, cmd.s };
+    for (int i = 0; i < 6; ++i)
+        if (!std::isnan(values[i])) ss << ' ' << letters[i] << values[i];
+    return ss.str();
+}
+
+bool isValidProgramImage(const char* data, size_t size) {
+    if (size < sizeof(ProgramHeader)) return false;
+    ProgramHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, PROGRAM_MAGIC, sizeof(PROGRAM_MAGIC)) != 0 ||
+        header.version != PROGRAM_FORMAT_VERSION ||
+        size != sizeof(ProgramHeader) + size_t(header.count) * sizeof(ProgramCommand))
+        return false;
+    for (size_t i = 0; i < header.count; ++i) {
+        char id = data[sizeof(ProgramHeader) + i * sizeof(ProgramCommand)]; // ProgramCommand::id
+        if (id != 'G' && id != 'M') return false;
+    }
+    return true;
+}
+
+void buildProgramImage(const ProgramCommand* begin, const ProgramCommand* end, std::vector<char>& image) {
+    size_t count = size_t(end - begin);
+    ProgramHeader header;
+    std::memcpy(header.magic, PROGRAM_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_FORMAT_VERSION;
+    header.count = uint32_t(count);
+    header.reserved = 0;
+    image.resize(sizeof(header) + count * sizeof(ProgramCommand));
+    std::memcpy(image.data(), &header, sizeof(header));
+    if (count > 0) std::memcpy(image.data() + sizeof(header), begin, count * sizeof(ProgramCommand));
+}
+
+// ========== ProgramCompiler ==========
+
+ProgramCompiler::ProgramCompiler() : image_(sizeof(ProgramHeader)) {}
+
+void ProgramCompiler::feed(const char* data, size_t len) {
+    const char* end = data + len;
+    while (data < end && error_.empty()) {
+        const char* nl = static_cast<const char*>(std::memchr(data, '\n', end - data));
+        const char* lineEnd = nl ? nl : end;
+        if (partial_.size() + (lineEnd - data) > MAX_LINE_LENGTH) {
+            ++lineNo_;
+            error_ = "línea " + std::to_string(lineNo_) + ": demasiado larga";
+            return;
+        }
+        if (!nl) {
+            partial_.append(data, end);
+            return;
+        }
+        if (partial_.empty()) {
+            compileLine(data, nl);
+        } else {
+            partial_.append(data, nl);
+            compileLine(partial_.data(), partial_.data() + partial_.size());
+            partial_.clear();
+        }
+        data = nl + 1;
+    }
+}
+
+bool ProgramCompiler::finish() {
+    if (error_.empty() && !partial_.empty()) {
+        compileLine(partial_.data(), partial_.data() + partial_.size());
+        partial_.clear();
+    }
+    if (error_.empty() && count_ == 0) error_ = "el programa no tiene comandos";
+    return error_.empty();
+}
+
+void ProgramCompiler::takeImage(std::vector<char>& image) {
+    ProgramHeader header;
+    std::memcpy(header.magic, PROGRAM_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_FORMAT_VERSION;
+    header.count = uint32_t(count_);
+    header.reserved = 0;
+    std::memcpy(image_.data(), &header, sizeof(header));
+    image.swap(image_);
+    image_.assign(sizeof(ProgramHeader), 0);
+    count_ = 0;
+}
+
+// Misma sintaxis que Command::processMessage del firmware: se ignoran los espacios
+// y las mayúsculas, "G1X10 Y20" equivale a "g1 x10 y20"
+bool ProgramCompiler::compileLine(const char* p, const char* end) {
+    ++lineNo_;
+    char text[MAX_LINE_LENGTH + 1];
+    size_t n = 0;
+    int comment = 0;
+    for (; p < end; ++p) {
+        char c = *p;
+        if (c == ';' || c == '*') break;
+        if (c == '(') { ++comment; continue; }
+        if (c == ')') { if (comment > 0) --comment; continue; }
+        if (comment > 0 || std::isspace((unsigned char)c)) continue;
+        text[n++] = char(std::toupper((unsigned char)c));
+    }
+    text[n] = '\0';
+
+    const char* q = text;
+    if (*q == 'N') {                  // número de línea
+        ++q;
+        while (std::isdigit((unsigned char)*q)) ++q;
+    }
+    if (*q == '\0') return true;      // línea vacía o sólo comentario
+
+    auto fail = [this](const std::string& msg) {
+        error_ = "línea " + std::to_string(lineNo_) + ": " + msg;
+        return false;
+    };
+
+    ProgramCommand cmd;
+    std::memset(&cmd, 0, sizeof(cmd));
+    cmd.x = cmd.y = cmd.z = cmd.e = cmd.f = cmd.s = NAN;
+    if (*q != 'G' && *q != 'M') return fail("se esperaba un comando G o M");
+    cmd.id = *q++;
+    if (!std::isdigit((unsigned char)*q)) return fail("falta el número del comando");
+    cmd.num = 0;
+    while (std::isdigit((unsigned char)*q) && cmd.num < 100000) cmd.num = cmd.num * 10 + (*q++ - '0');
+
+    while (*q) {
+        char letter = *q++;
+        // Sin exponentes: en "X10E5" la E es el eje, no parte del número
+        const char* start = q;
+        if (*q == '-' || *q == '+') ++q;
+        bool digits = false;
+        while (std::isdigit((unsigned char)*q) || *q == '.') { digits = digits || *q != '.'; ++q; }
+        if (!digits) return fail(std::string("falta el valor de ") + letter);
+        char number[MAX_LINE_LENGTH + 1];
+        std::memcpy(number, start, q - start);
+        number[q - start] = '\0';
+        float value = std::strtof(number, nullptr);
+        switch (letter) {
+            case 'X': cmd.x = value; break;
+            case 'Y': cmd.y = value; break;
+            case 'Z': cmd.z = value; break;
+            case 'E': cmd.e = value; break;
+            case 'F': cmd.f = value; break;
+            case 'S': cmd.s = value; break;
+            default: return fail(std::string("parámetro ") + letter + " no soportado");
+        }
+    }
+
+    const char* bytes = reinterpret_cast<const char*>(&cmd);
+    image_.insert(image_.end(), bytes, bytes + sizeof(cmd));
+    ++count_;
+    return true;
+}
+
+// ========== MappedProgram ==========
+
+MappedProgram::MappedProgram(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("no se pudo abrir " + path + ": " + std::strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(ProgramHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + " no es un programa compilado");
+    }
+    mapSize_ = size_t(st.st_size);
+    map_ = mmap(nullptr, mapSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // el mapeo sigue válido
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        throw std::runtime_error("no se pudo mapear " + path + ": " + std::strerror(errno));
+    }
+
+    const ProgramHeader* header = static_cast<const ProgramHeader*>(map_);
+    if (!isValidProgramImage(static_cast<const char*>(map_), mapSize_)) {
+        munmap(map_, mapSize_);
+        map_ = nullptr;
+        throw std::runtime_error(path + " no es un programa compilado o está dañado");
+    }
+    count_ = header->count;
+    commands_ = reinterpret_cast<const ProgramCommand*>(static_cast<const char*>(map_) + sizeof(ProgramHeader));
+    madvise(map_, mapSize_, MADV_SEQUENTIAL);
+}
+
+MappedProgram::~MappedProgram() {
+    if (map_) munmap(map_, mapSize_);
+}
+
+// ========== ProgramStore ==========
+
+ProgramStore::ProgramStore(const std::string& directory) {
+    setDirectory(directory);
+}
+
+void ProgramStore::setDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    directory_ = directory;
+    cache_.clear();
+    // Si no se puede crear, save() informa el error
+    ::mkdir(directory_.c_str(), 0755);
+}
+
+bool ProgramStore::isValidName(const std::string& name) {
+    if (name.empty() || name.size() > MAX_NAME_LENGTH) return false;
+    for (char c : name)
+        if (!std::isalnum((unsigned char)c) && c != '_' && c != '-') return false;
+    return true;
+}
+
+std::string ProgramStore::pathFor(const std::string& name) const {
+    return directory_ + "/" + name + ".prg";
+}
+
+void ProgramStore::save(const std::string& name, const std::vector<char>& image) {
+    if (!isValidProgramImage(image.data(), image.size()))
+        throw std::runtime_error("la imagen de '" + name + "' no es un programa compilado");
+    std::string path, tmp;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        path = pathFor(name);
+    }
+    tmp = path + ".tmp";
+
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::runtime_error("no se pudo crear " + tmp + ": " + std::strerror(errno));
+    size_t written = 0;
+    while (written < image.size()) {
+        ssize_t n = ::write(fd, image.data() + written, image.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += size_t(n);
+    }
+    bool ok = written == image.size();
+    int error = errno;
+    if (::close(fd) != 0 && ok) { ok = false; error = errno; }
+    // rename reemplaza el archivo de una vez: una ejecución en curso conserva su mapeo
+    if (ok && ::rename(tmp.c_str(), path.c_str()) != 0) { ok = false; error = errno; }
+    if (!ok) {
+        ::unlink(tmp.c_str());
+        throw std::runtime_error("no se pudo guardar " + path + ": " + std::strerror(error));
+    }
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    cache_.erase(name);
+}
+
+std::shared_ptr<const MappedProgram> ProgramStore::load(const std::string& name) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    std::string path = pathFor(name);
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) throw std::runtime_error("no existe el programa '" + name + "'");
+
+    // Otro proceso (reinicio en caliente) pudo reemplazar el archivo
+    auto it = cache_.find(name);
+    if (it != cache_.end() && it->second.inode == st.st_ino && it->second.mtime == st.st_mtime)
+        return it->second.program;
+
+    std::shared_ptr<const MappedProgram> program = std::make_shared<MappedProgram>(path);
+    cache_[name] = Cached{program, st.st_ino, st.st_mtime};
+    return program;
+}
+
+// ========== ProgramUploadSink ==========
+
+bool ProgramUploadSink::write(const char* data, size_t len) {
+    compiler_.feed(data, len); // los errores se informan con su línea en finish()
+    return true;
+}
+
+bool ProgramUploadSink::finish(XmlRpc::XmlRpcValue& value) {
+    if (!compiler_.finish()) {
+        value["error"] = compiler_.getError();
+        return true;
+    }
+    value["commands"] = int(compiler_.getCount());
+    value["image"] = XmlRpc::XmlRpcValue((void*)"", 0);
+    XmlRpc::XmlRpcValue::BinaryData& image = value["image"];
+    compiler_.takeImage(image);
+    return true;
+}
+
+} // namespace RPCServer
@@ -0,0 +1,220 @@
+#include "ReachabilityGrid.h"
+#include "XmlRpcUtil.h"
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace RPCServer {
+
+const float ReachabilityGrid::DEFAULT_VOXEL_MM = 2.0f;
+
+static const char GRID_MAGIC[4] = { 'R', 'G', 'R', 'D' };
+static const uint32_t GRID_FORMAT_VERSION = 1;
+// Cada cubo se agranda esto al clasificarlo: cubre el redondeo del índice en
+// classify() y el de la cuenta en float del firmware justo sobre el borde
+static const double VOXEL_MARGIN_MM = 0.01;
+
+struct GridHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t hash;
+    float voxelMm;
+    uint32_t nx, ny, nz;
+    float originX, originY, originZ;
+    uint32_t reserved;
+};
+
+// FNV-1a sobre los campos de la geometría y la resolución
+uint64_t ReachabilityGrid::geometryHash(const ArmGeometry& g, float voxelMm) {
+    const float fields[] = {
+        g.lowShankLength, g.highShankLength, g.endEffectorOffset, g.zMin, g.zMax,
+        g.shanksMinAngleCos, g.shanksMaxAngleCos, g.railLength, voxelMm, float(GRID_FORMAT_VERSION)
+    };
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(fields);
+    for (size_t i = 0; i < sizeof(fields); ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string ReachabilityGrid::fileName(const ArmGeometry& geometry, float voxelMm) {
+    char name[40];
+    snprintf(name, sizeof(name), "alcance-%016llx.grid", (unsigned long long)geometryHash(geometry, voxelMm));
+    return name;
+}
+
+// La caja contiene todo punto admitido (|r - offset| <= R_MAX) con un vóxel de sobra
+void ReachabilityGrid::setBounds(const ArmGeometry& geometry, float voxelMm) {
+    geometry_ = geometry;
+    voxelMm_ = voxelMm;
+    inverseVoxel_ = 1.0f / voxelMm;
+    float reach = geometry.rMax() + std::fabs(geometry.endEffectorOffset) + voxelMm;
+    originX_ = originY_ = -reach;
+    originZ_ = geometry.zMin - voxelMm;
+    nx_ = ny_ = uint32_t(std::ceil(2 * reach / voxelMm));
+    nz_ = uint32_t(std::ceil((geometry.zMax - geometry.zMin + 2 * voxelMm) / voxelMm));
+}
+
+// Mínimo y máximo de |v| para v en [lo, hi]
+static inline void absRange(double lo, double hi, double& min, double& max) {
+    min = (lo <= 0 && hi >= 0) ? 0 : std::fmin(std::fabs(lo), std::fabs(hi));
+    max = std::fmax(std::fabs(lo), std::fabs(hi));
+}
+
+void ReachabilityGrid::build(const ArmGeometry& geometry, float voxelMm) {
+    auto started = std::chrono::steady_clock::now();
+    setBounds(geometry, voxelMm);
+    const size_t total = size_t(nx_) * ny_ * nz_;
+    cells_.assign((total + 31) / 32, 0);
+
+    const double rMax2 = double(geometry.rMax()) * geometry.rMax();
+    const double rMin2 = double(geometry.rMin()) * geometry.rMin();
+    const double offset = geometry.endEffectorOffset;
+    const double voxel = voxelMm;
+
+    // El módulo al cuadrado es (r - offset)^2 + z^2 con r = hypot(x, y): se acota
+    // por separado el rango de r en el cuadrado XY y el de z en la capa
+    std::vector<double> radialMin(size_t(nx_) * ny_), radialMax(size_t(nx_) * ny_);
+    std::vector<uint8_t> touchesAxis(size_t(nx_) * ny_);
+    for (uint32_t iy = 0; iy < ny_; ++iy) {
+        for (uint32_t ix = 0; ix < nx_; ++ix) {
+            double xa = originX_ + ix * voxel - VOXEL_MARGIN_MM, xb = xa + voxel + 2 * VOXEL_MARGIN_MM;
+            double ya = originY_ + iy * voxel - VOXEL_MARGIN_MM, yb = ya + voxel + 2 * VOXEL_MARGIN_MM;
+            double minX, maxX, minY, maxY;
+            absRange(xa, xb, minX, maxX);
+            absRange(ya, yb, minY, maxY);
+            double ra = std::hypot(minX, minY), rb = std::hypot(maxX, maxY);
+            double da = ra - offset, db = rb - offset;
+            size_t k = size_t(iy) * nx_ + ix;
+            radialMin[k] = (da <= 0 && db >= 0) ? 0 : std::fmin(da * da, db * db);
+            radialMax[k] = std::fmax(da * da, db * db);
+            touchesAxis[k] = ra <= 0; // X = Y = 0 no se admite
+        }
+    }
+
+    size_t index = 0;
+    for (uint32_t iz = 0; iz < nz_; ++iz) {
+        double za = originZ_ + iz * voxel - VOXEL_MARGIN_MM, zb = za + voxel + 2 * VOXEL_MARGIN_MM;
+        double minZ, maxZ;
+        absRange(za, zb, minZ, maxZ);
+        bool zInside = za >= geometry.zMin && zb <= geometry.zMax;
+        bool zOutside = zb < geometry.zMin || za > geometry.zMax;
+        for (size_t k = 0; k < radialMin.size(); ++k, ++index) {
+            double lo = radialMin[k] + minZ * minZ;
+            double hi = radialMax[k] + maxZ * maxZ;
+            Cell c;
+            if (zOutside || hi < rMin2 || lo > rMax2) c = Outside;
+            else if (zInside && lo >= rMin2 && hi <= rMax2 && !touchesAxis[k]) c = Inside;
+            else c = Boundary;
+            cells_[index >> 5] |= uint64_t(c) << ((index & 31) * 2);
+        }
+    }
+    fromCache_ = false;
+    buildMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+}
+
+size_t ReachabilityGrid::countCells(Cell c) const {
+    size_t total = size_t(nx_) * ny_ * nz_, count = 0;
+    for (size_t i = 0; i < total; ++i)
+        if (Cell((cells_[i >> 5] >> ((i & 31) * 2)) & 3) == c) ++count;
+    return count;
+}
+
+bool ReachabilityGrid::load(const std::string& path, const ArmGeometry& geometry, float voxelMm) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ReachabilityGrid expected;
+    expected.setBounds(geometry, voxelMm);
+    GridHeader header;
+    bool ok = ::read(fd, &header, sizeof(header)) == ssize_t(sizeof(header))
+        && std::memcmp(header.magic, GRID_MAGIC, sizeof(GRID_MAGIC)) == 0
+        && header.version == GRID_FORMAT_VERSION
+        && header.hash == geometryHash(geometry, voxelMm)
+        && header.nx == expected.nx_ && header.ny == expected.ny_ && header.nz == expected.nz_;
+    std::vector<uint64_t> cells;
+    if (ok) {
+        size_t total = size_t(header.nx) * header.ny * header.nz;
+        cells.resize((total + 31) / 32);
+        size_t want = cells.size() * sizeof(uint64_t), got = 0;
+        char* data = reinterpret_cast<char*>(cells.data());
+        while (got < want) {
+            ssize_t n = ::read(fd, data + got, want - got);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += size_t(n);
+        }
+        ok = got == want;
+    }
+    ::close(fd);
+    if (!ok) return false;
+
+    *this = expected;
+    cells_.swap(cells);
+    fromCache_ = true;
+    return true;
+}
+
+void ReachabilityGrid::save(const std::string& path) const {
+    GridHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, GRID_MAGIC, sizeof(header.magic));
+    header.version = GRID_FORMAT_VERSION;
+    header.hash = geometryHash(geometry_, voxelMm_);
+    header.voxelMm = voxelMm_;
+    header.nx = nx_;
+    header.ny = ny_;
+    header.nz = nz_;
+    header.originX = originX_;
+    header.originY = originY_;
+    header.originZ = originZ_;
+
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::runtime_error("no se pudo crear " + tmp + ": " + std::strerror(errno));
+    const char* parts[] = { reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(cells_.data()) };
+    const size_t sizes[] = { sizeof(header), cells_.size() * sizeof(uint64_t) };
+    bool ok = true;
+    for (int p = 0; p < 2 && ok; ++p) {
+        size_t written = 0;
+        while (written < sizes[p]) {
+            ssize_t n = ::write(fd, parts[p] + written, sizes[p] - written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            written += size_t(n);
+        }
+        ok = written == sizes[p];
+    }
+    int error = errno;
+    if (::close(fd) != 0 && ok) { ok = false; error = errno; }
+    if (ok && ::rename(tmp.c_str(), path.c_str()) != 0) { ok = false; error = errno; }
+    if (!ok) {
+        ::unlink(tmp.c_str());
+        throw std::runtime_error("no se pudo guardar " + path + ": " + std::strerror(error));
+    }
+}
+
+void ReachabilityGrid::loadOrBuild(const ArmGeometry& geometry, const std::string& directory, float voxelMm) {
+    std::string path = directory + "/" + fileName(geometry, voxelMm);
+    if (load(path, geometry, voxelMm)) {
+        XmlRpc::XmlRpcUtil::log(2, "ReachabilityGrid: %s cargada (%u x %u x %u vóxeles)", path.c_str(), nx_, ny_, nz_);
+        return;
+    }
+    build(geometry, voxelMm);
+    XmlRpc::XmlRpcUtil::log(2, "ReachabilityGrid: construida en %.1f ms (%u x %u x %u vóxeles)", buildMs_, nx_, ny_, nz_);
+    ::mkdir(directory.c_str(), 0755);
+    try {
+        save(path);
+    } catch (const std::exception& e) {
+        // Sin caché se vuelve a construir en el próximo arranque
+        XmlRpc::XmlRpcUtil::error("ReachabilityGrid: %s", e.what());
+    }
+}
+
+} // namespace RPCServer
@@ -1,10 +1,12 @@
 #include "Robot.h"
+#include "ProgramStore.h"
 #include <sstream>
 #include <iomanip>
 #include <chrono>
 #include <thread>
 #include <algorithm>
 #include <iostream>
+#include <cmath>
 
 namespace RPCServer {
 
@@ -14,17 +16,47 @@ bool Robot::connect(const std::string& port, int baud){
 
     // Lazo de espera para descartar mensajes iniciales (banner, INFO: ROBOT ONLINE, etc.)
     discardInitialBanner(3000);
+    // La placa se reinicia al abrir el puerto: modo absoluto y sin G92
+    absolute_ = true;
+    workOffset_ = false;
     
+    bumpStateVersion();
     return true;
 }
 
 void Robot::disconnect(){
     std::lock_guard<std::mutex> lk(ioMutex_);
     serial_.close();
+    bumpStateVersion();
 }
 
 bool Robot::isConnected() const { return serial_.isOpen(); }
 
+SerialHandoff Robot::releaseSerial(){
+    std::lock_guard<std::mutex> lk(ioMutex_); // espera el comando en curso
+    SerialHandoff handoff;
+    handoff.port = serial_.getPortName();
+    handoff.baud = serial_.getBaud();
+    handoff.absolute = absolute_;
+    handoff.motorsOn = motorsOn_;
+    handoff.fanOn = fanOn_;
+    handoff.fd = serial_.release();
+    bumpStateVersion();
+    return handoff;
+}
+
+// Sin banner que descartar: la placa no se reinicia porque el puerto nunca se cerró
+bool Robot::adoptSerial(const SerialHandoff& handoff){
+    std::lock_guard<std::mutex> lk(ioMutex_);
+    if (!serial_.adopt(handoff.fd, handoff.port, handoff.baud)) return false;
+    absolute_ = handoff.absolute;
+    motorsOn_ = handoff.motorsOn;
+    fanOn_ = handoff.fanOn;
+    workOffset_ = true; // el proceso anterior no lo informa: se supone que puede haber G92
+    bumpStateVersion();
+    return true;
+}
+
 std::string Robot::readLine(int timeoutMs) {
     return serial_.readLine(timeoutMs);
 }
@@ -107,30 +139,55 @@ bool Robot::sendAndWaitOk(const std::string& line, int timeoutMs){
 bool Robot::setMode(bool /*manual*/, bool absolute){
     if (absolute_ != absolute){
         absolute_ = absolute;
-        return sendAndWaitOk(absolute_ ? "G90" : "G91", 3000);
+        bool ok = sendAndWaitOk(absolute_ ? "G90" : "G91", 3000);
+        if (ok) bumpStateVersion();
+        return ok;
     }
     return true;
 }
 
 bool Robot::enableMotors(bool on){
     motorsOn_ = on;
-    return sendAndWaitOk(on ? "M17" : "M18", 3000);
+    bool ok = sendAndWaitOk(on ? "M17" : "M18", 3000);
+    if (ok) bumpStateVersion();
+    return ok;
 }
 
 bool Robot::home(){
-    return sendAndWaitOk("G28", 8000); // homing puede tardar más
+    bool ok = sendAndWaitOk("G28", 8000); // homing puede tardar más
+    if (ok) bumpStateVersion();
+    return ok;
 }
 
 bool Robot::move(double x, double y, double z, double vel){
     std::ostringstream ss; ss << std::fixed << std::setprecision(3);
     ss << "G0 X" << x << " Y" << y << " Z" << z;
     if (vel > 0) ss << " F" << vel;
-    return sendAndWaitOk(ss.str(), 8000);
+    bool ok = sendAndWaitOk(ss.str(), 8000);
+    if (ok) bumpStateVersion();
+    return ok;
 }
 
 bool Robot::endEffector(bool on){
     // Ajusta a tu efector real si no es ventilador
-    return sendAndWaitOk(on ? "M106" : "M107", 3000);
+    bool ok = sendAndWaitOk(on ? "M106" : "M107", 3000);
+    if (ok) { fanOn_ = on; bumpStateVersion(); }
+    return ok;
+}
+
+// Se reenvían sólo los parámetros que tenía la línea original, con el formato de move()
+bool Robot::execute(const ProgramCommand& cmd){
+    int timeoutMs = 3000;
+    if (cmd.id == 'G' && (cmd.num == 0 || cmd.num == 1 || cmd.num == 28)) timeoutMs = 8000;
+    else if (cmd.id == 'G' && cmd.num == 4 && !std::isnan(cmd.s)) timeoutMs += int(cmd.s * 1000);
+    if (!sendAndWaitOk(programCommandLine(cmd), timeoutMs)) return false;
+
+    if (cmd.id == 'G' && (cmd.num == 90 || cmd.num == 91)) absolute_ = (cmd.num == 90);
+    else if (cmd.id == 'M' && (cmd.num == 17 || cmd.num == 18)) motorsOn_ = (cmd.num == 17);
+    else if (cmd.id == 'M' && (cmd.num == 106 || cmd.num == 107)) fanOn_ = (cmd.num == 106);
+    else if (cmd.id == 'G' && cmd.num == 92) workOffset_ = true;
+    bumpStateVersion();
+    return true;
 }
 
 // Nuevo: obtener posición del robot (M114) - respuesta multilínea
@@ -179,6 +236,7 @@ RobotPosition Robot::getPosition() {
             result.z = std::stod(allText.substr(zpos + 2));
             result.e = std::stod(allText.substr(epos + 2));
             result.valid = true;
+            result.hasCoordinates = true;
         } catch (const std::exception&) {
             // Error parseando, mantener valid=false
         }
@@ -240,6 +298,13 @@ EndstopStatus Robot::getEndstops() {
             break;
         }
     }
+
+    // Un cambio en los endstops es un cambio de estado para quienes esperan
+    if (result.valid && (result.xState != lastEndstops_.xState || result.yState != lastEndstops_.yState ||
+                         result.zState != lastEndstops_.zState || !lastEndstops_.valid)) {
+        lastEndstops_ = result;
+        bumpStateVersion();
+    }
     
     return result;
 }
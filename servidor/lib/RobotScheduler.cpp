@@ -0,0 +1,205 @@
+#include "RobotScheduler.h"
+#include "../lib/XmlRpcException.h"
+#include <exception>
+
+namespace RPCServer {
+
+// Resultados no retirados (cliente que cerró la conexión) se descartan pasado este tiempo
+static const int ABANDONED_RESULT_SECONDS = 300;
+
+const char* priorityName(CommandPriority p) {
+    switch (p) {
+        case CommandPriority::Safety:    return "safety";
+        case CommandPriority::Control:   return "control";
+        case CommandPriority::Motion:    return "motion";
+        case CommandPriority::Telemetry: return "telemetry";
+    }
+    return "unknown";
+}
+
+RobotScheduler::RobotScheduler(std::function<void()> onComplete)
+  : onComplete_(std::move(onComplete)) {
+    stats_[int(CommandPriority::Safety)].capacity = 4;
+    stats_[int(CommandPriority::Control)].capacity = 8;
+    stats_[int(CommandPriority::Motion)].capacity = 32;
+    stats_[int(CommandPriority::Telemetry)].capacity = 8;
+    worker_ = std::thread(&RobotScheduler::workerLoop, this);
+}
+
+RobotScheduler::~RobotScheduler() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void RobotScheduler::setCapacity(CommandPriority p, int capacity) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    stats_[int(p)].capacity = capacity;
+}
+
+int RobotScheduler::submit(CommandPriority p, Job job) {
+    int ticket;
+    int flushed = 0;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        LaneStats& st = stats_[int(p)];
+        if (stopping_ || int(lanes_[int(p)].size()) >= st.capacity) {
+            st.rejected++;
+            return -1;
+        }
+        pruneAbandoned();
+        ticket = nextTicket_++;
+        if (nextTicket_ <= 0) nextTicket_ = 1;
+        lanes_[int(p)].push_back(Pending{ticket, std::move(job)});
+        results_[ticket];   // pendiente
+        st.admitted++;
+        st.depth = int(lanes_[int(p)].size());
+        if (st.depth > st.maxDepth) st.maxDepth = st.depth;
+        // Lo que esperaba detrás de una parada ya no debe ejecutarse después de ella
+        if (p == CommandPriority::Safety) {
+            flushed += cancelPending(CommandPriority::Control, "cancelado por una parada de seguridad");
+            flushed += cancelPending(CommandPriority::Motion, "cancelado por una parada de seguridad");
+        }
+    }
+    cv_.notify_one();
+    if (flushed > 0 && onComplete_) onComplete_(); // responder a los que esperaban
+    return ticket;
+}
+
+bool RobotScheduler::isDone(int ticket) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = results_.find(ticket);
+    return it == results_.end() || it->second.done;
+}
+
+bool RobotScheduler::takeResult(int ticket, XmlRpc::XmlRpcValue& result, std::string& error) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = results_.find(ticket);
+    if (it == results_.end() || !it->second.done) return false;
+    result = it->second.result;
+    error = it->second.error;
+    results_.erase(it);
+    return true;
+}
+
+bool RobotScheduler::cancel(int ticket) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (int i = 0; i < COMMAND_PRIORITY_COUNT; ++i) {
+        for (auto it = lanes_[i].begin(); it != lanes_[i].end(); ++it) {
+            if (it->ticket != ticket) continue;
+            lanes_[i].erase(it);
+            stats_[i].depth = int(lanes_[i].size());
+            stats_[i].cancelled++;
+            results_.erase(ticket);
+            return true;
+        }
+    }
+    auto it = results_.find(ticket);
+    if (it != results_.end()) {
+        if (it->second.done) results_.erase(it);
+        else it->second.abandoned = true;
+    }
+    return false;
+}
+
+LaneStats RobotScheduler::getStats(CommandPriority p) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return stats_[int(p)];
+}
+
+bool RobotScheduler::isIdle() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (const auto& r : results_)
+        if (!r.second.done) return false;
+    return true;
+}
+
+bool RobotScheduler::hasPending(CommandPriority p) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return !lanes_[int(p)].empty();
+}
+
+// Llamado con mutex_ tomado
+void RobotScheduler::pruneAbandoned() {
+    auto limit = std::chrono::steady_clock::now() - std::chrono::seconds(ABANDONED_RESULT_SECONDS);
+    for (auto it = results_.begin(); it != results_.end(); ) {
+        if (it->second.done && it->second.finishedAt < limit) it = results_.erase(it);
+        else ++it;
+    }
+}
+
+// Llamado con mutex_ tomado. Los comandos en cola de la clase p terminan con error
+// sin ejecutarse; devuelve cuántos eran.
+int RobotScheduler::cancelPending(CommandPriority p, const std::string& reason) {
+    std::deque<Pending>& lane = lanes_[int(p)];
+    int n = int(lane.size());
+    for (const Pending& cmd : lane) {
+        Completed& c = results_[cmd.ticket];
+        c.error = reason;
+        c.done = true;
+        c.finishedAt = std::chrono::steady_clock::now();
+    }
+    lane.clear();
+    stats_[int(p)].depth = 0;
+    stats_[int(p)].cancelled += n;
+    return n;
+}
+
+void RobotScheduler::workerLoop() {
+    while (true) {
+        Pending cmd;
+        int lane = -1;
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            cv_.wait(lk, [this] {
+                if (stopping_) return true;
+                for (int i = 0; i < COMMAND_PRIORITY_COUNT; ++i)
+                    if (!lanes_[i].empty()) return true;
+                return false;
+            });
+            if (stopping_) return;
+            for (int i = 0; i < COMMAND_PRIORITY_COUNT && lane < 0; ++i) {
+                if (!lanes_[i].empty()) {
+                    lane = i;
+                    cmd = std::move(lanes_[i].front());
+                    lanes_[i].pop_front();
+                    stats_[i].depth = int(lanes_[i].size());
+                }
+            }
+        }
+
+        // Ejecutar fuera del lock: el comando puede tardar segundos en el puerto serie
+        XmlRpc::XmlRpcValue result;
+        std::string error;
+        try {
+            cmd.job(result);
+        } catch (const std::exception& e) {
+            error = e.what();
+        } catch (const XmlRpc::XmlRpcException& e) {
+            // Conversiones de XmlRpcValue con el tipo equivocado (bool(params[0]), ...)
+            error = e.getMessage();
+        } catch (...) {
+            error = "error desconocido ejecutando el comando";
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stats_[lane].executed++;
+            Completed& c = results_[cmd.ticket];
+            if (c.abandoned) {
+                results_.erase(cmd.ticket); // nadie lo va a retirar
+                continue;
+            }
+            c.result = result;
+            c.error = error;
+            c.done = true;
+            c.finishedAt = std::chrono::steady_clock::now();
+        }
+        if (onComplete_) onComplete_();
+    }
+}
+
+} // namespace RPCServer
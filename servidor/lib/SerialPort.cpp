@@ -39,6 +39,25 @@ bool SerialPort::open(const std::string& port, int baud) {
     return true;
 }
 
+bool SerialPort::adopt(int fd, const std::string& port, int baud) {
+    close();
+    if (fd < 0) return false;
+    termios tty{};
+    if (tcgetattr(fd, &tty) != 0) return false; // no es una terminal
+    fd_ = fd;
+    port_ = port;
+    baud_ = baud;
+    opened_ = true;
+    return true;
+}
+
+int SerialPort::release() {
+    int fd = fd_;
+    fd_ = -1;
+    opened_ = false;
+    return fd;
+}
+
 void SerialPort::close() {
     if (fd_ >= 0) {
         ::close(fd_);
@@ -0,0 +1,65 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+namespace RPCServer {
+
+WorkerPool::WorkerPool(int threads) {
+    size_t n = threads > 0 ? size_t(threads) : std::thread::hardware_concurrency();
+    for (size_t i = 1; i < n; ++i) threads_.emplace_back([this]() { workerLoop(); });
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+    }
+    work_.notify_all();
+    for (std::thread& t : threads_) t.join();
+}
+
+size_t WorkerPool::claim(Job& job) {
+    size_t i = job.next++;
+    if (job.next >= job.chunks) {
+        auto it = std::find(jobs_.begin(), jobs_.end(), &job);
+        if (it != jobs_.end()) jobs_.erase(it);
+    }
+    return i;
+}
+
+void WorkerPool::run(size_t chunks, const std::function<void(size_t)>& fn) {
+    if (chunks == 0) return;
+    if (chunks == 1 || threads_.empty()) {
+        for (size_t i = 0; i < chunks; ++i) fn(i);
+        return;
+    }
+
+    Job job{&fn, chunks, 0, 0};
+    std::unique_lock<std::mutex> lk(mutex_);
+    jobs_.push_back(&job);
+    work_.notify_all();
+    while (job.next < job.chunks) {
+        size_t i = claim(job);
+        lk.unlock();
+        fn(i);
+        lk.lock();
+        ++job.done;
+    }
+    // job vive en esta pila: no volver hasta que los demás terminen sus trozos
+    finished_.wait(lk, [&job]() { return job.done == job.chunks; });
+}
+
+void WorkerPool::workerLoop() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (true) {
+        work_.wait(lk, [this]() { return stop_ || !jobs_.empty(); });
+        if (stop_) return;
+        Job* job = jobs_.front();
+        size_t i = claim(*job);
+        lk.unlock();
+        (*job->fn)(i);
+        lk.lock();
+        if (++job->done == job->chunks) finished_.notify_all();
+    }
+}
+
+} // namespace RPCServer
@@ -0,0 +1,286 @@
+#include "Workspace.h"
+#include "ReachabilityGrid.h"
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace RPCServer {
+
+// Por debajo de esto no vale la pena repartir el muestreo entre hilos
+static const size_t MIN_SEGMENTS_PER_CHUNK = 256;
+// Trozos por hilo: los movimientos largos no dejan a un hilo con todo el trabajo
+static const size_t CHUNKS_PER_THREAD = 4;
+// Paso de muestreo más fino admitido
+static const float MIN_SAMPLE_MM = 0.1f;
+// Un movimiento más largo que esto (en pasos) termina fuera del espacio de trabajo:
+// se comprueba su extremo igual
+static const float MAX_SAMPLES_PER_SEGMENT = 1e6f;
+// Puntos evaluados juntos en el muestreo rápido
+static const int SAMPLE_BLOCK = 8;
+
+static inline float sq(float v) { return v * v; }
+
+float ArmGeometry::rMin() const {
+    return std::sqrt((sq(lowShankLength) + sq(highShankLength)) -
+                     (2 * lowShankLength * highShankLength * shanksMinAngleCos));
+}
+
+float ArmGeometry::rMax() const {
+    return std::sqrt((sq(lowShankLength) + sq(highShankLength)) -
+                     (2 * lowShankLength * highShankLength * shanksMaxAngleCos));
+}
+
+// Como en el firmware, X = Y = 0 da NaN y el punto no se admite. Los radios al
+// cuadrado se reciben calculados porque el muestreo llama esto millones de veces.
+static inline bool allowedPosition(const ArmGeometry& g, float rMax2, float rMin2,
+                                   float x, float y, float z, float e) {
+    float rrot_ee = std::sqrt(x * x + y * y);
+    float rrot = rrot_ee - g.endEffectorOffset;
+    float rrot_x = rrot * (y / rrot_ee);
+    float rrot_y = rrot * (x / rrot_ee);
+    float squaredPositionModule = sq(rrot_x) + sq(rrot_y) + sq(z);
+    return squaredPositionModule <= rMax2
+        && squaredPositionModule >= rMin2
+        && z >= g.zMin
+        && z <= g.zMax
+        && e <= g.railLength;
+}
+
+bool ArmGeometry::isAllowedPosition(float x, float y, float z, float e) const {
+    return allowedPosition(*this, sq(rMax()), sq(rMin()), x, y, z, e);
+}
+
+// La misma regla sin raíz ni divisiones, para el muestreo: el módulo es
+// (r - offset)^2 + z^2 con r = hypot(x, y), y al comparar con los radios se
+// despeja r y se eleva al cuadrado (vale con endEffectorOffset >= 0). Sin saltos
+// el compilador vectoriza el lazo; difiere de allowedPosition sólo en el redondeo
+// justo sobre el borde.
+static inline bool allowedPositionFast(const ArmGeometry& g, float rMax2, float rMin2,
+                                       float x, float y, float z, float e) {
+    float r2 = x * x + y * y;
+    float base = r2 + sq(g.endEffectorOffset) + z * z;
+    float k = 4 * sq(g.endEffectorOffset) * r2;  // (2 * offset * r)^2
+    float aboveMax = base - rMax2;
+    float aboveMin = base - rMin2;
+    bool insideMax = (aboveMax <= 0) | (aboveMax * aboveMax <= k);
+    bool outsideMin = (aboveMin >= 0) & (aboveMin * aboveMin >= k);
+    return insideMax & outsideMin & (r2 > 0) & (z >= g.zMin) & (z <= g.zMax) & (e <= g.railLength);
+}
+
+ReplayState ReplayState::home(const ArmGeometry& geometry) {
+    ReplayState st;
+    st.pos[0] = geometry.initialX;
+    st.pos[1] = geometry.initialY;
+    st.pos[2] = geometry.initialZ;
+    st.pos[3] = geometry.initialE;
+    for (float& o : st.offset) o = 0.0f;
+    st.relative = false;
+    return st;
+}
+
+ProgramValidator::ProgramValidator(const ArmGeometry& geometry, float sampleMm)
+  : geometry_(geometry), sampleMm_(sampleMm) {}
+
+// Comandos que executeCommand del firmware reconoce
+static bool isKnownCommand(const ProgramCommand& c) {
+    if (c.id == 'G') {
+        switch (c.num) {
+            case 0: case 1: case 4: case 28: case 90: case 91: case 92: return true;
+        }
+    } else if (c.id == 'M') {
+        switch (c.num) {
+            case 1: case 2: case 3: case 5: case 6: case 7: case 17: case 18:
+            case 106: case 107: case 114: case 119: return true;
+        }
+    }
+    return false;
+}
+
+size_t replayMoves(const ArmGeometry& geometry, const ProgramCommand* begin, const ProgramCommand* end,
+                   const ReplayState& start, std::vector<MoveSegment>& moves) {
+    size_t unsupported = 0;
+    ReplayState st = start;
+    int index = 0;
+    bool previousMove = false;
+    for (const ProgramCommand* c = begin; c != end; ++c) {
+        ++index;
+        bool move = c->id == 'G' && (c->num == 0 || c->num == 1);
+        bool joins = previousMove;
+        previousMove = move;
+        if (!isKnownCommand(*c)) {
+            ++unsupported;
+            continue;
+        }
+        if (c->id != 'G') continue;
+        const float values[4] = { c->x, c->y, c->z, c->e };
+        if (move) {
+            MoveSegment s;
+            s.command = index;
+            s.feed = std::isnan(c->f) ? 0.0f : c->f;
+            s.joinsPrevious = joins;
+            for (int a = 0; a < 4; ++a) {
+                s.from[a] = st.pos[a];
+                if (!std::isnan(values[a]))
+                    st.pos[a] = values[a] + (st.relative ? st.pos[a] : st.offset[a]);
+                s.to[a] = st.pos[a];
+            }
+            moves.push_back(s);
+        } else if (c->num == 28) {
+            ReplayState homed = ReplayState::home(geometry);
+            for (int a = 0; a < 4; ++a) st.pos[a] = homed.pos[a];
+        } else if (c->num == 90 || c->num == 91) {
+            st.relative = (c->num == 91);
+        } else if (c->num == 92) {
+            for (int a = 0; a < 4; ++a)
+                st.offset[a] = std::isnan(values[a]) ? 0.0f : st.pos[a] - values[a];
+        }
+    }
+    return unsupported;
+}
+
+StartDependence startDependence(const ProgramCommand* begin, const ProgramCommand* end) {
+    // Por eje: la posición es conocida, y el offset es el de antes del programa
+    // (FromStart), uno conocido, o uno de un G92 tomado en una posición desconocida
+    enum Offset { FromStart, Known, FromUnknown };
+    StartDependence dep;
+    bool known[4] = { false, false, false, false };
+    Offset offset[4] = { FromStart, FromStart, FromStart, FromStart };
+    bool modeKnown = false;
+    bool relative = false;
+    for (const ProgramCommand* c = begin; c != end; ++c) {
+        if (c->id != 'G' || !isKnownCommand(*c)) continue;
+        const float values[4] = { c->x, c->y, c->z, c->e };
+        if (c->num == 0 || c->num == 1) {
+            bool target[4];
+            for (int a = 0; a < 4; ++a) {
+                if (!known[a]) dep.position = true;  // el tramo sale de un punto desconocido
+                if (std::isnan(values[a])) {
+                    target[a] = known[a];
+                } else if (!modeKnown) {
+                    dep.mode = true;
+                    target[a] = false;
+                } else if (relative) {
+                    target[a] = known[a];
+                } else {
+                    if (offset[a] == FromStart) dep.offset = true;
+                    target[a] = offset[a] != FromUnknown;
+                }
+            }
+            for (int a = 0; a < 4; ++a) known[a] = target[a];
+        } else if (c->num == 28) {
+            for (bool& k : known) k = true;
+        } else if (c->num == 90 || c->num == 91) {
+            modeKnown = true;
+            relative = (c->num == 91);
+        } else if (c->num == 92) {
+            // Un eje sin valor queda con offset 0 (resetPosOffset del firmware)
+            for (int a = 0; a < 4; ++a)
+                offset[a] = std::isnan(values[a]) || known[a] ? Known : FromUnknown;
+        }
+    }
+    return dep;
+}
+
+ValidationReport ProgramValidator::validate(const ProgramCommand* begin, const ProgramCommand* end,
+                                            const ReplayState& start) const {
+    auto started = std::chrono::steady_clock::now();
+    ValidationReport report;
+    report.commands = size_t(end - begin);
+
+    // Extremos de cada movimiento, siguiendo cmdMove y el caso 92 de executeCommand
+    std::vector<MoveSegment> segments;
+    segments.reserve(report.commands);
+    report.unsupported = replayMoves(geometry_, begin, end, start, segments);
+    report.segments = segments.size();
+    report.dependsOn = startDependence(begin, end);
+
+    // Muestreo en paralelo: cada hilo toma el siguiente trozo libre
+    size_t threads = pool_ ? pool_->size() : 1;
+    size_t chunks = segments.size() / MIN_SEGMENTS_PER_CHUNK;
+    if (chunks > threads * CHUNKS_PER_THREAD) chunks = threads * CHUNKS_PER_THREAD;
+    if (chunks == 0) chunks = 1;
+
+    std::vector<ChunkResult> results(chunks);
+    const MoveSegment* base = segments.data();
+    auto sample = [&](size_t i) {
+        size_t from = segments.size() * i / chunks;
+        size_t to = segments.size() * (i + 1) / chunks;
+        sampleChunk(base + from, base + to, results[i]);
+    };
+    if (pool_) {
+        pool_->run(chunks, sample);
+    } else {
+        for (size_t i = 0; i < chunks; ++i) sample(i);
+    }
+
+    for (const ChunkResult& r : results) {
+        report.samples += r.samples;
+        if (r.violations > 0 && report.violations == 0) report.first = r.first;
+        report.violations += r.violations;
+    }
+    report.valid = (report.violations == 0);
+    report.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
+
+// Los puntos intermedios se calculan como Interpolation::updateActualPosition
+// (inicio + progreso * delta); el recorrido es el mayor entre XYZ y E
+void ProgramValidator::sampleChunk(const MoveSegment* begin, const MoveSegment* end, ChunkResult& out) const {
+    const float rMax2 = sq(geometry_.rMax());
+    const float rMin2 = sq(geometry_.rMin());
+    const float step = sampleMm_ > MIN_SAMPLE_MM ? sampleMm_ : MIN_SAMPLE_MM;
+    const bool fast = geometry_.endEffectorOffset >= 0;
+    for (const MoveSegment* s = begin; s != end; ++s) {
+        float delta[4];
+        for (int a = 0; a < 4; ++a) delta[a] = s->to[a] - s->from[a];
+        float dist = std::sqrt(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]);
+        if (dist < std::fabs(delta[3])) dist = std::fabs(delta[3]);
+        float steps = std::ceil(dist / step);
+        int n = steps < 1 ? 1 : steps > MAX_SAMPLES_PER_SEGMENT ? int(MAX_SAMPLES_PER_SEGMENT) : int(steps);
+        const float inv = 1.0f / float(n);
+        out.samples += n;
+
+        // Todo el segmento de una vez; sólo si falla se busca el primer punto
+        if (fast) {
+            const ArmGeometry g = geometry_;
+            const float x0 = s->from[0], y0 = s->from[1], z0 = s->from[2], e0 = s->from[3];
+            const float dx = delta[0], dy = delta[1], dz = delta[2], de = delta[3];
+            int ok = 1;
+            for (int block = 1; block <= n; block += SAMPLE_BLOCK) {
+                // Bloques de largo fijo (el último repite el extremo): con -O2 gcc sólo
+                // vectoriza lazos de iteraciones conocidas
+                for (int j = 0; j < SAMPLE_BLOCK; ++j) {
+                    int i = block + j < n ? block + j : n;
+                    float progress = float(i) * inv;
+                    ok &= allowedPositionFast(g, rMax2, rMin2, x0 + progress * dx, y0 + progress * dy,
+                                              z0 + progress * dz, e0 + progress * de);
+                }
+            }
+            if (ok) continue;
+        }
+
+        for (int i = 1; i <= n; ++i) {
+            float progress = float(i) * inv;
+            float x = s->from[0] + progress * delta[0];
+            float y = s->from[1] + progress * delta[1];
+            float z = s->from[2] + progress * delta[2];
+            float e = s->from[3] + progress * delta[3];
+            bool allowed = grid_ ? grid_->isAllowedPosition(x, y, z, e)
+                         : fast ? allowedPositionFast(geometry_, rMax2, rMin2, x, y, z, e)
+                                : allowedPosition(geometry_, rMax2, rMin2, x, y, z, e);
+            if (!allowed) {
+                if (out.violations == 0) {
+                    out.first.command = s->command;
+                    out.first.x = x;
+                    out.first.y = y;
+                    out.first.z = z;
+                    out.first.e = e;
+                }
+                ++out.violations;
+                break;
+            }
+        }
+    }
+}
+
+} // namespace RPCServer
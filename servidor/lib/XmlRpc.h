@@ -26,6 +26,9 @@
 #endif
 
 #include "XmlRpcClient.h"
+#include "XmlRpcAsyncClient.h"
+#include "XmlRpcAsyncLog.h"
+#include "XmlRpcBinarySink.h"
 #include "XmlRpcException.h"
 #include "XmlRpcServer.h"
 #include "XmlRpcServerMethod.h"
@@ -0,0 +1,632 @@
+
+#include "XmlRpcAsyncClient.h"
+
+#include "XmlRpcClient.h"
+#include "XmlRpcException.h"
+#include "XmlRpcSocket.h"
+#include "XmlRpc.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <ctype.h>
+# include <chrono>
+# include <memory>
+#endif
+
+using namespace XmlRpc;
+
+
+XmlRpcAsyncClient::XmlRpcAsyncClient(const char* host, int port, const char* uri/*=0*/)
+{
+  XmlRpcUtil::log(1, "XmlRpcAsyncClient new client: host %s, port %d.", host, port);
+
+  _host = host;
+  _port = port;
+  _uri = uri ? uri : "/RPC2";
+  _maxConnections = 4;
+  _maxPipeline = 8;
+  _nextId = 1;
+  _outstanding = 0;
+  _assigning = false;
+}
+
+
+XmlRpcAsyncClient::~XmlRpcAsyncClient()
+{
+  std::list<Connection*> conns;
+  conns.swap(_connections);
+  for (std::list<Connection*>::iterator it = conns.begin(); it != conns.end(); ++it) {
+    _disp.removeSource(*it);
+    (*it)->discard();
+    (*it)->close();
+  }
+
+  for (std::deque<Call*>::iterator it = _pending.begin(); it != _pending.end(); ++it)
+    delete *it;
+}
+
+
+// Queue a call and try to hand it to a connection right away
+int
+XmlRpcAsyncClient::executeAsync(const char* method, XmlRpcValue const& params, Callback callback,
+                                double msTimeout /*= -1.0*/, bool idempotent /*= false*/)
+{
+  Call* call = new Call;
+  call->_id = _nextId++;
+  call->_request = generateRequest(method, params);
+  call->_callback = callback;
+  call->_deadline = (msTimeout < 0.0) ? -1.0 : getTime() + msTimeout / 1000.0;
+  call->_sendAttempts = 0;
+  call->_idempotent = idempotent;
+  call->_done = false;
+
+  XmlRpcUtil::log(3, "XmlRpcAsyncClient::executeAsync: call %d to %s.", call->_id, method);
+
+  int id = call->_id;
+  ++_outstanding;
+  _pending.push_back(call);
+  assignCalls();
+
+  // A new deadline may be earlier than the one work() is currently waiting for
+  if (msTimeout >= 0.0)
+    _disp.exit();
+
+  return id;
+}
+
+
+std::future<XmlRpcValue>
+XmlRpcAsyncClient::call(const char* method, XmlRpcValue const& params, double msTimeout /*= -1.0*/,
+                        bool idempotent /*= false*/)
+{
+  std::shared_ptr< std::promise<XmlRpcValue> > promise = std::make_shared< std::promise<XmlRpcValue> >();
+
+  executeAsync(method, params, [promise](int, CallStatus status, XmlRpcValue& result) {
+    if (status == CallOk) {
+      promise->set_value(result);
+      return;
+    }
+
+    std::string msg = "call failed";
+    int code = -1;
+    if (status == CallFault && result.getType() == XmlRpcValue::TypeStruct) {
+      if (result.hasMember("faultString") && result["faultString"].getType() == XmlRpcValue::TypeString)
+        msg = std::string(result["faultString"]);
+      if (result.hasMember("faultCode") && result["faultCode"].getType() == XmlRpcValue::TypeInt)
+        code = int(result["faultCode"]);
+    } else if (result.getType() == XmlRpcValue::TypeString) {
+      msg = std::string(result);
+    }
+    promise->set_exception(std::make_exception_ptr(XmlRpcException(msg, code)));
+  }, msTimeout, idempotent);
+
+  return promise->get_future();
+}
+
+
+// Run the dispatcher until the outstanding calls are done or time runs out
+bool
+XmlRpcAsyncClient::work(double msTime /*= -1.0*/)
+{
+  double endTime = (msTime < 0.0) ? -1.0 : getTime() + msTime / 1000.0;
+
+  for (;;) {
+    expireCalls();
+    assignCalls();
+    if (_outstanding == 0)
+      return true;
+
+    double now = getTime();
+    if (endTime >= 0.0 && now >= endTime)
+      return false;
+
+    // Wake up in time to expire the earliest call deadline
+    double waitTime = (endTime < 0.0) ? -1.0 : endTime - now;
+    double deadline = nextDeadline();
+    if (deadline >= 0.0) {
+      double untilDeadline = (deadline > now) ? deadline - now : 0.0;
+      if (waitTime < 0.0 || untilDeadline < waitTime)
+        waitTime = untilDeadline;
+    }
+
+    _disp.work(waitTime);
+  }
+}
+
+
+// Drop all connections. Calls in flight fail, queued calls stay queued.
+void
+XmlRpcAsyncClient::close()
+{
+  std::list<Connection*> conns = _connections;
+  for (std::list<Connection*>::iterator it = conns.begin(); it != conns.end(); ++it) {
+    _disp.removeSource(*it);
+    (*it)->fail("connection closed by client", false);
+    (*it)->close();
+  }
+}
+
+
+// Hand queued calls to connections: an idle connection first, then a new
+// connection while the pool has room, then the shortest pipeline.
+void
+XmlRpcAsyncClient::assignCalls()
+{
+  // Callbacks of calls failed here may queue new calls; the outer loop takes them
+  if (_assigning) return;
+  _assigning = true;
+
+  while ( ! _pending.empty()) {
+    Connection* best = 0;
+    for (std::list<Connection*>::iterator it = _connections.begin(); it != _connections.end(); ++it) {
+      Connection* conn = *it;
+      if (conn->isUsable() && conn->getInFlight() < _maxPipeline &&
+          (best == 0 || conn->getInFlight() < best->getInFlight()))
+        best = conn;
+    }
+
+    if ((best == 0 || best->getInFlight() > 0) && int(_connections.size()) < _maxConnections) {
+      Connection* conn = new Connection(this);
+      if (conn->connect()) {
+        _connections.push_back(conn);
+        _disp.addSource(conn, XmlRpcDispatch::WritableEvent | XmlRpcDispatch::Exception);
+        best = conn;
+      } else {
+        conn->close();
+        if (best == 0) {
+          // Nothing to send these on. Fail what is queued now; calls queued by
+          // the callbacks are retried on the next pass through work().
+          std::deque<Call*> failed;
+          failed.swap(_pending);
+          for (std::deque<Call*>::iterator it = failed.begin(); it != failed.end(); ++it) {
+            completeError(*it, CallError, "could not connect to server");
+            delete *it;
+          }
+          break;
+        }
+      }
+    }
+
+    if (best == 0)
+      break;    // All connections are busy; wait for responses
+
+    Call* call = _pending.front();
+    _pending.pop_front();
+    best->send(call);
+  }
+
+  _assigning = false;
+}
+
+
+// Time out calls whose deadline passed
+void
+XmlRpcAsyncClient::expireCalls()
+{
+  double now = getTime();
+
+  std::deque<Call*> expired;
+  for (std::deque<Call*>::iterator it = _pending.begin(); it != _pending.end(); ) {
+    if ((*it)->_deadline >= 0.0 && (*it)->_deadline <= now) {
+      expired.push_back(*it);
+      it = _pending.erase(it);
+    } else
+      ++it;
+  }
+  for (std::deque<Call*>::iterator it = expired.begin(); it != expired.end(); ++it) {
+    completeError(*it, CallTimeout, "call timed out waiting for a connection");
+    delete *it;
+  }
+
+  // A connection whose requests have all timed out is presumably stuck
+  std::list<Connection*> conns = _connections;
+  for (std::list<Connection*>::iterator it = conns.begin(); it != conns.end(); ++it)
+    if ((*it)->expireCalls(now)) {
+      _disp.removeSource(*it);
+      (*it)->close();
+    }
+}
+
+
+// Earliest deadline of the calls not yet completed, -1 if none
+double
+XmlRpcAsyncClient::nextDeadline()
+{
+  double next = -1.0;
+  for (std::deque<Call*>::iterator it = _pending.begin(); it != _pending.end(); ++it)
+    if ((*it)->_deadline >= 0.0 && (next < 0.0 || (*it)->_deadline < next))
+      next = (*it)->_deadline;
+
+  for (std::list<Connection*>::iterator it = _connections.begin(); it != _connections.end(); ++it) {
+    double d = (*it)->nextDeadline();
+    if (d >= 0.0 && (next < 0.0 || d < next))
+      next = d;
+  }
+  return next;
+}
+
+
+// Report the outcome of a call. The caller keeps ownership of call.
+void
+XmlRpcAsyncClient::complete(Call* call, CallStatus status, XmlRpcValue& result)
+{
+  XmlRpcUtil::log(3, "XmlRpcAsyncClient::complete: call %d status %d.", call->_id, status);
+
+  // Let work() return as soon as there is nothing left to do
+  if (--_outstanding == 0)
+    _disp.exit();
+
+  Callback callback;
+  callback.swap(call->_callback);
+  if (callback)
+    callback(call->_id, status, result);
+}
+
+
+void
+XmlRpcAsyncClient::completeError(Call* call, CallStatus status, std::string const& msg)
+{
+  XmlRpcUtil::error("Error in XmlRpcAsyncClient: call %d: %s.", call->_id, msg.c_str());
+  XmlRpcValue result(msg);
+  complete(call, status, result);
+}
+
+
+void
+XmlRpcAsyncClient::connectionClosed(Connection* conn)
+{
+  _connections.remove(conn);
+}
+
+
+// Encode the call as an http request
+std::string
+XmlRpcAsyncClient::generateRequest(const char* methodName, XmlRpcValue const& params)
+{
+  std::string body = XmlRpcClient::REQUEST_BEGIN;
+  body += methodName;
+  body += XmlRpcClient::REQUEST_END_METHODNAME;
+
+  // If params is an array, each element is a separate parameter
+  if (params.valid()) {
+    body += XmlRpcClient::PARAMS_TAG;
+    if (params.getType() == XmlRpcValue::TypeArray)
+    {
+      for (int i=0; i<params.size(); ++i) {
+        body += XmlRpcClient::PARAM_TAG;
+        body += params[i].toXml();
+        body += XmlRpcClient::PARAM_ETAG;
+      }
+    }
+    else
+    {
+      body += XmlRpcClient::PARAM_TAG;
+      body += params.toXml();
+      body += XmlRpcClient::PARAM_ETAG;
+    }
+    body += XmlRpcClient::PARAMS_ETAG;
+  }
+  body += XmlRpcClient::REQUEST_END;
+
+  std::string request = "POST " + _uri + " HTTP/1.1\r\nUser-Agent: ";
+  request += XMLRPC_VERSION;
+  request += "\r\nHost: ";
+  request += XmlRpcSocket::hostHeader(_host, _port);
+
+  char buff[60];
+  snprintf(buff, sizeof(buff), "\r\nContent-Type: text/xml\r\nContent-length: %lu\r\n\r\n",
+           (unsigned long) body.size());
+  request += buff;
+  request += body;
+  return request;
+}
+
+
+// Convert the response xml into a result value and report it
+void
+XmlRpcAsyncClient::parseResponse(std::string const& response, Call* call)
+{
+  int offset = 0;
+  if ( ! XmlRpcUtil::findTag(XmlRpcClient::METHODRESPONSE_TAG, response, &offset)) {
+    completeError(call, CallError, "invalid response - no methodResponse");
+    return;
+  }
+
+  // Expect either <params><param>... or <fault>...
+  bool isFault = false;
+  XmlRpcValue result;
+  if ((XmlRpcUtil::nextTagIs(XmlRpcClient::PARAMS_TAG, response, &offset) &&
+       XmlRpcUtil::nextTagIs(XmlRpcClient::PARAM_TAG, response, &offset)) ||
+      (XmlRpcUtil::nextTagIs(XmlRpcClient::FAULT_TAG, response, &offset) && (isFault = true)))
+  {
+    if ( ! result.fromXml(response, &offset) || ! result.valid()) {
+      completeError(call, CallError, "invalid response value");
+      return;
+    }
+  } else {
+    completeError(call, CallError, "invalid response - no param or fault tag");
+    return;
+  }
+
+  complete(call, isFault ? CallFault : CallOk, result);
+}
+
+
+double
+XmlRpcAsyncClient::getTime()
+{
+  using namespace std::chrono;
+  return duration_cast< duration<double> >(steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+// Connections delete themselves when closed
+XmlRpcAsyncClient::Connection::Connection(XmlRpcAsyncClient* client) :
+  XmlRpcSource(-1, true)
+{
+  _client = client;
+  _bytesWritten = 0;
+  _responses = 0;
+  _closing = false;
+  _broken = false;
+}
+
+
+// Calls still owned here were already reported (or are being dropped)
+XmlRpcAsyncClient::Connection::~Connection()
+{
+  for (std::deque<Call*>::iterator it = _inFlight.begin(); it != _inFlight.end(); ++it)
+    delete *it;
+}
+
+
+bool
+XmlRpcAsyncClient::Connection::connect()
+{
+  int fd = XmlRpcSocket::socket(_client->_host);
+  if (fd < 0) {
+    XmlRpcUtil::error("Error in XmlRpcAsyncClient::Connection::connect: Could not create socket (%s).",
+                      XmlRpcSocket::getErrorMsg().c_str());
+    return false;
+  }
+  setfd(fd);
+
+  // Pipelined requests are written as soon as they are queued
+  if ( ! XmlRpcSocket::isUnixHost(_client->_host))
+    XmlRpcSocket::setNoDelay(fd, true);
+
+  if ( ! XmlRpcSocket::setNonBlocking(fd) ||
+       ! XmlRpcSocket::connect(fd, _client->_host, _client->_port)) {
+    XmlRpcUtil::error("Error in XmlRpcAsyncClient::Connection::connect: Could not connect to server (%s).",
+                      XmlRpcSocket::getErrorMsg().c_str());
+    return false;
+  }
+
+  XmlRpcUtil::log(3, "XmlRpcAsyncClient::Connection::connect: fd %d.", fd);
+  return true;
+}
+
+
+// Queue the request behind those already written (pipelining)
+void
+XmlRpcAsyncClient::Connection::send(Call* call)
+{
+  call->_sendAttempts++;
+  _out += call->_request;
+  _inFlight.push_back(call);
+  _client->_disp.setSourceEvents(this, XmlRpcDispatch::ReadableEvent | XmlRpcDispatch::WritableEvent |
+                                       XmlRpcDispatch::Exception);
+}
+
+
+unsigned
+XmlRpcAsyncClient::Connection::handleEvent(unsigned eventType)
+{
+  // The dispatcher may report further events after an error
+  if (_broken)
+    return 0;
+
+  if (eventType == XmlRpcDispatch::Exception) {
+    fail("socket error " + XmlRpcSocket::getErrorMsg());
+    return 0;
+  }
+
+  if (eventType == XmlRpcDispatch::WritableEvent && _bytesWritten < int(_out.length())) {
+    if ( ! XmlRpcSocket::nbWrite(getfd(), _out, &_bytesWritten)) {
+      fail((neverConnected() ? "could not connect to server (" : "write error (") +
+           XmlRpcSocket::getErrorMsg() + ")");
+      return 0;
+    }
+    XmlRpcUtil::log(4, "XmlRpcAsyncClient::Connection: wrote %d of %d bytes.", _bytesWritten, _out.length());
+    if (_bytesWritten == int(_out.length())) {
+      _out = "";
+      _bytesWritten = 0;
+    }
+  }
+
+  if (eventType == XmlRpcDispatch::ReadableEvent) {
+    bool eof = false;
+    if ( ! XmlRpcSocket::nbRead(getfd(), _in, &eof)) {
+      fail((neverConnected() ? "could not connect to server (" : "read error (") +
+           XmlRpcSocket::getErrorMsg() + ")");
+      return 0;
+    }
+    if ( ! readResponses())
+      return 0;
+    if (eof) {
+      // Unanswered requests were not processed, unless part of a response arrived
+      if ( ! _inFlight.empty() || _in.length() > 0)
+        fail("server closed the connection");
+      else
+        discardIdle();
+      return 0;
+    }
+  }
+
+  // Close once the server's last response has been read
+  if (_closing && _inFlight.empty()) {
+    discardIdle();
+    return 0;
+  }
+
+  unsigned mask = XmlRpcDispatch::ReadableEvent | XmlRpcDispatch::Exception;
+  if (_out.length() > 0)
+    mask |= XmlRpcDispatch::WritableEvent;
+  return mask;
+}
+
+
+void
+XmlRpcAsyncClient::Connection::close()
+{
+  if (_client)
+    _client->connectionClosed(this);
+  XmlRpcSource::close();
+}
+
+
+// Split complete responses off the input and hand them to their calls
+bool
+XmlRpcAsyncClient::Connection::readResponses()
+{
+  while (_in.length() > 0) {
+    size_t sep = 4;
+    size_t bp = _in.find("\r\n\r\n");
+    if (bp == std::string::npos) {
+      sep = 2;
+      bp = _in.find("\n\n");
+    }
+    if (bp == std::string::npos)
+      return true;    // Keep reading
+
+    std::string header(_in, 0, bp);
+    for (size_t i = 0; i < header.length(); ++i)
+      header[i] = char(tolower((unsigned char) header[i]));
+
+    size_t lp = header.find("content-length:");
+    int contentLength = (lp == std::string::npos) ? 0 : atoi(header.c_str() + lp + 15);
+    if (contentLength <= 0) {
+      fail("no Content-length in response", false);
+      return false;
+    }
+
+    bp += sep;
+    if (_in.length() < bp + contentLength)
+      return true;    // Keep reading
+
+    if (header.find("connection: close") != std::string::npos)
+      _closing = true;
+
+    std::string body(_in, bp, contentLength);
+    _in.erase(0, bp + contentLength);
+    ++_responses;
+
+    if (_inFlight.empty()) {
+      fail("unexpected response", false);
+      return false;
+    }
+
+    Call* call = _inFlight.front();
+    _inFlight.pop_front();
+    XmlRpcUtil::log(5, "XmlRpcAsyncClient::Connection: response to call %d:\n%s", call->_id, body.c_str());
+    if ( ! call->_done)
+      _client->parseResponse(body, call);
+    delete call;
+
+    // A pipeline slot just opened up
+    _client->assignCalls();
+  }
+  return true;
+}
+
+
+// Report the calls in flight as failed, or queue the idempotent ones again when
+// the server just dropped a keep-alive connection (it may have executed the others)
+void
+XmlRpcAsyncClient::Connection::fail(std::string const& msg, bool retry /*= true*/)
+{
+  _broken = true;
+  _client->connectionClosed(this);
+
+  bool reused = (_responses > 0 || _closing);
+  std::deque<Call*> calls;
+  calls.swap(_inFlight);
+
+  // Re-queue at the front, in the original order
+  bool partial = (_in.length() > 0);
+  for (std::deque<Call*>::reverse_iterator it = calls.rbegin(); it != calls.rend(); ++it) {
+    Call* call = *it;
+    bool isHead = (call == calls.front());
+    if ( ! call->_done && call->_idempotent && retry && reused && call->_sendAttempts < 2 &&
+         ! (isHead && partial)) {
+      _client->_pending.push_front(call);
+      *it = 0;
+    }
+  }
+
+  for (std::deque<Call*>::iterator it = calls.begin(); it != calls.end(); ++it)
+    if (*it) {
+      if ( ! (*it)->_done)
+        _client->completeError(*it, CallError, msg);
+      delete *it;
+    }
+
+  // Let work() hand re-queued calls to another connection
+  _client->_disp.exit();
+}
+
+
+// Take an idle connection out of the pool; the dispatcher closes it
+void
+XmlRpcAsyncClient::Connection::discardIdle()
+{
+  _broken = true;
+  _client->connectionClosed(this);
+}
+
+
+// Drop the calls in flight without reporting them (the client is going away)
+void
+XmlRpcAsyncClient::Connection::discard()
+{
+  _broken = true;
+  _client = 0;
+}
+
+
+double
+XmlRpcAsyncClient::Connection::nextDeadline() const
+{
+  double next = -1.0;
+  for (std::deque<Call*>::const_iterator it = _inFlight.begin(); it != _inFlight.end(); ++it)
+    if ( ! (*it)->_done && (*it)->_deadline >= 0.0 && (next < 0.0 || (*it)->_deadline < next))
+      next = (*it)->_deadline;
+  return next;
+}
+
+
+// Time out expired calls. Their responses are discarded when they arrive, so
+// the calls pipelined behind them are unaffected. Returns true if every request
+// on the connection has timed out.
+bool
+XmlRpcAsyncClient::Connection::expireCalls(double now)
+{
+  std::deque<Call*> expired;
+  for (std::deque<Call*>::iterator it = _inFlight.begin(); it != _inFlight.end(); ++it)
+    if ( ! (*it)->_done && (*it)->_deadline >= 0.0 && (*it)->_deadline <= now) {
+      (*it)->_done = true;
+      expired.push_back(*it);
+    }
+
+  for (std::deque<Call*>::iterator it = expired.begin(); it != expired.end(); ++it)
+    _client->completeError(*it, CallTimeout, "call timed out");
+
+  if (_inFlight.empty())
+    return false;
+  for (std::deque<Call*>::iterator it = _inFlight.begin(); it != _inFlight.end(); ++it)
+    if ( ! (*it)->_done)
+      return false;
+  return true;
+}
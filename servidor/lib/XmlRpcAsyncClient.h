@@ -0,0 +1,178 @@
+
+#ifndef _XMLRPCASYNCCLIENT_H_
+#define _XMLRPCASYNCCLIENT_H_
+//
+// XmlRpc++ Copyright (c) 2002-2003 by Chris Morley
+//
+#if defined(_MSC_VER)
+# pragma warning(disable:4786)    // identifier was truncated in debug info
+#endif
+
+#ifndef MAKEDEPEND
+# include <deque>
+# include <functional>
+# include <future>
+# include <list>
+# include <string>
+#endif
+
+#include "XmlRpcDispatch.h"
+#include "XmlRpcSource.h"
+#include "XmlRpcValue.h"
+
+namespace XmlRpc {
+
+  //! A client that keeps many calls to one server outstanding at once.
+  //!
+  //! Calls are queued with executeAsync() (or call(), which returns a future)
+  //! and sent over a pool of keep-alive connections, several requests in flight
+  //! per connection (HTTP pipelining; responses arrive in request order). Nothing
+  //! happens in the background: calls progress and complete, and their callbacks
+  //! run, while the owner runs work(). Like XmlRpcClient, an instance must only be
+  //! used from one thread; use one client per thread for multithreading.
+  class XmlRpcAsyncClient {
+  public:
+    //! How a call ended
+    enum CallStatus {
+      CallOk,         //!< result holds the method's return value
+      CallFault,      //!< result holds the fault struct (faultCode, faultString)
+      CallError,      //!< the call could not be sent or the response was invalid (result holds a message)
+      CallTimeout     //!< the deadline passed before the response arrived (result holds a message)
+    };
+
+    //! Completion callback. Called once per call from within work() (or from
+    //! executeAsync itself if the call fails immediately). It may start new calls.
+    typedef std::function<void(int callId, CallStatus status, XmlRpcValue& result)> Callback;
+
+    //! Construct a client for the server at host:port
+    //!  @param host The name of the remote machine hosting the server
+    //!  @param port The port on the remote machine where the server is listening
+    //!  @param uri  An optional string to be sent as the URI in the HTTP POST header
+    XmlRpcAsyncClient(const char* host, int port, const char* uri=0);
+
+    //! Destructor. Outstanding calls are dropped without running their callbacks.
+    ~XmlRpcAsyncClient();
+
+    //! Maximum number of connections opened to the server (default 4)
+    void setMaxConnections(int n) { _maxConnections = (n < 1) ? 1 : n; }
+    int getMaxConnections() const { return _maxConnections; }
+
+    //! Maximum number of requests in flight on one connection (default 8, 1 disables pipelining)
+    void setMaxPipeline(int n) { _maxPipeline = (n < 1) ? 1 : n; }
+    int getMaxPipeline() const { return _maxPipeline; }
+
+    //! Queue a call of the named procedure on the remote server.
+    //!  @param method The name of the remote procedure to execute
+    //!  @param params An array of the arguments for the method (or a single value)
+    //!  @param callback Called with the outcome of the call
+    //!  @param msTimeout Deadline for the call in milliseconds, -1 for none
+    //!  @param idempotent True if running the call twice is harmless. Only such calls
+    //!         are sent again when a reused connection drops before their response,
+    //!         since the server may already have executed them.
+    //!  @return An id identifying the call in the callback
+    int executeAsync(const char* method, XmlRpcValue const& params, Callback callback,
+                     double msTimeout = -1.0, bool idempotent = false);
+
+    //! Queue a call and return a future for its result. The future becomes ready
+    //! while work() runs; faults, errors and timeouts are stored in it as an
+    //! XmlRpcException.
+    std::future<XmlRpcValue> call(const char* method, XmlRpcValue const& params,
+                                  double msTimeout = -1.0, bool idempotent = false);
+
+    //! Process IO until all outstanding calls complete or msTime milliseconds
+    //! pass (-1 waits for all calls). Returns true if no calls are outstanding.
+    bool work(double msTime = -1.0);
+
+    //! Number of calls queued or in flight
+    int getOutstanding() const { return _outstanding; }
+
+    //! Number of connections currently open
+    int getConnectionCount() const { return int(_connections.size()); }
+
+    //! Close all connections, failing the calls in flight on them with CallError
+    void close();
+
+  protected:
+    // A queued or in-flight call
+    struct Call {
+      int _id;
+      std::string _request;       // http header and xml body
+      Callback _callback;
+      double _deadline;           // absolute time in seconds, -1 if none
+      int _sendAttempts;
+      bool _idempotent;           // may be sent again after a dropped connection
+      bool _done;                 // completed (timed out) while still in flight
+    };
+
+    // A pooled connection to the server
+    class Connection : public XmlRpcSource {
+    public:
+      Connection(XmlRpcAsyncClient* client);
+      virtual ~Connection();
+
+      bool connect();
+      void send(Call* call);
+      virtual unsigned handleEvent(unsigned eventType);
+      virtual void close();
+
+      int getInFlight() const { return int(_inFlight.size()); }
+      bool isUsable() const { return ! _broken && ! _closing; }
+      double nextDeadline() const;
+      bool expireCalls(double now);
+      void fail(std::string const& msg, bool retry = true);
+      void discard();
+
+    protected:
+      bool readResponses();
+      void discardIdle();
+
+      // Nothing was ever written or received (a failure means the connect failed)
+      bool neverConnected() const { return _responses == 0 && _bytesWritten == 0 && _out.length() > 0; }
+
+      XmlRpcAsyncClient* _client;
+      std::deque<Call*> _inFlight;    // In the order the requests were written
+      std::string _out;               // Requests not yet written
+      int _bytesWritten;
+      std::string _in;                // Response bytes not yet consumed
+      int _responses;                 // Responses received on this connection
+      bool _closing;                  // The server said it will close the connection
+      bool _broken;                   // An error occurred, waiting to be closed by the dispatcher
+    };
+
+    friend class Connection;
+
+    std::string generateRequest(const char* method, XmlRpcValue const& params);
+    void assignCalls();
+    void expireCalls();
+    double nextDeadline();
+    void complete(Call* call, CallStatus status, XmlRpcValue& result);
+    void completeError(Call* call, CallStatus status, std::string const& msg);
+    void connectionClosed(Connection* conn);
+    void parseResponse(std::string const& response, Call* call);
+    static double getTime();
+
+    // Server location
+    std::string _host;
+    std::string _uri;
+    int _port;
+
+    int _maxConnections;
+    int _maxPipeline;
+
+    // Calls waiting for a connection with room in its pipeline
+    std::deque<Call*> _pending;
+
+    // Open connections
+    std::list<Connection*> _connections;
+
+    int _nextId;
+    int _outstanding;
+    bool _assigning;
+
+    // Event dispatcher
+    XmlRpcDispatch _disp;
+  };
+
+} // namespace XmlRpc
+
+#endif  // _XMLRPCASYNCCLIENT_H_
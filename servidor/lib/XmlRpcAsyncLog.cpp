@@ -0,0 +1,564 @@
+
+#include "XmlRpcAsyncLog.h"
+#include "XmlRpc.h"
+
+#ifndef MAKEDEPEND
+# include <algorithm>
+# include <atomic>
+# include <chrono>
+# include <condition_variable>
+# include <memory>
+# include <mutex>
+# include <stdint.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <string>
+# include <thread>
+# include <vector>
+#endif
+
+using namespace XmlRpc;
+
+
+// A record in a ring is a header followed by the arguments in the order the
+// format consumes them, each in an 8 byte slot (strings: length, then the chars
+// padded to 8). Records are 8 byte aligned and never wrap; a header with size 0
+// means the rest of the ring is unused.
+struct LogRecordHeader {
+  unsigned size;
+  int level;
+  const char* fmt;
+};
+
+static const size_t LOG_SLOT = 8;
+static const size_t LOG_MAX_RECORD = 4096;
+static const size_t LOG_MAX_STRING = 1023;       // The message limit of the synchronous log
+
+static size_t slotAlign(size_t n) { return (n + LOG_SLOT - 1) & ~(LOG_SLOT - 1); }
+
+
+// The ring of one thread. Only that thread writes records and advances head;
+// only the background writer reads them and advances tail.
+struct LogRing {
+  LogRing(size_t bytes) : buf(bytes), head(0), tail(0), closed(false) {}
+
+  std::vector<char> buf;                  // Size is a power of two
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+  std::atomic<bool> closed;               // The thread has exited
+};
+
+
+static struct AsyncLogState {
+  AsyncLogState() : ringBytes(0), stopping(false), flushRequests(0), flushesDone(0),
+                    running(false), pending(false), dropped(0) {}
+
+  std::mutex mutex;                       // Guards everything but the atomics
+  std::condition_variable wake;
+  std::condition_variable flushed;
+  std::vector<std::shared_ptr<LogRing> > rings;
+  std::thread writer;
+  size_t ringBytes;
+  bool stopping;
+  unsigned long flushRequests;
+  unsigned long flushesDone;
+
+  std::atomic<bool> running;
+  std::atomic<bool> pending;              // A record was written since the writer last looked
+  std::atomic<unsigned long> dropped;
+} logState;
+
+
+// Marks the ring of an exiting thread so the writer can forget it once drained
+struct LogRingHolder {
+  ~LogRingHolder() { if (ring) ring->closed = true; }
+  std::shared_ptr<LogRing> ring;
+};
+
+static thread_local LogRingHolder localRing;
+
+
+// Conversion specifications, parsed the same way when recording and formatting
+
+enum LogArgKind { ArgNone, ArgInt, ArgUnsigned, ArgDouble, ArgPointer, ArgString, ArgSkip };
+
+enum LogArgLength { LenNone, LenChar, LenShort, LenLong, LenLongLong, LenIntMax, LenSize, LenPtrDiff, LenLongDouble };
+
+struct LogSpec {
+  const char* begin;          // The '%'
+  const char* lengthBegin;    // Start of the length modifier (end of flags, width and precision)
+  const char* end;            // Past the conversion character
+  bool widthStar;
+  bool precisionStar;
+  LogArgLength length;
+  LogArgKind kind;
+  char conversion;
+};
+
+// Parse the specification starting at the '%' at p (not "%%")
+static void parseSpec(const char* p, LogSpec& s)
+{
+  s.begin = p++;
+  s.widthStar = s.precisionStar = false;
+  while (*p && strchr("-+ #0", *p)) ++p;
+  if (*p == '*') { s.widthStar = true; ++p; }
+  else while (*p >= '0' && *p <= '9') ++p;
+  if (*p == '.') {
+    ++p;
+    if (*p == '*') { s.precisionStar = true; ++p; }
+    else while (*p >= '0' && *p <= '9') ++p;
+  }
+
+  s.lengthBegin = p;
+  s.length = LenNone;
+  switch (*p) {
+    case 'h': ++p; if (*p == 'h') { ++p; s.length = LenChar; } else s.length = LenShort; break;
+    case 'l': ++p; if (*p == 'l') { ++p; s.length = LenLongLong; } else s.length = LenLong; break;
+    case 'j': ++p; s.length = LenIntMax; break;
+    case 'z': ++p; s.length = LenSize; break;
+    case 't': ++p; s.length = LenPtrDiff; break;
+    case 'L': ++p; s.length = LenLongDouble; break;
+  }
+
+  s.conversion = *p;
+  switch (*p) {
+    case 'd': case 'i': case 'c':                     s.kind = ArgInt; break;
+    case 'u': case 'o': case 'x': case 'X':           s.kind = ArgUnsigned; break;
+    case 'f': case 'F': case 'e': case 'E':
+    case 'g': case 'G': case 'a': case 'A':           s.kind = ArgDouble; break;
+    case 'p':                                         s.kind = ArgPointer; break;
+    case 's': s.kind = (s.length == LenNone) ? ArgString : ArgSkip; break;   // Wide strings are left out
+    case 'n':                                         s.kind = ArgSkip; break;
+    default:                                          s.kind = ArgNone; break;
+  }
+  s.end = (s.kind == ArgNone) ? p : p + 1;
+}
+
+
+// Recording
+
+class LogRecordWriter {
+public:
+  LogRecordWriter(char* buf, size_t size) : _buf(buf), _size(size), _used(sizeof(LogRecordHeader)), _full(false) {}
+
+  void slot(const void* value, size_t n)
+  {
+    if (_used + LOG_SLOT > _size) { _full = true; return; }
+    memset(_buf + _used, 0, LOG_SLOT);
+    memcpy(_buf + _used, value, n);
+    _used += LOG_SLOT;
+  }
+
+  void string(const char* s)
+  {
+    if (s == 0) s = "(null)";
+    size_t len = strnlen(s, LOG_MAX_STRING);
+    if (_used + LOG_SLOT > _size) { _full = true; return; }
+    if (_used + LOG_SLOT + slotAlign(len) > _size)
+      len = _size - _used - LOG_SLOT;
+    unsigned n = unsigned(len);
+    slot(&n, sizeof(n));
+    memcpy(_buf + _used, s, len);
+    _used += slotAlign(len);
+  }
+
+  bool full() const { return _full; }
+  size_t used() const { return _used; }
+
+private:
+  char* _buf;
+  size_t _size;
+  size_t _used;
+  bool _full;
+};
+
+
+// Copy the arguments of fmt into rec, returning the record size
+static size_t encodeRecord(int level, const char* fmt, va_list va, char* rec, size_t size)
+{
+  LogRecordWriter w(rec, size);
+  for (const char* p = fmt; *p && ! w.full(); ) {
+    if (*p != '%') { ++p; continue; }
+    if (p[1] == '%') { p += 2; continue; }
+
+    LogSpec s;
+    parseSpec(p, s);
+    p = s.end;
+    if (s.widthStar)     { int n = va_arg(va, int); w.slot(&n, sizeof(n)); }
+    if (s.precisionStar) { int n = va_arg(va, int); w.slot(&n, sizeof(n)); }
+
+    switch (s.kind) {
+      case ArgInt:
+        {
+          long long v;
+          switch (s.length) {
+            case LenLong:     v = va_arg(va, long); break;
+            case LenLongLong: v = va_arg(va, long long); break;
+            case LenIntMax:   v = va_arg(va, intmax_t); break;
+            case LenSize:     v = (long long) va_arg(va, size_t); break;
+            case LenPtrDiff:  v = va_arg(va, ptrdiff_t); break;
+            case LenChar:     v = (signed char) va_arg(va, int); break;
+            case LenShort:    v = (short) va_arg(va, int); break;
+            default:          v = va_arg(va, int); break;
+          }
+          w.slot(&v, sizeof(v));
+          break;
+        }
+      case ArgUnsigned:
+        {
+          unsigned long long v;
+          switch (s.length) {
+            case LenLong:     v = va_arg(va, unsigned long); break;
+            case LenLongLong: v = va_arg(va, unsigned long long); break;
+            case LenIntMax:   v = va_arg(va, uintmax_t); break;
+            case LenSize:     v = va_arg(va, size_t); break;
+            case LenPtrDiff:  v = (unsigned long long) va_arg(va, ptrdiff_t); break;
+            case LenChar:     v = (unsigned char) va_arg(va, unsigned); break;
+            case LenShort:    v = (unsigned short) va_arg(va, unsigned); break;
+            default:          v = va_arg(va, unsigned); break;
+          }
+          w.slot(&v, sizeof(v));
+          break;
+        }
+      case ArgDouble:
+        {
+          double v = (s.length == LenLongDouble) ? double(va_arg(va, long double)) : va_arg(va, double);
+          w.slot(&v, sizeof(v));
+          break;
+        }
+      case ArgPointer:
+        {
+          void* v = va_arg(va, void*);
+          w.slot(&v, sizeof(v));
+          break;
+        }
+      case ArgString:
+        w.string(va_arg(va, const char*));
+        break;
+      case ArgSkip:
+        (void) va_arg(va, void*);
+        break;
+      case ArgNone:
+        break;
+    }
+  }
+
+  LogRecordHeader h;
+  h.size = unsigned(w.used());
+  h.level = level;
+  h.fmt = fmt;
+  memcpy(rec, &h, sizeof(h));
+  return w.used();
+}
+
+
+// Formatting, on the writer thread
+
+class LogRecordReader {
+public:
+  LogRecordReader(const char* p, const char* end) : _p(p), _end(end) {}
+
+  bool more() const { return _p + LOG_SLOT <= _end; }
+
+  template <class T>
+  T slot()
+  {
+    T v;
+    memcpy(&v, _p, sizeof(v));
+    _p += LOG_SLOT;
+    return v;
+  }
+
+  std::string string()
+  {
+    unsigned n = slot<unsigned>();
+    if (n > size_t(_end - _p)) n = unsigned(_end - _p);
+    std::string s(_p, n);
+    _p += slotAlign(n);
+    return s;
+  }
+
+private:
+  const char* _p;
+  const char* _end;
+};
+
+
+template <class T>
+static void appendFormatted(std::string& out, const char* f, const int* star, int nStars, T v)
+{
+  char buf[256];
+  int n;
+  switch (nStars) {
+    case 0:  n = snprintf(buf, sizeof(buf), f, v); break;
+    case 1:  n = snprintf(buf, sizeof(buf), f, star[0], v); break;
+    default: n = snprintf(buf, sizeof(buf), f, star[0], star[1], v); break;
+  }
+  if (n < 0)
+    return;
+  if (size_t(n) < sizeof(buf)) {
+    out.append(buf, n);
+    return;
+  }
+
+  std::vector<char> big(n + 1);
+  switch (nStars) {
+    case 0:  snprintf(&big[0], big.size(), f, v); break;
+    case 1:  snprintf(&big[0], big.size(), f, star[0], v); break;
+    default: snprintf(&big[0], big.size(), f, star[0], star[1], v); break;
+  }
+  out.append(&big[0], n);
+}
+
+
+static void formatRecord(const char* fmt, const char* args, const char* argsEnd, std::string& out)
+{
+  LogRecordReader r(args, argsEnd);
+  const char* p = fmt;
+  while (*p) {
+    if (*p != '%') {
+      const char* q = strchr(p, '%');
+      if (q == 0) q = p + strlen(p);
+      out.append(p, q - p);
+      p = q;
+      continue;
+    }
+    if (p[1] == '%') { out += '%'; p += 2; continue; }
+
+    LogSpec s;
+    parseSpec(p, s);
+    p = s.end;
+    if (s.kind == ArgNone) {                        // Not a conversion we know, write it as is
+      out.append(s.begin, s.end - s.begin);
+      continue;
+    }
+    if (s.kind == ArgSkip)
+      continue;
+
+    int star[2];
+    int nStars = 0;
+    if (s.widthStar && r.more())     star[nStars++] = int(r.slot<int>());
+    if (s.precisionStar && r.more()) star[nStars++] = int(r.slot<int>());
+    if ( ! r.more()) {                              // Record was truncated
+      out += "...";
+      return;
+    }
+
+    // Rebuild the specification for the type the argument was stored as
+    std::string f(s.begin, s.lengthBegin - s.begin);
+    switch (s.kind) {
+      case ArgInt:
+        if (s.conversion == 'c') { f += 'c'; appendFormatted(out, f.c_str(), star, nStars, int(r.slot<long long>())); }
+        else { f += "ll"; f += s.conversion; appendFormatted(out, f.c_str(), star, nStars, r.slot<long long>()); }
+        break;
+      case ArgUnsigned:
+        f += "ll"; f += s.conversion;
+        appendFormatted(out, f.c_str(), star, nStars, r.slot<unsigned long long>());
+        break;
+      case ArgDouble:
+        f += s.conversion;
+        appendFormatted(out, f.c_str(), star, nStars, r.slot<double>());
+        break;
+      case ArgPointer:
+        f += 'p';
+        appendFormatted(out, f.c_str(), star, nStars, r.slot<void*>());
+        break;
+      case ArgString:
+        {
+          f += 's';
+          std::string str = r.string();
+          appendFormatted(out, f.c_str(), star, nStars, str.c_str());
+          break;
+        }
+      default:
+        break;
+    }
+  }
+}
+
+
+// Write the records in r. Returns true if there were any.
+static bool drainRing(LogRing& r, std::string& msg)
+{
+  size_t tail = r.tail.load(std::memory_order_relaxed);
+  size_t head = r.head.load(std::memory_order_acquire);
+  if (tail == head)
+    return false;
+
+  size_t mask = r.buf.size() - 1;
+  while (tail != head) {
+    const char* p = &r.buf[tail & mask];
+    unsigned size;
+    memcpy(&size, p, sizeof(size));
+    if (size == 0) {                                // Wrap
+      tail += r.buf.size() - (tail & mask);
+    } else {
+      LogRecordHeader h;
+      memcpy(&h, p, sizeof(h));
+      msg.clear();
+      formatRecord(h.fmt, p + sizeof(h), p + h.size, msg);
+      if (msg.size() > LOG_MAX_STRING)
+        msg.resize(LOG_MAX_STRING);
+      XmlRpcLogHandler::getLogHandler()->log(h.level, msg.c_str());
+      tail += h.size;
+    }
+    r.tail.store(tail, std::memory_order_release);
+  }
+  return true;
+}
+
+
+static void writerLoop()
+{
+  std::string msg;
+  unsigned long reportedDrops = 0;
+  std::unique_lock<std::mutex> lock(logState.mutex);
+  for (;;) {
+    unsigned long flushRequest = logState.flushRequests;
+    bool stopping = logState.stopping;
+    std::vector<std::shared_ptr<LogRing> > rings = logState.rings;
+    logState.pending = false;
+    lock.unlock();
+
+    bool any = false;
+    for (size_t i = 0; i < rings.size(); ++i)
+      any = drainRing(*rings[i], msg) || any;
+
+    unsigned long dropped = logState.dropped.load();
+    if (dropped != reportedDrops) {
+      char buf[96];
+      snprintf(buf, sizeof(buf), "XmlRpcAsyncLog: %lu messages dropped (log ring full).", dropped - reportedDrops);
+      XmlRpcLogHandler::getLogHandler()->log(1, buf);
+      reportedDrops = dropped;
+    }
+
+    lock.lock();
+    // Forget the rings of threads that exited once they are empty
+    std::vector<std::shared_ptr<LogRing> >& all = logState.rings;
+    all.erase(std::remove_if(all.begin(), all.end(), [](std::shared_ptr<LogRing> const& r) {
+                return r->closed && r->head.load() == r->tail.load(); }),
+              all.end());
+
+    logState.flushesDone = flushRequest;
+    logState.flushed.notify_all();
+    if (stopping)
+      break;
+    if ( ! any && ! logState.pending && ! logState.stopping && logState.flushRequests == flushRequest)
+      logState.wake.wait_for(lock, std::chrono::milliseconds(50));
+  }
+  logState.flushesDone = logState.flushRequests;
+  logState.flushed.notify_all();
+}
+
+
+static void stopAtExit()
+{
+  XmlRpcAsyncLog::stop();
+}
+
+
+void
+XmlRpcAsyncLog::start(size_t ringBytes)
+{
+  std::lock_guard<std::mutex> lock(logState.mutex);
+  if (logState.running)
+    return;
+
+  // Power of two, large enough for the biggest record
+  size_t bytes = 2 * LOG_MAX_RECORD;
+  while (bytes < ringBytes) bytes *= 2;
+  logState.ringBytes = bytes;
+
+  static bool atExitRegistered = false;
+  if ( ! atExitRegistered) {
+    atexit(stopAtExit);
+    atExitRegistered = true;
+  }
+
+  logState.stopping = false;
+  logState.writer = std::thread(writerLoop);
+  logState.running = true;
+}
+
+
+void
+XmlRpcAsyncLog::flush()
+{
+  std::unique_lock<std::mutex> lock(logState.mutex);
+  if ( ! logState.running)
+    return;
+  unsigned long ticket = ++logState.flushRequests;
+  logState.wake.notify_one();
+  logState.flushed.wait(lock, [ticket]() { return logState.flushesDone >= ticket; });
+}
+
+
+void
+XmlRpcAsyncLog::stop()
+{
+  std::unique_lock<std::mutex> lock(logState.mutex);
+  if ( ! logState.running)
+    return;
+  logState.running = false;     // New messages are formatted by their callers
+  logState.stopping = true;
+  logState.wake.notify_one();
+  lock.unlock();
+
+  logState.writer.join();
+}
+
+
+bool
+XmlRpcAsyncLog::isRunning()
+{
+  return logState.running;
+}
+
+
+unsigned long
+XmlRpcAsyncLog::getDropped()
+{
+  return logState.dropped;
+}
+
+
+bool
+XmlRpcAsyncLog::record(int level, const char* fmt, va_list va)
+{
+  if ( ! logState.running.load(std::memory_order_acquire))
+    return false;
+
+  LogRing* r = localRing.ring.get();
+  if (r == 0) {
+    std::lock_guard<std::mutex> lock(logState.mutex);
+    localRing.ring = std::make_shared<LogRing>(logState.ringBytes);
+    logState.rings.push_back(localRing.ring);
+    r = localRing.ring.get();
+  }
+
+  char rec[LOG_MAX_RECORD];
+  size_t n = encodeRecord(level, fmt, va, rec, sizeof(rec));
+
+  size_t cap = r->buf.size();
+  size_t head = r->head.load(std::memory_order_relaxed);
+  size_t tail = r->tail.load(std::memory_order_acquire);
+  size_t offset = head & (cap - 1);
+  size_t skip = (cap - offset < n) ? cap - offset : 0;
+  if (cap - (head - tail) < skip + n) {
+    ++logState.dropped;
+    return true;
+  }
+
+  if (skip) {
+    unsigned wrap = 0;
+    memcpy(&r->buf[offset], &wrap, sizeof(wrap));
+    offset = 0;
+  }
+  memcpy(&r->buf[offset], rec, n);
+  r->head.store(head + skip + n, std::memory_order_release);
+
+  if ( ! logState.pending.exchange(true))
+    logState.wake.notify_one();
+  return true;
+}
@@ -0,0 +1,51 @@
+
+#ifndef _XMLRPCASYNCLOG_H_
+#define _XMLRPCASYNCLOG_H_
+//
+// XmlRpc++ Copyright (c) 2002-2003 by Chris Morley
+//
+#if defined(_MSC_VER)
+# pragma warning(disable:4786)    // identifier was truncated in debug info
+#endif
+
+#ifndef MAKEDEPEND
+# include <stdarg.h>
+# include <stddef.h>
+#endif
+
+namespace XmlRpc {
+
+  //! Background writer for informational messages.
+  //!
+  //! While it runs, XmlRpcUtil::log does no formatting or IO: the calling thread
+  //! copies the level, the format pointer and the arguments into a ring buffer of
+  //! its own (one producer, one consumer, no locks) and a background thread
+  //! formats the messages and passes them to the XmlRpcLogHandler. Formats must
+  //! therefore be string literals; %s arguments are copied, up to 1023 chars.
+  //! Messages from one thread keep their order. If a thread's ring is full the
+  //! message is dropped and counted.
+  class XmlRpcAsyncLog {
+  public:
+    //! Start the background writer, with ringBytes of buffer for each thread that logs
+    static void start(size_t ringBytes = 64 * 1024);
+
+    //! Return once all messages recorded before the call have been written
+    static void flush();
+
+    //! Flush and stop the background writer. Messages are formatted by the caller again.
+    static void stop();
+
+    //! True while the background writer runs
+    static bool isRunning();
+
+    //! Number of messages dropped because a ring was full
+    static unsigned long getDropped();
+
+    //! Record a message for the background writer. Returns false (without
+    //! touching va) if the writer is not running.
+    static bool record(int level, const char* fmt, va_list va);
+  };
+
+} // namespace XmlRpc
+
+#endif  // _XMLRPCASYNCLOG_H_
@@ -0,0 +1,71 @@
+
+#include "XmlRpcBinarySink.h"
+#include "XmlRpcValue.h"
+#include "XmlRpcUtil.h"
+
+using namespace XmlRpc;
+
+
+bool
+XmlRpcMemorySink::write(const char* data, size_t len)
+{
+  _data.insert(_data.end(), data, data + len);
+  return true;
+}
+
+
+// The bytes are moved into the value, not copied
+bool
+XmlRpcMemorySink::finish(XmlRpcValue& value)
+{
+  value = XmlRpcValue((void*) "", 0);
+  XmlRpcValue::BinaryData& bytes = value;
+  bytes.swap(_data);
+  return true;
+}
+
+
+XmlRpcFileSink::XmlRpcFileSink(std::string const& path) : _path(path), _size(0)
+{
+  _file = fopen(path.c_str(), "wb");
+  if ( ! _file)
+    XmlRpcUtil::error("XmlRpcFileSink: Could not create %s.", path.c_str());
+}
+
+
+XmlRpcFileSink::~XmlRpcFileSink()
+{
+  if (_file)
+  {
+    fclose(_file);
+    remove(_path.c_str());
+  }
+}
+
+
+bool
+XmlRpcFileSink::write(const char* data, size_t len)
+{
+  if ( ! _file || fwrite(data, 1, len, _file) != len)
+    return false;
+  _size += len;
+  return true;
+}
+
+
+bool
+XmlRpcFileSink::finish(XmlRpcValue& value)
+{
+  if ( ! _file)
+    return false;
+  bool ok = (fclose(_file) == 0);
+  _file = 0;
+  if ( ! ok)
+  {
+    remove(_path.c_str());
+    return false;
+  }
+  value["file"] = _path;
+  value["size"] = int(_size);
+  return true;
+}
@@ -0,0 +1,70 @@
+
+#ifndef _XMLRPCBINARYSINK_H_
+#define _XMLRPCBINARYSINK_H_
+//
+// XmlRpc++ Copyright (c) 2002-2003 by Chris Morley
+//
+#if defined(_MSC_VER)
+# pragma warning(disable:4786)    // identifier was truncated in debug info
+#endif
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string>
+# include <vector>
+#endif
+
+namespace XmlRpc {
+
+  class XmlRpcValue;
+
+  //! Destination of a large base64 parameter, decoded while the request is still
+  //! arriving so the encoded text is never held in memory as a whole.
+  //! @see XmlRpcServerMethod::createBinarySink
+  class XmlRpcBinarySink {
+  public:
+    virtual ~XmlRpcBinarySink() {}
+
+    //! Append decoded bytes. Return false to reject the call.
+    virtual bool write(const char* data, size_t len) = 0;
+
+    //! The parameter is complete: set value to what the method receives in its place.
+    //! Return false to reject the call.
+    virtual bool finish(XmlRpcValue& value) = 0;
+  };
+
+
+  //! Collects the bytes in memory; the method receives an ordinary base64 value.
+  class XmlRpcMemorySink : public XmlRpcBinarySink {
+  public:
+    //! expectedBytes, if known, is reserved up front
+    XmlRpcMemorySink(size_t expectedBytes = 0) { _data.reserve(expectedBytes); }
+
+    bool write(const char* data, size_t len);
+    bool finish(XmlRpcValue& value);
+
+  private:
+    std::vector<char> _data;
+  };
+
+
+  //! Writes the bytes to a file; the method receives a struct with members "file"
+  //! (the path) and "size" (bytes written). The file is removed if the call is
+  //! rejected or the connection drops before the parameter is complete.
+  class XmlRpcFileSink : public XmlRpcBinarySink {
+  public:
+    XmlRpcFileSink(std::string const& path);
+    ~XmlRpcFileSink();
+
+    bool write(const char* data, size_t len);
+    bool finish(XmlRpcValue& value);
+
+  private:
+    std::string _path;
+    FILE* _file;
+    size_t _size;
+  };
+
+} // namespace XmlRpc
+
+#endif // _XMLRPCBINARYSINK_H_
@@ -165,7 +165,7 @@ XmlRpcClient::setupConnection()
 bool 
 XmlRpcClient::doConnect()
 {
-  int fd = XmlRpcSocket::socket();
+  int fd = XmlRpcSocket::socket(_host);
   if (fd < 0)
   {
     XmlRpcUtil::error("Error in XmlRpcClient::doConnect: Could not create socket (%s).", XmlRpcSocket::getErrorMsg().c_str());
@@ -183,6 +183,10 @@ XmlRpcClient::doConnect()
     return false;
   }
 
+  // Requests are written whole; do not hold back the tail of a large one
+  if ( ! XmlRpcSocket::isUnixHost(_host))
+    XmlRpcSocket::setNoDelay(fd, true);
+
   if ( ! XmlRpcSocket::connect(fd, _host, _port))
   {
     this->close();
@@ -240,13 +244,10 @@ XmlRpcClient::generateHeader(std::string const& body)
     "User-Agent: ";
   header += XMLRPC_VERSION;
   header += "\r\nHost: ";
-  header += _host;
+  header += XmlRpcSocket::hostHeader(_host, _port);
 
   char buff[40];
-  sprintf(buff,":%d\r\n", _port);
-
-  header += buff;
-  header += "Content-Type: text/xml\r\nContent-length: ";
+  header += "\r\nContent-Type: text/xml\r\nContent-length: ";
 
   sprintf(buff,"%lu\r\n\r\n", body.size());
 
@@ -68,6 +68,19 @@ XmlRpcDispatch::setSourceEvents(XmlRpcSource* source, unsigned eventMask)
 }
 
 
+// Deliver a TimeoutEvent to this source after msTimeout milliseconds
+void
+XmlRpcDispatch::setSourceTimeout(XmlRpcSource* source, double msTimeout)
+{
+  for (SourceList::iterator it=_sources.begin(); it!=_sources.end(); ++it)
+    if (it->getSource() == source)
+    {
+      it->getDeadline() = (msTimeout < 0.0) ? -1.0 : (getTime() + msTimeout / 1000.0);
+      break;
+    }
+}
+
+
 
 // Watch current set of sources and process events
 void
@@ -88,6 +101,7 @@ XmlRpcDispatch::work(double timeout)
 	  FD_ZERO(&excFd);
 
     int maxFd = -1;     // Not used on windows
+    double nextDeadline = -1.0;
     SourceList::iterator it;
     for (it=_sources.begin(); it!=_sources.end(); ++it) {
       int fd = it->getSource()->getfd();
@@ -95,17 +109,29 @@ XmlRpcDispatch::work(double timeout)
       if (it->getMask() & WritableEvent) FD_SET(fd, &outFd);
       if (it->getMask() & Exception)     FD_SET(fd, &excFd);
       if (it->getMask() && fd > maxFd)   maxFd = fd;
+      if (it->getDeadline() >= 0.0 && (nextDeadline < 0.0 || it->getDeadline() < nextDeadline))
+        nextDeadline = it->getDeadline();
+    }
+
+    // Don't sleep past the earliest source deadline
+    double waitTime = timeout;
+    if (nextDeadline >= 0.0)
+    {
+      double untilDeadline = nextDeadline - getTime();
+      if (untilDeadline < 0.0) untilDeadline = 0.0;
+      if (waitTime < 0.0 || untilDeadline < waitTime)
+        waitTime = untilDeadline;
     }
 
     // Check for events
     int nEvents;
-    if (timeout < 0.0)
+    if (waitTime < 0.0)
       nEvents = select(maxFd+1, &inFd, &outFd, &excFd, NULL);
     else 
     {
       struct timeval tv;
-      tv.tv_sec = (int)floor(timeout);
-      tv.tv_usec = ((int)floor(1000000.0 * (timeout-floor(timeout)))) % 1000000;
+      tv.tv_sec = (int)floor(waitTime);
+      tv.tv_usec = ((int)floor(1000000.0 * (waitTime-floor(waitTime)))) % 1000000;
       nEvents = select(maxFd+1, &inFd, &outFd, &excFd, &tv);
     }
 
@@ -117,6 +143,7 @@ XmlRpcDispatch::work(double timeout)
     }
 
     // Process events
+    double now = (nextDeadline >= 0.0) ? getTime() : 0.0;
     for (it=_sources.begin(); it != _sources.end(); )
     {
       SourceList::iterator thisIt = it++;
@@ -131,6 +158,10 @@ XmlRpcDispatch::work(double timeout)
           newMask &= src->handleEvent(WritableEvent);
         if (FD_ISSET(fd, &excFd))
           newMask &= src->handleEvent(Exception);
+        if (thisIt->getDeadline() >= 0.0 && thisIt->getDeadline() <= now) {
+          thisIt->getDeadline() = -1.0;
+          newMask &= src->handleEvent(TimeoutEvent);
+        }
 
         if ( ! newMask) {
           _sources.erase(thisIt);  // Stop monitoring this one
@@ -29,7 +29,8 @@ namespace XmlRpc {
     enum EventType {
       ReadableEvent = 1,    //!< data available to read
       WritableEvent = 2,    //!< connected/data can be written without blocking
-      Exception     = 4     //!< uh oh
+      Exception     = 4,    //!< uh oh
+      TimeoutEvent  = 8     //!< the deadline set with setSourceTimeout passed
     };
     
     //! Monitor this source for the event types specified by the event mask
@@ -45,6 +46,10 @@ namespace XmlRpc {
     //! Modify the types of events to watch for on this source
     void setSourceEvents(XmlRpcSource* source, unsigned eventMask);
 
+    //! Deliver a TimeoutEvent to this source once msTimeout milliseconds have
+    //! elapsed, even if no IO happens on it. A negative timeout cancels it.
+    void setSourceTimeout(XmlRpcSource* source, double msTimeout);
+
 
     //! Watch current set of sources and process events for the specified
     //! duration (in ms, -1 implies wait forever, or until exit is called)
@@ -63,11 +68,13 @@ namespace XmlRpc {
 
     // A source to monitor and what to monitor it for
     struct MonitoredSource {
-      MonitoredSource(XmlRpcSource* src, unsigned mask) : _src(src), _mask(mask) {}
+      MonitoredSource(XmlRpcSource* src, unsigned mask) : _src(src), _mask(mask), _deadline(-1.0) {}
       XmlRpcSource* getSource() const { return _src; }
       unsigned& getMask() { return _mask; }
+      double& getDeadline() { return _deadline; }
       XmlRpcSource* _src;
       unsigned _mask;
+      double _deadline;     // absolute time for a TimeoutEvent, -1 if none
     };
 
     // A list of sources to monitor
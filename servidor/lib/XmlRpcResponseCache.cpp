@@ -0,0 +1,89 @@
+
+#include "XmlRpcResponseCache.h"
+#include "XmlRpcUtil.h"
+
+using namespace XmlRpc;
+
+
+XmlRpcResponseCache::XmlRpcResponseCache(int maxEntries /*= 64*/)
+{
+  _maxEntries = (maxEntries < 0) ? 0 : maxEntries;
+  _hits = 0;
+  _misses = 0;
+}
+
+
+// The method name cannot contain a NUL, so it safely separates the two parts
+std::string
+XmlRpcResponseCache::makeKey(std::string const& methodName, std::string const& paramsXml)
+{
+  std::string key;
+  key.reserve(methodName.size() + 1 + paramsXml.size());
+  key += methodName;
+  key += '\0';
+  key += paramsXml;
+  return key;
+}
+
+
+bool
+XmlRpcResponseCache::find(std::string const& key, std::string& response)
+{
+  EntryIndex::iterator it = _index.find(key);
+  if (it == _index.end()) {
+    ++_misses;
+    return false;
+  }
+
+  // Move to the front of the LRU list
+  _entries.splice(_entries.begin(), _entries, it->second);
+  response = it->second->second;
+  ++_hits;
+  return true;
+}
+
+
+void
+XmlRpcResponseCache::insert(std::string const& key, std::string const& response)
+{
+  if (_maxEntries == 0) return;
+
+  EntryIndex::iterator it = _index.find(key);
+  if (it != _index.end()) {
+    it->second->second = response;
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return;
+  }
+
+  _entries.push_front(Entry(key, response));
+  _index[key] = _entries.begin();
+  evict();
+  XmlRpcUtil::log(4, "XmlRpcResponseCache::insert: %d of %d entries used.", size(), _maxEntries);
+}
+
+
+void
+XmlRpcResponseCache::clear()
+{
+  _index.clear();
+  _entries.clear();
+}
+
+
+void
+XmlRpcResponseCache::setMaxEntries(int maxEntries)
+{
+  _maxEntries = (maxEntries < 0) ? 0 : maxEntries;
+  evict();
+}
+
+
+// Drop least recently used entries until we fit
+void
+XmlRpcResponseCache::evict()
+{
+  while (int(_entries.size()) > _maxEntries) {
+    _index.erase(_entries.back().first);
+    _entries.pop_back();
+  }
+}
@@ -0,0 +1,66 @@
+
+#ifndef _XMLRPCRESPONSECACHE_H_
+#define _XMLRPCRESPONSECACHE_H_
+//
+// XmlRpc++ Copyright (c) 2002-2003 by Chris Morley
+//
+#if defined(_MSC_VER)
+# pragma warning(disable:4786)    // identifier was truncated in debug info
+#endif
+
+#ifndef MAKEDEPEND
+# include <list>
+# include <string>
+# include <unordered_map>
+#endif
+
+namespace XmlRpc {
+
+  //! A bounded LRU cache of complete HTTP responses (header + body), keyed by
+  //! method name and the raw xml of the call parameters. Used by the server to
+  //! answer calls to cacheable methods without executing or serializing anything.
+  class XmlRpcResponseCache {
+  public:
+    //! Create a cache holding at most maxEntries responses (0 disables caching)
+    XmlRpcResponseCache(int maxEntries = 64);
+
+    //! Build the lookup key for a call to methodName with the given raw params xml
+    static std::string makeKey(std::string const& methodName, std::string const& paramsXml);
+
+    //! Copy the cached response for key into response. Returns false on a miss.
+    bool find(std::string const& key, std::string& response);
+
+    //! Store (or refresh) the response for key, evicting the least recently used entry if full
+    void insert(std::string const& key, std::string const& response);
+
+    //! Drop all cached responses
+    void clear();
+
+    //! Change the capacity, evicting entries if needed. 0 disables caching.
+    void setMaxEntries(int maxEntries);
+    int getMaxEntries() const { return _maxEntries; }
+
+    //! Number of cached responses
+    int size() const { return int(_entries.size()); }
+
+    //! Hit/miss counters since construction
+    unsigned long getHits() const { return _hits; }
+    unsigned long getMisses() const { return _misses; }
+
+  protected:
+    void evict();
+
+    typedef std::pair<std::string, std::string> Entry;    // key, response bytes
+    typedef std::list<Entry> EntryList;                   // most recently used first
+    typedef std::unordered_map<std::string, EntryList::iterator> EntryIndex;
+
+    EntryList _entries;
+    EntryIndex _index;
+    int _maxEntries;
+    unsigned long _hits;
+    unsigned long _misses;
+  };
+
+} // namespace XmlRpc
+
+#endif // _XMLRPCRESPONSECACHE_H_
@@ -6,6 +6,15 @@
 #include "XmlRpcUtil.h"
 #include "XmlRpcException.h"
 
+#ifndef MAKEDEPEND
+# if defined(_WINDOWS)
+#  include <io.h>
+#  define unlink _unlink
+# else
+#  include <unistd.h>
+# endif
+#endif
+
 
 using namespace XmlRpc;
 
@@ -15,6 +24,14 @@ XmlRpcServer::XmlRpcServer()
   _introspectionEnabled = false;
   _listMethods = 0;
   _methodHelp = 0;
+  _noDelay = true;
+  _keepAlive = true;
+  _sendBufferSize = 0;
+  _receiveBufferSize = 0;
+  _maxHeaderSize = 16 * 1024;
+  _maxRequestSize = 64 * 1024 * 1024;
+  _streamThreshold = 64 * 1024;
+  _wakeupFd = -1;
 }
 
 
@@ -32,6 +49,7 @@ void
 XmlRpcServer::addMethod(XmlRpcServerMethod* method)
 {
   _methods[method->name()] = method;
+  _responseCache.clear();
 }
 
 // Remove a command from the RPC server
@@ -41,6 +59,7 @@ XmlRpcServer::removeMethod(XmlRpcServerMethod* method)
   MethodMap::iterator i = _methods.find(method->name());
   if (i != _methods.end())
     _methods.erase(i);
+  _responseCache.clear();
 }
 
 // Remove a command from the RPC server by name
@@ -50,6 +69,7 @@ XmlRpcServer::removeMethod(const std::string& methodName)
   MethodMap::iterator i = _methods.find(methodName);
   if (i != _methods.end())
     _methods.erase(i);
+  _responseCache.clear();
 }
 
 
@@ -64,10 +84,18 @@ XmlRpcServer::findMethod(const std::string& name) const
 }
 
 
+// Specify how many responses to keep in the cache (0 disables caching)
+void
+XmlRpcServer::setResponseCacheSize(int maxEntries)
+{
+  _responseCache.setMaxEntries(maxEntries);
+}
+
+
 // Create a socket, bind to the specified port, and
 // set it in listen mode to make it available for clients.
 bool 
-XmlRpcServer::bindAndListen(int port, int backlog /*= 5*/)
+XmlRpcServer::bindAndListen(int port, int backlog /*= 128*/)
 {
   int fd = XmlRpcSocket::socket();
   if (fd < 0)
@@ -110,15 +138,132 @@ XmlRpcServer::bindAndListen(int port, int backlog /*= 5*/)
     return false;
   }
 
-  XmlRpcUtil::log(2, "XmlRpcServer::bindAndListen: server listening on port %d fd %d", port, fd);
+  XmlRpcUtil::log(2, "XmlRpcServer::bindAndListen: server listening on port %d fd %d backlog %d", port, fd, backlog);
 
   // Notify the dispatcher to listen on this source when we are in work()
   _disp.addSource(this, XmlRpcDispatch::ReadableEvent);
 
+  if ( ! createWakeup())
+    XmlRpcUtil::error("XmlRpcServer::bindAndListen: Could not create wakeup socket (%s).", XmlRpcSocket::getErrorMsg().c_str());
+
+  return true;
+}
+
+
+// An address the server listens on besides its own socket (see listenOn)
+class ListenerSource : public XmlRpcSource
+{
+public:
+  ListenerSource(int fd, XmlRpcServer* server, bool tcp)
+    : XmlRpcSource(fd, true), _server(server), _tcp(tcp) {}
+
+  unsigned handleEvent(unsigned /*eventType*/)
+  {
+    _server->acceptConnections(getfd(), _tcp);
+    return XmlRpcDispatch::ReadableEvent;
+  }
+
+private:
+  XmlRpcServer* _server;
+  bool _tcp;
+};
+
+
+bool
+XmlRpcServer::listenOn(std::string const& host, int port, int backlog /*= 128*/)
+{
+  int fd = XmlRpcSocket::socket(host);
+  if (fd < 0)
+  {
+    XmlRpcUtil::error("XmlRpcServer::listenOn: Could not create socket for %s (%s).", host.c_str(), XmlRpcSocket::getErrorMsg().c_str());
+    return false;
+  }
+
+  bool tcp = ! XmlRpcSocket::isUnixHost(host);
+  if ( ! XmlRpcSocket::setNonBlocking(fd) || (tcp && ! XmlRpcSocket::setReuseAddr(fd)))
+  {
+    XmlRpcUtil::error("XmlRpcServer::listenOn: Could not set socket options for %s (%s).", host.c_str(), XmlRpcSocket::getErrorMsg().c_str());
+    XmlRpcSocket::close(fd);
+    return false;
+  }
+
+  if ( ! XmlRpcSocket::bind(fd, host, port))
+  {
+    XmlRpcUtil::error("XmlRpcServer::listenOn: Could not bind to %s port %d (%s).", host.c_str(), port, XmlRpcSocket::getErrorMsg().c_str());
+    XmlRpcSocket::close(fd);
+    return false;
+  }
+
+  if ( ! XmlRpcSocket::listen(fd, backlog))
+  {
+    XmlRpcUtil::error("XmlRpcServer::listenOn: Could not set socket in listening mode (%s).", XmlRpcSocket::getErrorMsg().c_str());
+    XmlRpcSocket::close(fd);
+    return false;
+  }
+
+  XmlRpcUtil::log(2, "XmlRpcServer::listenOn: server listening on %s port %d fd %d", host.c_str(), port, fd);
+  ListenerSource* listener = new ListenerSource(fd, this, tcp);
+  _listeners.push_back(listener);
+  _disp.addSource(listener, XmlRpcDispatch::ReadableEvent);
+  if ( ! tcp)
+    _unixSocketPaths.push_back(host.compare(0, 5, "unix:") == 0 ? host.substr(5) : host);
+
+  if ( ! createWakeup())
+    XmlRpcUtil::error("XmlRpcServer::listenOn: Could not create wakeup socket (%s).", XmlRpcSocket::getErrorMsg().c_str());
+
+  return true;
+}
+
+
+// Drains the wakeup socket and re-checks the parked calls
+class WakeupSource : public XmlRpcSource
+{
+public:
+  WakeupSource(int fd, XmlRpcServer* server) : XmlRpcSource(fd, true), _server(server) {}
+
+  unsigned handleEvent(unsigned /*eventType*/)
+  {
+    std::string drained;
+    bool eof;
+    if ( ! XmlRpcSocket::nbRead(getfd(), drained, &eof) || eof)
+      return 0;
+    _server->notifyWaiting();
+    return XmlRpcDispatch::ReadableEvent;
+  }
+
+private:
+  XmlRpcServer* _server;
+};
+
+
+// Create the socket pair used by wakeup() and monitor its read end
+bool
+XmlRpcServer::createWakeup()
+{
+  std::lock_guard<std::mutex> lock(_wakeupMutex);
+  if (_wakeupFd >= 0)
+    return true;
+
+  int fds[2];
+  if ( ! XmlRpcSocket::socketPair(fds))
+    return false;
+
+  _wakeupFd = fds[1];
+  _disp.addSource(new WakeupSource(fds[0], this), XmlRpcDispatch::ReadableEvent);
   return true;
 }
 
 
+// Safe to call from any thread
+void
+XmlRpcServer::wakeup()
+{
+  std::lock_guard<std::mutex> lock(_wakeupMutex);
+  if (_wakeupFd >= 0)
+    XmlRpcSocket::sendByte(_wakeupFd);
+}
+
+
 // Process client requests for the specified time
 void 
 XmlRpcServer::work(double msTime)
@@ -139,31 +284,59 @@ XmlRpcServer::handleEvent(unsigned mask)
 }
 
 
-// Accept a client connection request and create a connection to
-// handle method calls from the client.
+// Most connections accepted per readable event, so a storm of connection
+// requests cannot keep the dispatcher from serving the established ones
+static const int MAX_ACCEPTS_PER_EVENT = 64;
+
+// Accept the pending client connection requests on the server socket
 void
 XmlRpcServer::acceptConnection()
 {
-  int s = XmlRpcSocket::accept(this->getfd());
-  XmlRpcUtil::log(2, "XmlRpcServer::acceptConnection: socket %d", s);
-  if (s < 0)
-  {
-    //this->close();
-    XmlRpcUtil::error("XmlRpcServer::acceptConnection: Could not accept connection (%s).", XmlRpcSocket::getErrorMsg().c_str());
-  }
-  else if ( ! XmlRpcSocket::setNonBlocking(s))
-  {
-    XmlRpcSocket::close(s);
-    XmlRpcUtil::error("XmlRpcServer::acceptConnection: Could not set socket to non-blocking input mode (%s).", XmlRpcSocket::getErrorMsg().c_str());
-  }
-  else  // Notify the dispatcher to listen for input on this source when we are in work()
+  acceptConnections(this->getfd(), true);
+}
+
+
+// Accept the pending client connection requests and create a connection
+// to handle method calls from each client.
+void
+XmlRpcServer::acceptConnections(int listenFd, bool tcp)
+{
+  for (int i = 0; i < MAX_ACCEPTS_PER_EVENT; ++i)
   {
+    int s = XmlRpcSocket::acceptNonBlocking(listenFd);
+    if (s < 0)
+    {
+      if ( ! XmlRpcSocket::nonFatalError())
+        XmlRpcUtil::error("XmlRpcServer::acceptConnection: Could not accept connection (%s).", XmlRpcSocket::getErrorMsg().c_str());
+      break;
+    }
+
+    XmlRpcUtil::log(2, "XmlRpcServer::acceptConnection: socket %d", s);
+    if (tcp)
+      setConnectionOptions(s);
+
+    // Notify the dispatcher to listen for input on this source when we are in work()
     XmlRpcUtil::log(2, "XmlRpcServer::acceptConnection: creating a connection");
-    _disp.addSource(this->createConnection(s), XmlRpcDispatch::ReadableEvent);
+    XmlRpcServerConnection* sc = this->createConnection(s);
+    _connections.insert(sc);
+    _disp.addSource(sc, XmlRpcDispatch::ReadableEvent);
   }
 }
 
 
+// Failing to set an option is not a reason to drop the client
+void
+XmlRpcServer::setConnectionOptions(int s)
+{
+  if (_noDelay && ! XmlRpcSocket::setNoDelay(s, true))
+    XmlRpcUtil::log(1, "XmlRpcServer::setConnectionOptions: Could not set TCP_NODELAY (%s).", XmlRpcSocket::getErrorMsg().c_str());
+  if (_keepAlive && ! XmlRpcSocket::setKeepAlive(s, true))
+    XmlRpcUtil::log(1, "XmlRpcServer::setConnectionOptions: Could not set SO_KEEPALIVE (%s).", XmlRpcSocket::getErrorMsg().c_str());
+  if ( ! XmlRpcSocket::setBufferSizes(s, _sendBufferSize, _receiveBufferSize))
+    XmlRpcUtil::log(1, "XmlRpcServer::setConnectionOptions: Could not set socket buffer sizes (%s).", XmlRpcSocket::getErrorMsg().c_str());
+}
+
+
 // Create a new connection object for processing requests from a specific client.
 XmlRpcServerConnection*
 XmlRpcServer::createConnection(int s)
@@ -176,10 +349,143 @@ XmlRpcServer::createConnection(int s)
 void 
 XmlRpcServer::removeConnection(XmlRpcServerConnection* sc)
 {
+  _connections.erase(sc);
+  _waiting.remove(sc);
   _disp.removeSource(sc);
 }
 
 
+// Park a connection whose call must wait. The dispatcher delivers a
+// TimeoutEvent to it if nothing wakes it up first.
+void
+XmlRpcServer::addWaiting(XmlRpcServerConnection* sc, double msTimeout)
+{
+  _waiting.push_back(sc);
+  _disp.setSourceTimeout(sc, msTimeout);
+}
+
+
+// The parked connection has its response, stop waiting and write it out
+void
+XmlRpcServer::resumeWaiting(XmlRpcServerConnection* sc)
+{
+  _waiting.remove(sc);
+  _disp.setSourceTimeout(sc, -1.0);
+  _disp.setSourceEvents(sc, XmlRpcDispatch::WritableEvent);
+}
+
+
+// Re-check parked long-poll calls
+void
+XmlRpcServer::notifyWaiting()
+{
+  // Resuming removes the connection from _waiting, so iterate over a copy
+  ConnectionList waiting = _waiting;
+  for (ConnectionList::iterator it = waiting.begin(); it != waiting.end(); ++it)
+    (*it)->checkWait();
+}
+
+
+// Stop accepting connections, leaving the listening sockets open for another process
+std::vector<int>
+XmlRpcServer::detachListeners()
+{
+  std::vector<int> fds;
+  if (this->getfd() >= 0)
+  {
+    _disp.removeSource(this);
+    fds.push_back(this->getfd());
+    this->setfd(-1);
+  }
+
+  for (size_t i = 0; i < _listeners.size(); ++i)
+  {
+    XmlRpcSource* listener = _listeners[i];
+    _disp.removeSource(listener);
+    fds.push_back(listener->getfd());
+    listener->setfd(-1);
+    listener->close();      // Deletes it
+  }
+  _listeners.clear();
+
+  // The socket files now belong to whoever takes the sockets
+  _unixSocketPaths.clear();
+
+  XmlRpcUtil::log(2, "XmlRpcServer::detachListeners: %d listening sockets detached", int(fds.size()));
+  return fds;
+}
+
+
+// Listen on an inherited socket. A unix domain socket keeps its file until shutdown.
+bool
+XmlRpcServer::adoptListener(int fd)
+{
+  if ( ! XmlRpcSocket::setNonBlocking(fd))
+  {
+    XmlRpcUtil::error("XmlRpcServer::adoptListener: Could not set socket %d to non-blocking mode (%s).", fd, XmlRpcSocket::getErrorMsg().c_str());
+    return false;
+  }
+
+  std::string path;
+  bool tcp = ! XmlRpcSocket::getUnixPath(fd, path);
+  if (tcp && this->getfd() < 0)
+  {
+    this->setfd(fd);
+    _disp.addSource(this, XmlRpcDispatch::ReadableEvent);
+  }
+  else
+  {
+    ListenerSource* listener = new ListenerSource(fd, this, tcp);
+    _listeners.push_back(listener);
+    _disp.addSource(listener, XmlRpcDispatch::ReadableEvent);
+    if ( ! tcp && ! path.empty())
+      _unixSocketPaths.push_back(path);
+  }
+  XmlRpcUtil::log(2, "XmlRpcServer::adoptListener: listening on inherited socket %d %s", fd, path.c_str());
+
+  if ( ! createWakeup())
+    XmlRpcUtil::error("XmlRpcServer::adoptListener: Could not create wakeup socket (%s).", XmlRpcSocket::getErrorMsg().c_str());
+
+  return true;
+}
+
+
+// Connections between requests can be handed over without the client noticing:
+// whatever it sends next is still queued in the (shared) socket
+std::vector<int>
+XmlRpcServer::detachIdleConnections()
+{
+  std::vector<int> fds;
+
+  // Deleting a connection removes it from _connections, so iterate over a copy
+  ConnectionSet connections = _connections;
+  for (ConnectionSet::iterator it = connections.begin(); it != connections.end(); ++it)
+  {
+    XmlRpcServerConnection* sc = *it;
+    if ( ! sc->isIdle())
+      continue;
+    _disp.removeSource(sc);
+    fds.push_back(sc->getfd());
+    sc->setfd(-1);
+    sc->close();            // Deletes it without closing the socket
+  }
+  return fds;
+}
+
+
+void
+XmlRpcServer::adoptConnection(int fd)
+{
+  if ( ! XmlRpcSocket::setNonBlocking(fd))
+    XmlRpcUtil::log(1, "XmlRpcServer::adoptConnection: Could not set socket %d to non-blocking mode (%s).", fd, XmlRpcSocket::getErrorMsg().c_str());
+
+  XmlRpcUtil::log(2, "XmlRpcServer::adoptConnection: socket %d", fd);
+  XmlRpcServerConnection* sc = this->createConnection(fd);
+  _connections.insert(sc);
+  _disp.addSource(sc, XmlRpcDispatch::ReadableEvent);
+}
+
+
 // Stop processing client requests
 void 
 XmlRpcServer::exit()
@@ -194,6 +500,17 @@ XmlRpcServer::shutdown()
 {
   // This closes and destroys all connections as well as closing this socket
   _disp.clear();
+  _listeners.clear();
+
+  // Remove the socket files now, the dispatcher may only close the sockets later
+  for (size_t i = 0; i < _unixSocketPaths.size(); ++i)
+    unlink(_unixSocketPaths[i].c_str());
+  _unixSocketPaths.clear();
+
+  std::lock_guard<std::mutex> lock(_wakeupMutex);
+  if (_wakeupFd >= 0)
+    XmlRpcSocket::close(_wakeupFd);
+  _wakeupFd = -1;
 }
 
 
@@ -215,6 +532,8 @@ public:
   }
 
   std::string help() { return std::string("List all methods available on a server as an array of strings"); }
+
+  bool isCacheable() { return true; }
 };
 
 
@@ -237,6 +556,8 @@ public:
   }
 
   std::string help() { return std::string("Retrieve the help string for a named method"); }
+
+  bool isCacheable() { return true; }
 };
 
     
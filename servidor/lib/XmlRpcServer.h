@@ -9,11 +9,16 @@
 #endif
 
 #ifndef MAKEDEPEND
+# include <list>
 # include <map>
+# include <mutex>
+# include <set>
 # include <string>
+# include <vector>
 #endif
 
 #include "XmlRpcDispatch.h"
+#include "XmlRpcResponseCache.h"
 #include "XmlRpcSource.h"
 
 namespace XmlRpc {
@@ -54,7 +59,37 @@ namespace XmlRpc {
 
     //! Create a socket, bind to the specified port, and
     //! set it in listen mode to make it available for clients.
-    bool bindAndListen(int port, int backlog = 5);
+    //! backlog is the number of connection requests the system queues before refusing them.
+    bool bindAndListen(int port, int backlog = 128);
+
+    //! Also listen on host:port, in addition to (or instead of) bindAndListen. host may
+    //! be "unix:/path" for a unix domain socket (port is ignored), an IPv6 literal
+    //! ("::" for every interface) or an IPv4 address. Can be called several times.
+    bool listenOn(std::string const& host, int port, int backlog = 128);
+
+    //! Disable Nagle's algorithm on client connections so small responses are sent at once (default true)
+    void setNoDelay(bool on) { _noDelay = on; }
+
+    //! Enable TCP keepalive probes on client connections, to notice dead clients (default true)
+    void setKeepAlive(bool on) { _keepAlive = on; }
+
+    //! Kernel send and receive buffer sizes for client connections (0, the default, keeps the system's)
+    void setSocketBufferSizes(int sendBytes, int receiveBytes) { _sendBufferSize = sendBytes; _receiveBufferSize = receiveBytes; }
+
+    //! Largest request header accepted in bytes; larger ones are answered with 431 (default 16 KiB)
+    void setMaxHeaderSize(int bytes) { _maxHeaderSize = bytes; }
+    int getMaxHeaderSize() const { return _maxHeaderSize; }
+
+    //! Largest request body accepted in bytes. A larger Content-length is answered
+    //! with 413 before any of the body is read (default 64 MiB).
+    void setMaxRequestSize(int bytes) { _maxRequestSize = bytes; }
+    int getMaxRequestSize() const { return _maxRequestSize; }
+
+    //! Base64 parameters longer than this many characters are decoded while they
+    //! arrive instead of being buffered (see XmlRpcServerMethod::createBinarySink).
+    //! Default 64 KiB, 0 never streams.
+    void setStreamThreshold(int bytes) { _streamThreshold = bytes; }
+    int getStreamThreshold() const { return _streamThreshold; }
 
     //! Process client requests for the specified time
     void work(double msTime);
@@ -68,6 +103,12 @@ namespace XmlRpc {
     //! Introspection support
     void listMethods(XmlRpcValue& result);
 
+    //! Cache of complete responses for methods that declare themselves cacheable
+    XmlRpcResponseCache& getResponseCache() { return _responseCache; }
+
+    //! Specify how many responses to keep in the cache (0 disables caching)
+    void setResponseCacheSize(int maxEntries);
+
     // XmlRpcSource interface implementation
 
     //! Handle client connection requests
@@ -76,20 +117,76 @@ namespace XmlRpc {
     //! Remove a connection from the dispatcher
     virtual void removeConnection(XmlRpcServerConnection*);
 
+    //! Park a connection whose call must wait, for at most msTimeout milliseconds
+    void addWaiting(XmlRpcServerConnection* sc, double msTimeout);
+
+    //! Resume a parked connection whose response is ready to be written
+    void resumeWaiting(XmlRpcServerConnection* sc);
+
+    //! Re-check all parked long-poll calls and answer those that no longer need
+    //! to wait. Called after every executed request; call it yourself if state
+    //! changes outside of an RPC.
+    void notifyWaiting();
+
+    //! Make the server thread run notifyWaiting() as soon as possible. Unlike
+    //! everything else in this class, it is safe to call from any thread.
+    void wakeup();
+
+    //! Accept the connection requests pending on a listening socket. tcp tells
+    //! whether the TCP socket options apply.
+    void acceptConnections(int listenFd, bool tcp);
+
+    //! Monitor another source (e.g. a control socket) while in work()
+    void addSource(XmlRpcSource* source, unsigned eventMask) { _disp.addSource(source, eventMask); }
+
+    //! Stop monitoring a source added with addSource. Does not close it.
+    void removeSource(XmlRpcSource* source) { _disp.removeSource(source); }
+
+    // Hot restart: another process takes over the listening sockets and the idle
+    // client connections, so a restart neither refuses nor drops clients.
+
+    //! Stop accepting connections and return the listening sockets, still open.
+    //! Their unix socket files are no longer removed on shutdown. Call it outside of work().
+    std::vector<int> detachListeners();
+
+    //! Listen on a socket inherited from another process (see detachListeners).
+    //! The first one becomes the server socket.
+    bool adoptListener(int fd);
+
+    //! Stop serving the connections that are between requests and return their
+    //! sockets, still open. Call it outside of work().
+    std::vector<int> detachIdleConnections();
+
+    //! Serve a client connection inherited from another process
+    void adoptConnection(int fd);
+
+    //! Number of client connections being served
+    int getConnectionCount() const { return int(_connections.size()); }
+
   protected:
 
-    //! Accept a client connection request
+    //! Accept the pending client connection requests
     virtual void acceptConnection();
 
+    //! Apply the configured socket options to an accepted connection
+    virtual void setConnectionOptions(int socket);
+
     //! Create a new connection object for processing requests from a specific client.
     virtual XmlRpcServerConnection* createConnection(int socket);
 
+    //! Create the socket pair used by wakeup() and monitor its read end
+    bool createWakeup();
+
     // Whether the introspection API is supported by this server
     bool _introspectionEnabled;
 
     // Event dispatcher
     XmlRpcDispatch _disp;
 
+    // Connections parked on a long-poll call (see XmlRpcServerMethod::mustWait)
+    typedef std::list< XmlRpcServerConnection* > ConnectionList;
+    ConnectionList _waiting;
+
     // Collection of methods. This could be a set keyed on method name if we wanted...
     typedef std::map< std::string, XmlRpcServerMethod* > MethodMap;
     MethodMap _methods;
@@ -98,6 +195,34 @@ namespace XmlRpc {
     XmlRpcServerMethod* _listMethods;
     XmlRpcServerMethod* _methodHelp;
 
+    // Serialized responses of cacheable methods. Cleared whenever the method set changes.
+    XmlRpcResponseCache _responseCache;
+
+    // Options for accepted sockets
+    bool _noDelay;
+    bool _keepAlive;
+    int _sendBufferSize;
+    int _receiveBufferSize;
+
+    // Request size limits
+    int _maxHeaderSize;
+    int _maxRequestSize;
+    int _streamThreshold;
+
+    // Client connections being served
+    typedef std::set< XmlRpcServerConnection* > ConnectionSet;
+    ConnectionSet _connections;
+
+    // Listening sockets besides this one (see listenOn)
+    std::vector<XmlRpcSource*> _listeners;
+
+    // Socket files of the unix domain listeners, removed on shutdown
+    std::vector<std::string> _unixSocketPaths;
+
+    // Write end of the socket pair used by wakeup(); the read end is a dispatcher source
+    int _wakeupFd;
+    std::mutex _wakeupMutex;
+
   };
 } // namespace XmlRpc
 
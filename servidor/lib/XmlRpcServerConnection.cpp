@@ -2,9 +2,11 @@
 #include "XmlRpcServerConnection.h"
 
 #include "XmlRpcSocket.h"
+#include "XmlRpcBinarySink.h"
 #include "XmlRpc.h"
 
 #ifndef MAKEDEPEND
+# include <algorithm>
 # include <stdio.h>
 # include <stdlib.h>
 #include <strings.h>
@@ -28,6 +30,17 @@ const std::string XmlRpcServerConnection::PARAMS = "params";
 const std::string XmlRpcServerConnection::FAULTCODE = "faultCode";
 const std::string XmlRpcServerConnection::FAULTSTRING = "faultString";
 
+// A streamed base64 value is replaced in the request by a string holding this
+// character and its index, and put back after parsing. Where the markers were
+// written is kept apart (_streamedAt), so a client string cannot pose as one.
+static const char STREAMED_MARK = '\x01';
+static const char BASE64_TAG[] = "<base64>";
+static const char BASE64_ETAG[] = "</base64>";
+
+// While streaming, the body is read in pieces of this size so that a value is
+// decoded before the next piece is buffered
+static const size_t STREAM_READ_SIZE = 64 * 1024;
+
 
 
 // The server delegates handling client requests to a serverConnection object.
@@ -38,12 +51,19 @@ XmlRpcServerConnection::XmlRpcServerConnection(int fd, XmlRpcServer* server, boo
   _server = server;
   _connectionState = READ_HEADER;
   _keepAlive = true;
+  _bodyRemoved = 0;
+  _scanOffset = 0;
+  _base64Tag = _base64Start = std::string::npos;
+  _streaming = false;
+  _sink = 0;
+  _methodSink = false;
 }
 
 
 XmlRpcServerConnection::~XmlRpcServerConnection()
 {
   XmlRpcUtil::log(4,"XmlRpcServerConnection dtor.");
+  delete _sink;
   _server->removeConnection(this);
 }
 
@@ -52,17 +72,33 @@ XmlRpcServerConnection::~XmlRpcServerConnection()
 // and reading the rpc request. Return true to continue to monitor
 // the socket for events, false to remove it from the dispatcher.
 unsigned
-XmlRpcServerConnection::handleEvent(unsigned /*eventType*/)
+XmlRpcServerConnection::handleEvent(unsigned eventType)
 {
-  if (_connectionState == READ_HEADER)
-    if ( ! readHeader()) return 0;
+  // A parked long-poll call ran out of time: answer it with the current state
+  if (_connectionState == WAIT_EVENT && eventType == XmlRpcDispatch::TimeoutEvent)
+    finishWait();
 
-  if (_connectionState == READ_REQUEST)
-    if ( ! readRequest()) return 0;
+  for (;;) {
+    if (_connectionState == READ_HEADER)
+      if ( ! readHeader()) return 0;
 
-  if (_connectionState == WRITE_RESPONSE)
+    if (_connectionState == READ_REQUEST)
+      if ( ! readRequest()) return 0;
+
+    if (_connectionState != WRITE_RESPONSE)
+      break;
     if ( ! writeResponse()) return 0;
 
+    // Requests pipelined behind the one just answered are already buffered,
+    // so there may be no further readable event for them
+    if (_connectionState != READ_HEADER || _header.length() == 0)
+      break;
+  }
+
+  // Parked connections are not monitored for IO until they are resumed
+  if (_connectionState == WAIT_EVENT)
+    return XmlRpcDispatch::TimeoutEvent;
+
   return (_connectionState == WRITE_RESPONSE) 
         ? XmlRpcDispatch::WritableEvent : XmlRpcDispatch::ReadableEvent;
 }
@@ -72,8 +108,10 @@ bool
 XmlRpcServerConnection::readHeader()
 {
   // Read available data
+  // Reading no more than the header limit at a time leaves a large body in the
+  // socket until readRequest can stream it
   bool eof;
-  if ( ! XmlRpcSocket::nbRead(this->getfd(), _header, &eof)) {
+  if ( ! XmlRpcSocket::nbRead(this->getfd(), _header, &eof, size_t(_server->getMaxHeaderSize()) + 1)) {
     // Its only an error if we already have read some data
     if (_header.length() > 0)
       XmlRpcUtil::error("XmlRpcServerConnection::readHeader: error while reading header (%s).",XmlRpcSocket::getErrorMsg().c_str());
@@ -92,9 +130,9 @@ XmlRpcServerConnection::readHeader()
 	  lp = cp + 16;
 	else if ((ep - cp > 12) && (strncasecmp(cp, "Connection: ", 12) == 0))
 	  kp = cp + 12;
-	else if ((ep - cp > 4) && (strncmp(cp, "\r\n\r\n", 4) == 0))
+	else if ((ep - cp >= 4) && (strncmp(cp, "\r\n\r\n", 4) == 0))
 	  bp = cp + 4;
-	else if ((ep - cp > 2) && (strncmp(cp, "\n\n", 2) == 0))
+	else if ((ep - cp >= 2) && (strncmp(cp, "\n\n", 2) == 0))
 	  bp = cp + 2;
   }
 
@@ -107,10 +145,22 @@ XmlRpcServerConnection::readHeader()
         XmlRpcUtil::error("XmlRpcServerConnection::readHeader: EOF while reading header");
       return false;   // Either way we close the connection
     }
+
+    if (int(_header.length()) > _server->getMaxHeaderSize()) {
+      XmlRpcUtil::error("XmlRpcServerConnection::readHeader: header larger than %d bytes.", _server->getMaxHeaderSize());
+      generateHttpError(431, "Request Header Fields Too Large");
+      return true;
+    }
     
     return true;  // Keep reading
   }
 
+  if (bp - hp > _server->getMaxHeaderSize()) {
+    XmlRpcUtil::error("XmlRpcServerConnection::readHeader: header larger than %d bytes.", _server->getMaxHeaderSize());
+    generateHttpError(431, "Request Header Fields Too Large");
+    return true;
+  }
+
   // Decode content length
   if (lp == 0) {
     XmlRpcUtil::error("XmlRpcServerConnection::readHeader: No Content-length specified");
@@ -125,8 +175,24 @@ XmlRpcServerConnection::readHeader()
   	
   XmlRpcUtil::log(3, "XmlRpcServerConnection::readHeader: specified content length is %d.", _contentLength);
 
+  // Refuse an oversized body before reading (and allocating) any of it
+  if (_contentLength > _server->getMaxRequestSize()) {
+    XmlRpcUtil::error("XmlRpcServerConnection::readHeader: content length %d exceeds the limit of %d bytes.",
+                      _contentLength, _server->getMaxRequestSize());
+    generateHttpError(413, "Payload Too Large");
+    return true;
+  }
+
   // Otherwise copy non-header data to request buffer and set state to read request.
-  _request = bp;
+  _request.assign(bp, ep - bp);
+  _bodyRemoved = 0;
+  _scanOffset = 0;
+  _base64Tag = _base64Start = std::string::npos;
+  _streaming = false;
+  _streamed.clear();
+  _streamedAt.clear();
+  _sinkValues.clear();
+  _streamError.clear();
 
   // Parse out any interesting bits from the header (HTTP version, connection)
   _keepAlive = true;
@@ -149,21 +215,38 @@ bool
 XmlRpcServerConnection::readRequest()
 {
   // If we dont have the entire request yet, read available data
-  if (int(_request.length()) < _contentLength) {
-    bool eof;
-    if ( ! XmlRpcSocket::nbRead(this->getfd(), _request, &eof)) {
+  bool eof = false;
+  bool stream = _server->getStreamThreshold() > 0;
+  if (stream)
+    streamBinary();     // What arrived with the header
+  while ( ! eof && int(_request.length()) + _bodyRemoved < _contentLength) {
+    size_t before = _request.length();
+    if ( ! XmlRpcSocket::nbRead(this->getfd(), _request, &eof, stream ? STREAM_READ_SIZE : 0)) {
       XmlRpcUtil::error("XmlRpcServerConnection::readRequest: read error (%s).",XmlRpcSocket::getErrorMsg().c_str());
       return false;
     }
+    size_t got = _request.length() - before;
+    if ( ! stream)
+      break;
+    streamBinary();
+    if (got < STREAM_READ_SIZE)
+      break;          // Nothing more to read for now
+  }
 
-    // If we haven't gotten the entire request yet, return (keep reading)
-    if (int(_request.length()) < _contentLength) {
-      if (eof) {
-        XmlRpcUtil::error("XmlRpcServerConnection::readRequest: EOF while reading request");
-        return false;   // Either way we close the connection
-      }
-      return true;
+  // If we haven't gotten the entire request yet, return (keep reading)
+  int bodyLength = _contentLength - _bodyRemoved;
+  if (int(_request.length()) < bodyLength) {
+    if (eof) {
+      XmlRpcUtil::error("XmlRpcServerConnection::readRequest: EOF while reading request");
+      return false;   // Either way we close the connection
     }
+    return true;
+  }
+
+  // Anything past the body belongs to the next (pipelined) request
+  if (int(_request.length()) > bodyLength) {
+    _pipelined.assign(_request, bodyLength, std::string::npos);
+    _request.resize(bodyLength);
   }
 
   // Otherwise, parse and dispatch the request
@@ -181,6 +264,8 @@ XmlRpcServerConnection::writeResponse()
 {
   if (_response.length() == 0) {
     executeRequest();
+    if (_connectionState == WAIT_EVENT)
+      return true;    // Parked until the call can be answered
     _bytesWritten = 0;
     if (_response.length() == 0) {
       XmlRpcUtil::error("XmlRpcServerConnection::writeResponse: empty response.");
@@ -197,7 +282,8 @@ XmlRpcServerConnection::writeResponse()
 
   // Prepare to read the next request
   if (_bytesWritten == int(_response.length())) {
-    _header = "";
+    _header.swap(_pipelined);
+    _pipelined = "";
     _request = "";
     _response = "";
     _connectionState = READ_HEADER;
@@ -206,22 +292,272 @@ XmlRpcServerConnection::writeResponse()
   return _keepAlive;    // Continue monitoring this source if true
 }
 
+// Large base64 values are decoded into a sink as the body arrives and replaced in
+// _request by a short marker, so their text is never held as a whole. Smaller
+// ones are left for the normal parser.
+void
+XmlRpcServerConnection::streamBinary()
+{
+  const size_t threshold = _server->getStreamThreshold();
+  const size_t tagLength = sizeof(BASE64_TAG) - 1;
+  const size_t etagLength = sizeof(BASE64_ETAG) - 1;
+
+  for (;;) {
+    size_t end = std::min(_request.length(), size_t(_contentLength - _bodyRemoved));
+
+    if (_base64Start == std::string::npos) {
+      size_t tag = _request.find(BASE64_TAG, _scanOffset);
+      if (tag == std::string::npos || tag + tagLength > end) {
+        // Resume where a tag cut at the end of the data read so far could start
+        if (end > _scanOffset + tagLength)
+          _scanOffset = end - tagLength + 1;
+        return;
+      }
+      _base64Tag = tag;
+      _base64Start = _scanOffset = tag + tagLength;
+    }
+
+    // Base64 text contains no '<', so the next one starts the end tag
+    size_t close = _request.find('<', _scanOffset);
+    if (close >= end)
+      close = std::string::npos;
+    size_t textEnd = (close == std::string::npos) ? end : close;
+
+    if ( ! _streaming && textEnd - _base64Start < threshold) {
+      if (close == std::string::npos) {
+        _scanOffset = textEnd;
+        return;
+      }
+      _base64Start = std::string::npos;       // Small value, parsed as usual
+      _scanOffset = close;
+      continue;
+    }
+
+    if ( ! _streaming) {
+      _streaming = true;
+      if (_streamError.empty()) {
+        int offset = 0;
+        XmlRpcServerMethod* method = _server->findMethod(XmlRpcUtil::parseTag(METHODNAME_TAG, _request, &offset));
+        _sink = method ? method->createBinarySink(int(_streamed.size())) : 0;
+        _methodSink = (_sink != 0);
+        // No reserve from Content-length: the client may claim far more than it
+        // sends. The buffer grows with the bytes actually decoded.
+        if ( ! _sink)
+          _sink = new XmlRpcMemorySink();
+      }
+    }
+
+    // Decode complete groups, or everything once the end tag has arrived
+    size_t n = textEnd - _base64Start;
+    if (close == std::string::npos)
+      n = XmlRpcUtil::base64CompletePrefix(&_request[_base64Start], n);
+    if (n > 0) {
+      if (_sink) {
+        std::vector<char> bytes;
+        XmlRpcUtil::base64Decode(&_request[_base64Start], n, bytes);
+        if ( ! bytes.empty() && ! _sink->write(&bytes[0], bytes.size()))
+          failStream("could not store a base64 parameter");
+      }
+      _request.erase(_base64Start, n);
+      _bodyRemoved += int(n);
+      end -= n;
+      if (close != std::string::npos)
+        close -= n;
+    }
+    _scanOffset = _base64Start;
+
+    if (close == std::string::npos || close + etagLength > end)
+      return;     // Wait for the rest of the value or of its end tag
+
+    _streamed.push_back(XmlRpcValue());
+    XmlRpcValue& value = _streamed.back();
+    // A method's sink answers out of band; its parameter becomes an empty base64
+    XmlRpcValue& out = (_sink && _methodSink) ? _sinkValues[int(_streamed.size()) - 1] : value;
+    if (&out != &value)
+      value = XmlRpcValue((void*) "", 0);
+    if (_request.compare(close, etagLength, BASE64_ETAG) != 0)
+      failStream("malformed base64 parameter");
+    else if (_sink && ! _sink->finish(out))
+      failStream("could not store a base64 parameter");
+    delete _sink;
+    _sink = 0;
+    _methodSink = false;
+
+    char marker[40];
+    int markerLength = snprintf(marker, sizeof(marker), "<string>%c%d</string>", STREAMED_MARK, int(_streamed.size()) - 1);
+    size_t replaced = close + etagLength - _base64Tag;
+    _request.replace(_base64Tag, replaced, marker, markerLength);
+    _streamedAt.push_back(_base64Tag + sizeof("<string>") - 1);
+    _bodyRemoved += int(replaced) - markerLength;
+
+    XmlRpcUtil::log(3, "XmlRpcServerConnection::streamBinary: streamed base64 parameter %d.", int(_streamed.size()) - 1);
+    _streaming = false;
+    _base64Start = std::string::npos;
+    _scanOffset = _base64Tag + markerLength;
+  }
+}
+
+
+// The rest of the value is read and dropped, the call gets a fault
+void
+XmlRpcServerConnection::failStream(std::string const& msg)
+{
+  XmlRpcUtil::error("XmlRpcServerConnection::streamBinary: %s.", msg.c_str());
+  if (_streamError.empty())
+    _streamError = msg;
+  delete _sink;
+  _sink = 0;
+  _methodSink = false;
+}
+
+
+// Every marker character left in the body must be one streamBinary wrote.
+// Earlier markers keep their offsets: the body only changes after them.
+bool
+XmlRpcServerConnection::onlyOwnMarkers() const
+{
+  size_t at = 0;
+  for (size_t i = 0; ; ++i, ++at) {
+    at = _request.find(STREAMED_MARK, at);
+    if (at == std::string::npos)
+      return i == _streamedAt.size();
+    if (i >= _streamedAt.size() || at != _streamedAt[i])
+      return false;
+  }
+}
+
+
+// Arrays and structs are searched for markers; struct members are in key order,
+// which is why the marker carries the index
+void
+XmlRpcServerConnection::insertStreamed(XmlRpcValue& value)
+{
+  switch (value.getType()) {
+    case XmlRpcValue::TypeString: {
+      std::string& s = value;
+      if (s.length() < 2 || s[0] != STREAMED_MARK)
+        break;
+      size_t index = size_t(atoi(s.c_str() + 1));
+      if (index >= _streamed.size())
+        break;
+      XmlRpcValue& streamed = _streamed[index];
+      if (streamed.getType() == XmlRpcValue::TypeBase64) {
+        // Move the bytes instead of copying them
+        value = XmlRpcValue((void*) "", 0);
+        XmlRpcValue::BinaryData& bytes = value;
+        XmlRpcValue::BinaryData& source = streamed;
+        bytes.swap(source);
+      } else
+        value = streamed;
+      break;
+    }
+    case XmlRpcValue::TypeArray:
+      for (int i = 0; i < value.size(); ++i)
+        insertStreamed(value[i]);
+      break;
+    case XmlRpcValue::TypeStruct: {
+      XmlRpcValue::ValueStruct& members = value.getMembers();
+      for (XmlRpcValue::ValueStruct::iterator it = members.begin(); it != members.end(); ++it)
+        insertStreamed(it->second);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+
 // Run the method, generate _response string
 void
 XmlRpcServerConnection::executeRequest()
 {
-  XmlRpcValue params, resultValue;
+  if ( ! _streamError.empty()) {
+    generateFaultResponse(_streamError);
+    _streamError.clear();
+    _streamed.clear();
+    _streamedAt.clear();
+    _sinkValues.clear();
+    return;
+  }
+
+  if ( ! _streamed.empty() && ! onlyOwnMarkers()) {
+    generateFaultResponse("request contains control characters");
+    _streamed.clear();
+    _streamedAt.clear();
+    _sinkValues.clear();
+    return;
+  }
+
+  // Cacheable methods with a previously seen parameter list are answered
+  // with the stored response bytes, without parsing or executing anything.
+  // A request with streamed values no longer holds its parameters.
+  std::string cacheKey;
+  if (_streamed.empty() && findCachedResponse(cacheKey))
+    return;
+
+  XmlRpcValue params;
   std::string methodName = parseRequest(params);
+  if ( ! _streamed.empty()) {
+    insertStreamed(params);
+    _streamed.clear();
+    _streamedAt.clear();
+  }
   XmlRpcUtil::log(2, "XmlRpcServerConnection::executeRequest: server calling method '%s'", 
                     methodName.c_str());
 
   try {
 
-    if ( ! executeMethod(methodName, params, resultValue) &&
+    // Long-poll calls that cannot be answered yet park the connection
+    XmlRpcServerMethod* method = _server->findMethod(methodName);
+    double msTimeout = -1.0;
+    _waitState.clear();
+    if (method && method->mustWait(params, _waitState, &msTimeout) && msTimeout > 0.0) {
+      XmlRpcUtil::log(3, "XmlRpcServerConnection::executeRequest: '%s' waiting up to %.0f ms.",
+                      methodName.c_str(), msTimeout);
+      _waitMethodName = methodName;
+      _waitParams = params;
+      _sinkValues.clear();
+      _connectionState = WAIT_EVENT;
+      _server->addWaiting(this, msTimeout);
+      return;
+    }
+
+  } catch (const XmlRpcException& fault) {
+    XmlRpcUtil::log(2, "XmlRpcServerConnection::executeRequest: fault %s.",
+                    fault.getMessage().c_str()); 
+    generateFaultResponse(fault.getMessage(), fault.getCode());
+    _sinkValues.clear();
+    return;
+  }
+
+  // A method that started work in mustWait() but finished it right away still
+  // gets its per-call state
+  generateResult(methodName, params, cacheKey, _waitState.valid() ? &_waitState : 0);
+  _waitState.clear();
+  _sinkValues.clear();
+
+  // This call may have changed what parked long-poll calls are waiting for
+  _server->notifyWaiting();
+}
+
+// Run the method (or multicall) and generate the response or fault
+void
+XmlRpcServerConnection::generateResult(const std::string& methodName, XmlRpcValue& params,
+                                       std::string const& cacheKey, XmlRpcValue* waitState)
+{
+  XmlRpcValue resultValue;
+  try {
+
+    XmlRpcValue* sinkValues = _sinkValues.valid() ? &_sinkValues : 0;
+    if ( ! executeMethod(methodName, params, resultValue, waitState, sinkValues) &&
          ! executeMulticall(methodName, params, resultValue))
       generateFaultResponse(methodName + ": unknown method name");
     else
+    {
       generateResponse(resultValue.toXml());
+      if ( ! cacheKey.empty())
+        _server->getResponseCache().insert(cacheKey, _response);
+    }
 
   } catch (const XmlRpcException& fault) {
     XmlRpcUtil::log(2, "XmlRpcServerConnection::executeRequest: fault %s.",
@@ -230,6 +566,65 @@ XmlRpcServerConnection::executeRequest()
   }
 }
 
+// Called by the server when state that parked calls may depend on has changed.
+void
+XmlRpcServerConnection::checkWait()
+{
+  if (_connectionState != WAIT_EVENT)
+    return;
+
+  try {
+    XmlRpcServerMethod* method = _server->findMethod(_waitMethodName);
+    double msTimeout = -1.0;
+    if (method && method->mustWait(_waitParams, _waitState, &msTimeout))
+      return;     // Keep waiting (the original deadline still applies)
+  } catch (const XmlRpcException&) {
+    // Let execute() report the problem
+  }
+
+  finishWait();
+}
+
+// Stop waiting, execute the parked call and prepare to write the response
+void
+XmlRpcServerConnection::finishWait()
+{
+  XmlRpcUtil::log(3, "XmlRpcServerConnection::finishWait: resuming '%s'.", _waitMethodName.c_str());
+  _server->resumeWaiting(this);
+
+  generateResult(_waitMethodName, _waitParams, std::string(), &_waitState);
+  _waitMethodName = "";
+  _waitParams.clear();
+  _waitState.clear();
+  _bytesWritten = 0;
+  _connectionState = WRITE_RESPONSE;
+}
+
+// If the requested method is cacheable, set key to its cache key and look it up.
+// Returns true (with _response set) on a cache hit.
+bool
+XmlRpcServerConnection::findCachedResponse(std::string& key)
+{
+  XmlRpcResponseCache& cache = _server->getResponseCache();
+  if (cache.getMaxEntries() == 0)
+    return false;
+
+  int offset = 0;
+  std::string methodName = XmlRpcUtil::parseTag(METHODNAME_TAG, _request, &offset);
+  XmlRpcServerMethod* method = _server->findMethod(methodName);
+  if ( ! method || ! method->isCacheable())
+    return false;
+
+  // Everything after </methodName> is the (raw) parameter list
+  key = XmlRpcResponseCache::makeKey(methodName, _request.substr(offset));
+  if ( ! cache.find(key, _response))
+    return false;
+
+  XmlRpcUtil::log(2, "XmlRpcServerConnection::executeRequest: cached response for '%s'",
+                  methodName.c_str());
+  return true;
+}
+
 // Parse the method name and the argument values from the request.
 std::string
 XmlRpcServerConnection::parseRequest(XmlRpcValue& params)
@@ -255,13 +650,19 @@ XmlRpcServerConnection::parseRequest(XmlRpcValue& params)
 // Execute a named method with the specified params.
 bool
 XmlRpcServerConnection::executeMethod(const std::string& methodName, 
-                                      XmlRpcValue& params, XmlRpcValue& result)
+                                      XmlRpcValue& params, XmlRpcValue& result,
+                                      XmlRpcValue* waitState, XmlRpcValue* sinkValues)
 {
   XmlRpcServerMethod* method = _server->findMethod(methodName);
 
   if ( ! method) return false;
 
-  method->execute(params, result);
+  if (waitState)
+    method->executeWaited(params, *waitState, result);
+  else if (sinkValues)
+    method->executeStreamed(params, *sinkValues, result);
+  else
+    method->execute(params, result);
 
   // Ensure a valid result value
   if ( ! result.valid())
@@ -336,6 +737,34 @@ XmlRpcServerConnection::generateResponse(std::string const& resultXml)
   XmlRpcUtil::log(5, "XmlRpcServerConnection::generateResponse:\n%s\n", _response.c_str()); 
 }
 
+// A request the server refuses to read: answer with an HTTP error and close
+void
+XmlRpcServerConnection::generateHttpError(int status, const char* reason)
+{
+  char statusLine[80];
+  snprintf(statusLine, sizeof(statusLine), "HTTP/1.1 %d %s\r\n", status, reason);
+  std::string body = std::string(reason) + "\r\n";
+
+  char buffLen[40];
+  snprintf(buffLen, sizeof(buffLen), "%d\r\n", int(body.size()));
+
+  _response = statusLine;
+  _response += "Server: ";
+  _response += XMLRPC_VERSION;
+  _response += "\r\n"
+    "Content-Type: text/plain\r\n"
+    "Connection: close\r\n"
+    "Content-length: ";
+  _response += buffLen;
+  _response += "\r\n";
+  _response += body;
+
+  _keepAlive = false;
+  _bytesWritten = 0;
+  _header = "";
+  _connectionState = WRITE_RESPONSE;
+}
+
 // Prepend http headers
 std::string
 XmlRpcServerConnection::generateHeader(std::string const& body)
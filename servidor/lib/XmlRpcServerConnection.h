@@ -8,7 +8,9 @@
 #endif
 
 #ifndef MAKEDEPEND
+# include <deque>
 # include <string>
+# include <vector>
 #endif
 
 #include "XmlRpcValue.h"
@@ -20,6 +22,7 @@ namespace XmlRpc {
   // The server waits for client connections and provides methods
   class XmlRpcServer;
   class XmlRpcServerMethod;
+  class XmlRpcBinarySink;
 
   //! A class to handle XML RPC requests from a particular client
   class XmlRpcServerConnection : public XmlRpcSource {
@@ -48,20 +51,50 @@ namespace XmlRpc {
     //!   @param eventType Type of IO event that occurred. @see XmlRpcDispatch::EventType.
     virtual unsigned handleEvent(unsigned eventType);
 
+    //! Re-check a parked long-poll call and answer it if it no longer needs to wait.
+    void checkWait();
+
+    //! True between requests: nothing of the next request has been read yet
+    //! and no response is pending.
+    bool isIdle() const { return _connectionState == READ_HEADER && _header.empty(); }
+
   protected:
 
     bool readHeader();
     bool readRequest();
     bool writeResponse();
 
+    // Decode the large base64 values of the body read so far into sinks.
+    void streamBinary();
+
+    // Stop streaming the current base64 value and reject the call with msg.
+    void failStream(std::string const& msg);
+
+    // Put the streamed values in place of their markers in the parsed parameters.
+    void insertStreamed(XmlRpcValue& value);
+
+    // False if the body holds a marker character that streamBinary did not write.
+    bool onlyOwnMarkers() const;
+
     // Parses the request, runs the method, generates the response xml.
     virtual void executeRequest();
 
     // Parse the methodName and parameters from the request.
     std::string parseRequest(XmlRpcValue& params);
 
-    // Execute a named method with the specified params.
-    bool executeMethod(const std::string& methodName, XmlRpcValue& params, XmlRpcValue& result);
+    // Look up the response of a cacheable method in the server's cache.
+    bool findCachedResponse(std::string& key);
+
+    // Execute the method and generate the response, storing it in the cache if key is set.
+    void generateResult(const std::string& methodName, XmlRpcValue& params, std::string const& cacheKey,
+                        XmlRpcValue* waitState = 0);
+
+    // Execute a parked call and switch to writing its response.
+    void finishWait();
+
+    // Execute a named method with the specified params (and wait state, for parked calls).
+    bool executeMethod(const std::string& methodName, XmlRpcValue& params, XmlRpcValue& result,
+                       XmlRpcValue* waitState = 0, XmlRpcValue* sinkValues = 0);
 
     // Execute multiple calls and return the results in an array.
     bool executeMulticall(const std::string& methodName, XmlRpcValue& params, XmlRpcValue& result);
@@ -69,6 +102,7 @@ namespace XmlRpc {
     // Construct a response from the result XML.
     void generateResponse(std::string const& resultXml);
     void generateFaultResponse(std::string const& msg, int errorCode = -1);
+    void generateHttpError(int status, const char* reason);
     std::string generateHeader(std::string const& body);
 
 
@@ -76,9 +110,14 @@ namespace XmlRpc {
     XmlRpcServer* _server;
 
     // Possible IO states for the connection
-    enum ServerConnectionState { READ_HEADER, READ_REQUEST, WRITE_RESPONSE };
+    enum ServerConnectionState { READ_HEADER, READ_REQUEST, WRITE_RESPONSE, WAIT_EVENT };
     ServerConnectionState _connectionState;
 
+    // Method name, parameters and per-call state of a parked long-poll call
+    std::string _waitMethodName;
+    XmlRpcValue _waitParams;
+    XmlRpcValue _waitState;
+
     // Request headers
     std::string _header;
 
@@ -88,6 +127,23 @@ namespace XmlRpc {
     // Request body
     std::string _request;
 
+    // Bytes received past the end of the current request (the start of the next one)
+    std::string _pipelined;
+
+    // Streamed base64 values: body bytes dropped from _request, where the scan for
+    // <base64> resumes, the tag and text of the value being read (npos if none)
+    int _bodyRemoved;
+    size_t _scanOffset;
+    size_t _base64Tag;
+    size_t _base64Start;
+    bool _streaming;
+    XmlRpcBinarySink* _sink;
+    bool _methodSink;                       // _sink came from the method, not the default
+    std::deque<XmlRpcValue> _streamed;      // Elements are never copied on growth
+    XmlRpcValue _sinkValues;                // What the method's sinks produced, for executeStreamed
+    std::vector<size_t> _streamedAt;        // Offsets in _request of their markers
+    std::string _streamError;
+
     // Response
     std::string _response;
 
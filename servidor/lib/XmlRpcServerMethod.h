@@ -17,6 +17,9 @@ namespace XmlRpc {
   // Representation of a parameter or result value
   class XmlRpcValue;
 
+  // Destination of a large base64 parameter
+  class XmlRpcBinarySink;
+
   // The XmlRpcServer processes client requests to call RPCs
   class XmlRpcServer;
 
@@ -38,6 +41,38 @@ namespace XmlRpc {
     //! Subclasses should define this method if introspection is being used.
     virtual std::string help() { return std::string(); }
 
+    //! Returns true if the result depends only on the call parameters, so the
+    //! server may answer repeated calls from its response cache.
+    virtual bool isCacheable() { return false; }
+
+    //! Long-poll support. Return true (and set *msTimeout) if the call cannot be
+    //! answered yet. The client connection is then parked in the dispatcher without
+    //! blocking the server, and executeWaited() runs as soon as mustWait() returns
+    //! false on a later check (see XmlRpcServer::notifyWaiting) or the timeout expires.
+    //! waitState starts out invalid and is kept by the connection for the whole call,
+    //! so methods can store per-call data in it (it is never sent to the client).
+    virtual bool mustWait(XmlRpcValue& /*params*/, XmlRpcValue& /*waitState*/, double* /*msTimeout*/)
+    { return false; }
+
+    //! Produce the result of a call that was parked by mustWait(). Defaults to execute().
+    virtual void executeWaited(XmlRpcValue& params, XmlRpcValue& /*waitState*/, XmlRpcValue& result)
+    { execute(params, result); }
+
+    //! Base64 parameters larger than the server's stream threshold are decoded as
+    //! they arrive. Return a new sink for the index-th of them in the call (0, 1, ...)
+    //! to choose where the bytes go; the connection deletes it. The default (null)
+    //! collects them in memory and the method sees a normal base64 value.
+    //! What a returned sink's finish() produces goes to executeStreamed(), never
+    //! into params: a client cannot pose as a sink by sending the same value.
+    virtual XmlRpcBinarySink* createBinarySink(int /*index*/) { return 0; }
+
+    //! Execute a call in which createBinarySink() returned sinks. streamed[index]
+    //! holds what the index-th sink produced (other entries are invalid); in params
+    //! those parameters are empty base64 values. Defaults to execute(). Calls parked
+    //! by mustWait() and calls inside system.multicall do not get sink values.
+    virtual void executeStreamed(XmlRpcValue& params, XmlRpcValue& /*streamed*/, XmlRpcValue& result)
+    { execute(params, result); }
+
   protected:
     std::string _name;
     XmlRpcServer* _server;
@@ -5,6 +5,9 @@
 #ifndef MAKEDEPEND
 #include <strings.h>
 #include <string.h>
+#include <time.h>
+#include <map>
+#include <mutex>
 using namespace std;
 
 #if defined(_WINDOWS)
@@ -23,7 +26,13 @@ extern "C" {
 # include <sys/types.h>
 # include <sys/socket.h>
 # include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <arpa/inet.h>
 # include <netdb.h>
+# include <stddef.h>
+# include <stdlib.h>
+# include <sys/stat.h>
+# include <sys/un.h>
 # include <errno.h>
 # include <fcntl.h>
 }
@@ -58,32 +67,158 @@ static void initWinSock()
 
 
 // These errors are not considered fatal for an IO operation; the operation will be re-tried.
+bool
+XmlRpcSocket::nonFatalError()
+{
+  int err = XmlRpcSocket::getError();
+  return (err == EINPROGRESS || err == EAGAIN || err == EWOULDBLOCK || err == EINTR);
+}
 
-static inline bool
 
-nonFatalError()
 
+int
+XmlRpcSocket::socket()
 {
+  initWinSock();
+  return (int) ::socket(AF_INET, SOCK_STREAM, 0);
+}
 
-  int err = XmlRpcSocket::getError();
 
-  return (err == EINPROGRESS || err == EAGAIN || err == EWOULDBLOCK || err == EINTR);
+// Hosts naming a unix domain socket
+static const char UNIX_PREFIX[] = "unix:";
+
+bool
+XmlRpcSocket::isUnixHost(std::string const& host)
+{
+  return host.compare(0, sizeof(UNIX_PREFIX)-1, UNIX_PREFIX) == 0 || ( ! host.empty() && host[0] == '/');
+}
+
+
+static std::string unixPath(std::string const& host)
+{
+  return (host.compare(0, sizeof(UNIX_PREFIX)-1, UNIX_PREFIX) == 0) ? host.substr(sizeof(UNIX_PREFIX)-1) : host;
+}
+
 
+// An IPv6 literal, with or without brackets
+static bool parseIpv6(std::string const& host, struct in6_addr* addr)
+{
+  std::string literal = host;
+  if (literal.size() >= 2 && literal[0] == '[' && literal[literal.size()-1] == ']')
+    literal = literal.substr(1, literal.size()-2);
+  return literal.find(':') != std::string::npos && inet_pton(AF_INET6, literal.c_str(), addr) == 1;
 }
 
 
+// Fill in the socket address for host:port
+static bool makeAddress(std::string const& host, int port, struct sockaddr_storage* ss, socklen_t* len)
+{
+  memset(ss, 0, sizeof(*ss));
 
+  if (XmlRpcSocket::isUnixHost(host)) {
+#if defined(_WINDOWS)
+    return false;
+#else
+    struct sockaddr_un* sun = (struct sockaddr_un*) ss;
+    std::string path = unixPath(host);
+    if (path.empty() || path.size() >= sizeof(sun->sun_path)) {
+      errno = ENAMETOOLONG;
+      return false;
+    }
+    sun->sun_family = AF_UNIX;
+    memcpy(sun->sun_path, path.c_str(), path.size() + 1);
+    *len = socklen_t(offsetof(struct sockaddr_un, sun_path) + path.size() + 1);
+    return true;
+#endif
+  }
+
+  struct in6_addr addr6;
+  if (parseIpv6(host, &addr6)) {
+    struct sockaddr_in6* sin6 = (struct sockaddr_in6*) ss;
+    sin6->sin6_family = AF_INET6;
+    sin6->sin6_addr = addr6;
+    sin6->sin6_port = htons((u_short) port);
+    *len = sizeof(*sin6);
+    return true;
+  }
 
+  struct sockaddr_in* sin = (struct sockaddr_in*) ss;
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons((u_short) port);
+  if (host.empty() || host == "*")
+    sin->sin_addr.s_addr = htonl(INADDR_ANY);
+  else if (inet_pton(AF_INET, host.c_str(), &sin->sin_addr) != 1 && ! XmlRpcSocket::resolve(host, &sin->sin_addr))
+    return false;
+  *len = sizeof(*sin);
+  return true;
+}
 
 
 int
-XmlRpcSocket::socket()
+XmlRpcSocket::socket(std::string const& host)
 {
   initWinSock();
+  struct in6_addr addr6;
+#if ! defined(_WINDOWS)
+  if (isUnixHost(host))
+    return (int) ::socket(AF_UNIX, SOCK_STREAM, 0);
+#endif
+  if (parseIpv6(host, &addr6))
+    return (int) ::socket(AF_INET6, SOCK_STREAM, 0);
   return (int) ::socket(AF_INET, SOCK_STREAM, 0);
 }
 
 
+bool
+XmlRpcSocket::parseAddress(std::string const& address, std::string& host, int& port)
+{
+  if (isUnixHost(address)) {
+    host = address;
+    port = 0;
+    return unixPath(address).size() > 0;
+  }
+
+  std::string portText = address;
+  host.clear();
+  size_t colon = address.rfind(':');
+  if (colon != std::string::npos) {
+    if (address[0] == '[') {                    // [ipv6]:port
+      size_t close = address.find(']');
+      if (close == std::string::npos || close + 1 != colon)
+        return false;
+      host = address.substr(1, close - 1);
+    }
+    else if (address.find(':') != colon)        // Bare IPv6 literal, no port
+      return false;
+    else
+      host = address.substr(0, colon);
+    portText = address.substr(colon + 1);
+  }
+
+  char* end;
+  long value = strtol(portText.c_str(), &end, 10);
+  if (portText.empty() || *end != 0 || value <= 0 || value > 65535)
+    return false;
+  port = int(value);
+  return true;
+}
+
+
+std::string
+XmlRpcSocket::hostHeader(std::string const& host, int port)
+{
+  if (isUnixHost(host))
+    return "localhost";
+
+  char buff[16];
+  snprintf(buff, sizeof(buff), ":%d", port);
+  struct in6_addr addr6;
+  if (host.find(':') != std::string::npos && host[0] != '[' && parseIpv6(host, &addr6))
+    return "[" + host + "]" + buff;
+  return host + buff;
+}
+
+
 void
 XmlRpcSocket::close(int fd)
 {
@@ -110,6 +245,35 @@ XmlRpcSocket::setNonBlocking(int fd)
 }
 
 
+bool
+XmlRpcSocket::setNoDelay(int fd, bool on)
+{
+  int flag = on ? 1 : 0;
+  return (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char *)&flag, sizeof(flag)) == 0);
+}
+
+
+bool
+XmlRpcSocket::setKeepAlive(int fd, bool on)
+{
+  int flag = on ? 1 : 0;
+  return (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (const char *)&flag, sizeof(flag)) == 0);
+}
+
+
+bool
+XmlRpcSocket::setBufferSizes(int fd, int sendBytes, int receiveBytes)
+{
+  if (sendBytes > 0 &&
+      setsockopt(fd, SOL_SOCKET, SO_SNDBUF, (const char *)&sendBytes, sizeof(sendBytes)) != 0)
+    return false;
+  if (receiveBytes > 0 &&
+      setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (const char *)&receiveBytes, sizeof(receiveBytes)) != 0)
+    return false;
+  return true;
+}
+
+
 bool
 XmlRpcSocket::setReuseAddr(int fd)
 {
@@ -132,6 +296,44 @@ XmlRpcSocket::bind(int fd, int port)
 }
 
 
+bool
+XmlRpcSocket::bind(int fd, std::string const& host, int port)
+{
+  struct sockaddr_storage ss;
+  socklen_t len;
+  if ( ! makeAddress(host, port, &ss, &len))
+    return false;
+
+#if ! defined(_WINDOWS)
+  // A socket file nobody accepts on is left over from a server that exited
+  if (ss.ss_family == AF_UNIX) {
+    const char* path = ((struct sockaddr_un*) &ss)->sun_path;
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+      int probe = (int) ::socket(AF_UNIX, SOCK_STREAM, 0);
+      bool inUse = probe >= 0 && ::connect(probe, (struct sockaddr*) &ss, len) == 0;
+      if (probe >= 0)
+        ::close(probe);
+      if (inUse) {
+        errno = EADDRINUSE;
+        return false;
+      }
+      unlink(path);
+    }
+  }
+#endif
+
+  // Only IPv6: "[::]:8080" must not take the IPv4 port that bindAndListen uses too
+  if (ss.ss_family == AF_INET6) {
+    int on = 1;
+    if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, (const char*) &on, sizeof(on)) != 0)
+      return false;
+  }
+
+  return (::bind(fd, (struct sockaddr*) &ss, len) == 0);
+}
+
+
 // Set socket in listen mode
 bool 
 XmlRpcSocket::listen(int fd, int backlog)
@@ -143,7 +345,7 @@ XmlRpcSocket::listen(int fd, int backlog)
 int
 XmlRpcSocket::accept(int fd)
 {
-  struct sockaddr_in addr;
+  struct sockaddr_storage addr;
 #if defined(_WINDOWS)
   int
 #else
@@ -155,41 +357,262 @@ XmlRpcSocket::accept(int fd)
 }
 
 
+int
+XmlRpcSocket::acceptNonBlocking(int fd)
+{
+#if defined(__linux__)
+  struct sockaddr_storage addr;
+  socklen_t addrlen = sizeof(addr);
+  return (int) ::accept4(fd, (struct sockaddr*)&addr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+  int s = accept(fd);
+  if (s < 0)
+    return s;
+  if ( ! setNonBlocking(s)) {
+    close(s);
+    return -1;
+  }
+# if ! defined(_WINDOWS)
+  fcntl(s, F_SETFD, FD_CLOEXEC);
+# endif
+  return s;
+#endif
+}
+
+
     
-// Connect a socket to a server (from a client)
+// Resolved host addresses, so clients that reconnect (or keep a pool of
+// connections) do not query the resolver every time.
+namespace {
+  struct CachedAddress {
+    struct in_addr addr;
+    time_t expires;
+  };
+  std::map<std::string, CachedAddress> addressCache;
+  std::mutex addressCacheMutex;     // gethostbyname is not reentrant either
+  int addressCacheTtl = 60;
+}
+
+
+void
+XmlRpcSocket::setAddressCacheTtl(int seconds)
+{
+  std::lock_guard<std::mutex> lock(addressCacheMutex);
+  addressCacheTtl = seconds;
+  if (seconds <= 0)
+    addressCache.clear();
+}
+
+
+void
+XmlRpcSocket::flushAddressCache()
+{
+  std::lock_guard<std::mutex> lock(addressCacheMutex);
+  addressCache.clear();
+}
+
+
+// Look up the IPv4 address of host, using the cache when possible
 bool
-XmlRpcSocket::connect(int fd, std::string& host, int port)
+XmlRpcSocket::resolve(std::string const& host, struct in_addr* addr)
 {
-  struct sockaddr_in saddr;
-  memset(&saddr, 0, sizeof(saddr));
-  saddr.sin_family = AF_INET;
+  std::lock_guard<std::mutex> lock(addressCacheMutex);
+  time_t now = time(0);
+
+  std::map<std::string, CachedAddress>::iterator it = addressCache.find(host);
+  if (it != addressCache.end() && it->second.expires > now) {
+    *addr = it->second.addr;
+    return true;
+  }
 
   struct hostent *hp = gethostbyname(host.c_str());
-  if (hp == 0) return false;
+  if (hp == 0 || hp->h_addrtype != AF_INET) return false;
+  memcpy(addr, hp->h_addr, sizeof(*addr));
 
-  saddr.sin_family = hp->h_addrtype;
-  memcpy(&saddr.sin_addr, hp->h_addr, hp->h_length);
-  saddr.sin_port = htons((u_short) port);
+  if (addressCacheTtl > 0) {
+    CachedAddress& entry = addressCache[host];
+    entry.addr = *addr;
+    entry.expires = now + addressCacheTtl;
+  }
+  return true;
+}
+
+
+// Connect a socket to a server (from a client)
+bool
+XmlRpcSocket::connect(int fd, std::string& host, int port)
+{
+  struct sockaddr_storage saddr;
+  socklen_t len;
+  if ( ! makeAddress(host, port, &saddr, &len)) return false;
 
   // For asynch operation, this will return EWOULDBLOCK (windows) or
   // EINPROGRESS (linux) and we just need to wait for the socket to be writable...
-  int result = ::connect(fd, (struct sockaddr *)&saddr, sizeof(saddr));
+  int result = ::connect(fd, (struct sockaddr *)&saddr, len);
   return result == 0 || nonFatalError();
 }
 
 
 
+// Create a pair of connected, non-blocking local sockets
+bool
+XmlRpcSocket::socketPair(int fds[2])
+{
+#if defined(_WINDOWS)
+  return false;
+#else
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    return false;
+  if ( ! setNonBlocking(fds[0]) || ! setNonBlocking(fds[1])) {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return false;
+  }
+  return true;
+#endif // _WINDOWS
+}
+
+
+// Send a single byte without blocking or raising SIGPIPE
+bool
+XmlRpcSocket::sendByte(int fd)
+{
+  char c = 0;
+#if defined(_WINDOWS)
+  return send(fd, &c, 1, 0) == 1;
+#else
+  return ::send(fd, &c, 1, MSG_NOSIGNAL | MSG_DONTWAIT) == 1 || nonFatalError();
+#endif // _WINDOWS
+}
+
+
+
+// Most descriptors passed in a single message
+static const int MAX_PASSED_FDS = 64;
+
+bool
+XmlRpcSocket::sendFds(int fd, std::string const& data, std::vector<int> const& fds)
+{
+#if defined(_WINDOWS)
+  return false;
+#else
+  if (fds.size() > (size_t) MAX_PASSED_FDS || data.empty())
+    return false;
+
+  struct iovec iov;
+  iov.iov_base = (void*) data.data();
+  iov.iov_len = data.size();
+
+  union {
+    char buf[CMSG_SPACE(MAX_PASSED_FDS * sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  memset(&control, 0, sizeof(control));
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if ( ! fds.empty()) {
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(fds.size() * sizeof(int));
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fds[0], fds.size() * sizeof(int));
+  }
+
+  ssize_t n;
+  do {
+    n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  return n == (ssize_t) data.size();
+#endif // _WINDOWS
+}
+
+
+bool
+XmlRpcSocket::recvFds(int fd, std::string& data, std::vector<int>& fds)
+{
+#if defined(_WINDOWS)
+  return false;
+#else
+  char buf[4096];
+  struct iovec iov;
+  iov.iov_base = buf;
+  iov.iov_len = sizeof(buf);
+
+  union {
+    char buf[CMSG_SPACE(MAX_PASSED_FDS * sizeof(int))];
+    struct cmsghdr align;
+  } control;
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  ssize_t n;
+  do {
+#if defined(MSG_CMSG_CLOEXEC)
+    n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+#else
+    n = ::recvmsg(fd, &msg, 0);
+#endif
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0)
+    return false;
+
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const unsigned char* p = CMSG_DATA(cmsg);
+      for (size_t i = 0; i < count; ++i) {
+        int passed;
+        memcpy(&passed, p + i * sizeof(int), sizeof(int));
+        fds.push_back(passed);
+      }
+    }
+
+  data.assign(buf, n);
+  return (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) == 0;
+#endif // _WINDOWS
+}
+
+
+bool
+XmlRpcSocket::getUnixPath(int fd, std::string& path)
+{
+#if defined(_WINDOWS)
+  return false;
+#else
+  struct sockaddr_storage ss;
+  socklen_t len = sizeof(ss);
+  if (getsockname(fd, (struct sockaddr*) &ss, &len) != 0 || ss.ss_family != AF_UNIX)
+    return false;
+  const struct sockaddr_un* sun = (const struct sockaddr_un*) &ss;
+  size_t n = len > offsetof(struct sockaddr_un, sun_path) ? len - offsetof(struct sockaddr_un, sun_path) : 0;
+  path.assign(sun->sun_path, strnlen(sun->sun_path, n));
+  return true;
+#endif // _WINDOWS
+}
+
+
 // Read available text from the specified socket. Returns false on error.
 bool 
-XmlRpcSocket::nbRead(int fd, std::string& s, bool *eof)
+XmlRpcSocket::nbRead(int fd, std::string& s, bool *eof, size_t maxBytes /*= 0*/)
 {
   const int READ_SIZE = 4096;   // Number of bytes to attempt to read at a time
   char readBuf[READ_SIZE];
 
   bool wouldBlock = false;
   *eof = false;
+  size_t start = s.length();
 
-  while ( ! wouldBlock && ! *eof) {
+  while ( ! wouldBlock && ! *eof && (maxBytes == 0 || s.length() - start < maxBytes)) {
 #if defined(_WINDOWS)
     int n = recv(fd, readBuf, READ_SIZE-1, 0);
 #else
@@ -225,7 +648,8 @@ XmlRpcSocket::nbWrite(int fd, std::string& s, int *bytesSoFar)
 #if defined(_WINDOWS)
     int n = send(fd, sp, nToWrite, 0);
 #else
-    int n = write(fd, sp, nToWrite);
+    // A peer that went away must not kill the process with SIGPIPE
+    int n = ::send(fd, sp, nToWrite, MSG_NOSIGNAL);
 #endif
     XmlRpcUtil::log(5, "XmlRpcSocket::nbWrite: send/write returned %d.", n);
 
@@ -9,8 +9,11 @@
 
 #ifndef MAKEDEPEND
 # include <string>
+# include <vector>
 #endif
 
+struct in_addr;
+
 namespace XmlRpc {
 
   //! A platform-independent socket API.
@@ -20,6 +23,21 @@ namespace XmlRpc {
     //! Creates a stream (TCP) socket. Returns -1 on failure.
     static int socket();
 
+    //! Creates a stream socket of the right family for host: a unix domain socket
+    //! for "unix:/path" (or an absolute path), IPv6 for an IPv6 literal, otherwise
+    //! TCP over IPv4. Returns -1 on failure.
+    static int socket(std::string const& host);
+
+    //! Returns true if host names a unix domain socket ("unix:/path" or "/path")
+    static bool isUnixHost(std::string const& host);
+
+    //! Split an address into host and port: "port", "host:port", "[ipv6]:port" or
+    //! "unix:/path" (port 0). Returns false if there is no valid port.
+    static bool parseAddress(std::string const& address, std::string& host, int& port);
+
+    //! The value of an HTTP Host header for a connection to host:port
+    static std::string hostHeader(std::string const& host, int port);
+
     //! Closes a socket.
     static void close(int socket);
 
@@ -27,14 +45,25 @@ namespace XmlRpc {
     //! Sets a stream (TCP) socket to perform non-blocking IO. Returns false on failure.
     static bool setNonBlocking(int socket);
 
-    //! Read text from the specified socket. Returns false on error.
-    static bool nbRead(int socket, std::string& s, bool *eof);
+    //! Enable or disable Nagle's algorithm (TCP_NODELAY on disables it). Returns false on failure.
+    static bool setNoDelay(int socket, bool on);
+
+    //! Enable or disable TCP keepalive probes. Returns false on failure.
+    static bool setKeepAlive(int socket, bool on);
+
+    //! Set the kernel send and receive buffer sizes in bytes (0 keeps the system default).
+    //! Returns false on failure.
+    static bool setBufferSizes(int socket, int sendBytes, int receiveBytes);
+
+    //! Read text from the specified socket. Returns false on error. With maxBytes
+    //! set, stops once about that many bytes were read even if more are available.
+    static bool nbRead(int socket, std::string& s, bool *eof, size_t maxBytes = 0);
 
     //! Write text to the specified socket. Returns false on error.
     static bool nbWrite(int socket, std::string& s, int *bytesSoFar);
 
 
-    // The next four methods are appropriate for servers.
+    // The next five methods are appropriate for servers.
 
     //! Allow the port the specified socket is bound to to be re-bound immediately so 
     //! server re-starts are not delayed. Returns false on failure.
@@ -43,16 +72,61 @@ namespace XmlRpc {
     //! Bind to a specified port
     static bool bind(int socket, int port);
 
+    //! Bind to host:port, a socket made by socket(host). An empty host or "*" is every
+    //! IPv4 interface and "::" every IPv6 one. A unix socket file left by a server
+    //! that is no longer running is removed first.
+    static bool bind(int socket, std::string const& host, int port);
+
     //! Set socket in listen mode
     static bool listen(int socket, int backlog);
 
     //! Accept a client connection request
     static int accept(int socket);
 
+    //! Accept a client connection request, returning a non-blocking, close-on-exec
+    //! socket (in one call where the system has accept4). Returns -1 on failure;
+    //! nonFatalError() is true if no request was pending.
+    static int acceptNonBlocking(int socket);
+
 
-    //! Connect a socket to a server (from a client)
+    //! Connect a socket to a server (from a client). host may also be a unix socket
+    //! path or an IPv6 literal, see socket(host).
     static bool connect(int socket, std::string& host, int port);
 
+    //! Look up the IPv4 address of host. Results are cached for a while so
+    //! reconnecting clients do not query the resolver on every connect.
+    static bool resolve(std::string const& host, struct in_addr* addr);
+
+    //! How long resolved addresses are kept (0 disables the cache). Default 60 s.
+    static void setAddressCacheTtl(int seconds);
+
+    //! Forget all resolved addresses
+    static void flushAddressCache();
+
+
+    //! Create a pair of connected, non-blocking local sockets (used to wake up
+    //! a dispatcher from another thread). Returns false on failure.
+    static bool socketPair(int fds[2]);
+
+    //! Send a single byte without blocking or raising SIGPIPE. Returns false on failure.
+    static bool sendByte(int socket);
+
+    //! Send data together with open file descriptors over a unix domain socket
+    //! (SCM_RIGHTS); the receiver gets its own copies of them. Returns false on failure.
+    static bool sendFds(int socket, std::string const& data, std::vector<int> const& fds);
+
+    //! Receive one message sent with sendFds, appending the descriptors to fds.
+    //! Returns false on failure or if the peer closed the socket.
+    static bool recvFds(int socket, std::string& data, std::vector<int>& fds);
+
+    //! If socket is a unix domain socket, set path to the file it is bound to
+    //! and return true.
+    static bool getUnixPath(int socket, std::string& path);
+
+
+    //! Returns true if the last error means the operation should simply be retried
+    //! later (no data or connection pending, interrupted, connect in progress)
+    static bool nonFatalError();
 
     //! Returns last errno
     static int getError();
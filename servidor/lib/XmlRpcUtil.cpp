@@ -10,6 +10,7 @@
 #endif
 
 #include "XmlRpc.h"
+#include "XmlRpcAsyncLog.h"
 
 using namespace XmlRpc;
 
@@ -68,16 +69,20 @@ void XmlRpc::setVerbosity(int level) { XmlRpcLogHandler::setVerbosity(level); }
 
  
 
-void XmlRpcUtil::log(int level, const char* fmt, ...)
+void XmlRpcUtil::logMessage(int level, const char* fmt, ...)
 {
   if (level <= XmlRpcLogHandler::getVerbosity())
   {
     va_list va;
-    char buf[1024];
     va_start( va, fmt);
-    vsnprintf(buf,sizeof(buf)-1,fmt,va);
-    buf[sizeof(buf)-1] = 0;
-    XmlRpcLogHandler::getLogHandler()->log(level, buf);
+    if ( ! XmlRpcAsyncLog::record(level, fmt, va))
+    {
+      char buf[1024];
+      vsnprintf(buf,sizeof(buf)-1,fmt,va);
+      buf[sizeof(buf)-1] = 0;
+      XmlRpcLogHandler::getLogHandler()->log(level, buf);
+    }
+    va_end(va);
   }
 }
 
@@ -175,10 +180,84 @@ XmlRpcUtil::getNextTag(std::string const& xml, int* offset)
 
 
 // xml encodings (xml-encoded entities are preceded with '&')
-static const char  AMP = '&';
-static const char  rawEntity[] = { '<',   '>',   '&',    '\'',    '\"',    0 };
-static const char* xmlEntity[] = { "lt;", "gt;", "amp;", "apos;", "quot;", 0 };
-static const int   xmlEntLen[] = { 3,     3,     4,      5,       5 };
+static const char AMP = '&';
+
+// Characters that xmlEncode replaces with entities
+static bool isRawEntity(char c)
+{
+  return c == '<' || c == '>' || c == '&' || c == '\'' || c == '\"';
+}
+
+static const char* findRawEntityScalar(const char* p, const char* end)
+{
+  while (p != end && ! isRawEntity(*p))
+    ++p;
+  return p;
+}
+
+
+// Vectorized scans for the first character needing an entity. Text is
+// usually long runs of clean bytes, so these skip 16 or 32 bytes at a time.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define XMLRPC_SIMD_SCAN
+# include <immintrin.h>
+
+__attribute__((target("sse2")))
+static const char* findRawEntitySse2(const char* p, const char* end)
+{
+  const __m128i lt = _mm_set1_epi8('<'), gt = _mm_set1_epi8('>'), amp = _mm_set1_epi8('&');
+  const __m128i apos = _mm_set1_epi8('\''), quot = _mm_set1_epi8('\"');
+  for ( ; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) p);
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, amp),
+                                          _mm_or_si128(_mm_cmpeq_epi8(v, apos), _mm_cmpeq_epi8(v, quot))));
+    unsigned mask = unsigned(_mm_movemask_epi8(m));
+    if (mask)
+      return p + __builtin_ctz(mask);
+  }
+  return findRawEntityScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* findRawEntityAvx2(const char* p, const char* end)
+{
+  const __m256i lt = _mm256_set1_epi8('<'), gt = _mm256_set1_epi8('>'), amp = _mm256_set1_epi8('&');
+  const __m256i apos = _mm256_set1_epi8('\''), quot = _mm256_set1_epi8('\"');
+  for ( ; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) p);
+    __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt), _mm256_cmpeq_epi8(v, gt)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, amp),
+                                                _mm256_or_si256(_mm256_cmpeq_epi8(v, apos), _mm256_cmpeq_epi8(v, quot))));
+    unsigned mask = unsigned(_mm256_movemask_epi8(m));
+    if (mask)
+      return p + __builtin_ctz(mask);
+  }
+  return findRawEntitySse2(p, end);
+}
+#endif // SIMD scan
+
+
+typedef const char* (*RawEntityScan)(const char* p, const char* end);
+
+// Pick the widest scan the cpu supports, once
+static RawEntityScan chooseRawEntityScan()
+{
+#ifdef XMLRPC_SIMD_SCAN
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return findRawEntityAvx2;
+  if (__builtin_cpu_supports("sse2"))
+    return findRawEntitySse2;
+#endif
+  return findRawEntityScalar;
+}
+
+static const char* findRawEntity(const char* p, const char* end)
+{
+  static const RawEntityScan scan = chooseRawEntityScan();
+  return scan(p, end);
+}
 
 
 // Replace xml-encoded entities with the raw text equivalents.
@@ -186,34 +265,49 @@ static const int   xmlEntLen[] = { 3,     3,     4,      5,       5 };
 std::string 
 XmlRpcUtil::xmlDecode(const std::string& encoded)
 {
-  std::string::size_type iAmp = encoded.find(AMP);
-  if (iAmp == std::string::npos)
+  const char* p = encoded.data();
+  const char* end = p + encoded.size();
+
+  // memchr is already vectorized by the C library
+  const char* amp = (const char*) memchr(p, AMP, end - p);
+  if (amp == 0)
     return encoded;
 
-  std::string decoded(encoded, 0, iAmp);
-  std::string::size_type iSize = encoded.size();
-  decoded.reserve(iSize);
-
-  const char* ens = encoded.c_str();
-  while (iAmp != iSize) {
-    if (encoded[iAmp] == AMP && iAmp+1 < iSize) {
-      int iEntity;
-      for (iEntity=0; xmlEntity[iEntity] != 0; ++iEntity)
-	//if (encoded.compare(iAmp+1, xmlEntLen[iEntity], xmlEntity[iEntity]) == 0)
-	if (strncmp(ens+iAmp+1, xmlEntity[iEntity], xmlEntLen[iEntity]) == 0)
-        {
-          decoded += rawEntity[iEntity];
-          iAmp += xmlEntLen[iEntity]+1;
+  std::string decoded;
+  decoded.reserve(encoded.size());
+
+  while (amp != 0) {
+    decoded.append(p, amp - p);
+
+    const char* e = amp + 1;
+    size_t left = end - e;
+    char raw = 0;
+    int len = 0;
+    if (left >= 3) {
+      switch (*e) {
+        case 'l': if (e[1] == 't' && e[2] == ';') { raw = '<'; len = 3; } break;
+        case 'g': if (e[1] == 't' && e[2] == ';') { raw = '>'; len = 3; } break;
+        case 'a':
+          if (left >= 4 && e[1] == 'm' && e[2] == 'p' && e[3] == ';') { raw = '&'; len = 4; }
+          else if (left >= 5 && e[1] == 'p' && e[2] == 'o' && e[3] == 's' && e[4] == ';') { raw = '\''; len = 5; }
           break;
-        }
-      if (xmlEntity[iEntity] == 0)    // unrecognized sequence
-        decoded += encoded[iAmp++];
+        case 'q':
+          if (left >= 5 && e[1] == 'u' && e[2] == 'o' && e[3] == 't' && e[4] == ';') { raw = '\"'; len = 5; }
+          break;
+      }
+    }
 
-    } else {
-      decoded += encoded[iAmp++];
+    if (len) {
+      decoded += raw;
+      p = e + len;
+    } else {                      // unrecognized sequence
+      decoded += AMP;
+      p = e;
     }
+    amp = (const char*) memchr(p, AMP, end - p);
   }
-    
+
+  decoded.append(p, end - p);
   return decoded;
 }
 
@@ -223,28 +317,176 @@ XmlRpcUtil::xmlDecode(const std::string& encoded)
 std::string 
 XmlRpcUtil::xmlEncode(const std::string& raw)
 {
-  std::string::size_type iRep = raw.find_first_of(rawEntity);
-  if (iRep == std::string::npos)
-    return raw;
+  const char* p = raw.data();
+  const char* end = p + raw.size();
 
-  std::string encoded(raw, 0, iRep);
-  std::string::size_type iSize = raw.size();
+  const char* rep = findRawEntity(p, end);
+  if (rep == end)
+    return raw;
 
-  while (iRep != iSize) {
-    int iEntity;
-    for (iEntity=0; rawEntity[iEntity] != 0; ++iEntity)
-      if (raw[iRep] == rawEntity[iEntity])
-      {
-        encoded += AMP;
-        encoded += xmlEntity[iEntity];
-        break;
-      }
-    if (rawEntity[iEntity] == 0)
-      encoded += raw[iRep];
-    ++iRep;
+  std::string encoded;
+  encoded.reserve(raw.size() + raw.size() / 8 + 8);
+
+  while (rep != end) {
+    encoded.append(p, rep - p);     // Clean run in bulk
+    switch (*rep) {
+      case '<':  encoded.append("&lt;", 4); break;
+      case '>':  encoded.append("&gt;", 4); break;
+      case '&':  encoded.append("&amp;", 5); break;
+      case '\'': encoded.append("&apos;", 6); break;
+      case '\"': encoded.append("&quot;", 6); break;
+    }
+    p = rep + 1;
+    rep = findRawEntity(p, end);
   }
+
+  encoded.append(p, end - p);
   return encoded;
 }
 
 
 
+// Base64, encoded in blocks of three bytes to four characters with a line
+// break after every 72 characters.
+
+static const char B64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const int  B64_LINE_GROUPS = 18;       // 72 characters
+
+enum { B64_SKIP = 0x80, B64_PAD = 0x81 };
+
+// Character to 6-bit value, or B64_SKIP / B64_PAD
+struct Base64DecodeTable {
+  unsigned char value[256];
+  Base64DecodeTable() {
+    memset(value, B64_SKIP, sizeof(value));
+    for (int i = 0; i < 64; ++i)
+      value[(unsigned char) B64_CHARS[i]] = (unsigned char) i;
+    value[(unsigned char) '='] = B64_PAD;
+  }
+};
+static const Base64DecodeTable b64Decode;
+
+
+size_t
+XmlRpcUtil::base64EncodedLength(size_t len)
+{
+  return (len + 2) / 3 * 4 + (len / 3) / B64_LINE_GROUPS;
+}
+
+
+void
+XmlRpcUtil::base64Encode(const char* data, size_t len, std::string& out)
+{
+  size_t start = out.size();
+  out.resize(start + base64EncodedLength(len));
+  char* d = &out[0] + start;
+
+  const unsigned char* s = (const unsigned char*) data;
+  const unsigned char* end = s + len;
+  int groups = 0;
+
+  for ( ; end - s >= 3; s += 3) {
+    unsigned v = (unsigned(s[0]) << 16) | (unsigned(s[1]) << 8) | s[2];
+    d[0] = B64_CHARS[v >> 18];
+    d[1] = B64_CHARS[(v >> 12) & 0x3f];
+    d[2] = B64_CHARS[(v >> 6) & 0x3f];
+    d[3] = B64_CHARS[v & 0x3f];
+    d += 4;
+    if (++groups == B64_LINE_GROUPS) {
+      *d++ = '\n';
+      groups = 0;
+    }
+  }
+
+  if (end - s > 0) {
+    unsigned v = unsigned(s[0]) << 16;
+    if (end - s > 1) v |= unsigned(s[1]) << 8;
+    d[0] = B64_CHARS[v >> 18];
+    d[1] = B64_CHARS[(v >> 12) & 0x3f];
+    d[2] = (end - s > 1) ? B64_CHARS[(v >> 6) & 0x3f] : '=';
+    d[3] = '=';
+  }
+}
+
+
+size_t
+XmlRpcUtil::base64CompletePrefix(const char* text, size_t len)
+{
+  const unsigned char* p = (const unsigned char*) text;
+  const unsigned char* table = b64Decode.value;
+  size_t prefix = 0;
+  int n = 0;
+  for (size_t i = 0; i < len; ++i) {
+    unsigned c = table[p[i]];
+    if (c == B64_SKIP)
+      continue;
+    if (c == B64_PAD)
+      break;
+    if (++n == 4) {
+      n = 0;
+      prefix = i + 1;
+    }
+  }
+  return prefix;
+}
+
+
+void
+XmlRpcUtil::base64Decode(const char* text, size_t len, std::vector<char>& out)
+{
+  const unsigned char* p = (const unsigned char*) text;
+  const unsigned char* end = p + len;
+  const unsigned char* table = b64Decode.value;
+
+  size_t start = out.size();
+  out.resize(start + len / 4 * 3 + 3);
+  unsigned char* d = (unsigned char*) &out[0] + start;
+
+  for (;;) {
+    // Fast path: four characters of a group with no line break or padding in between
+    while (end - p >= 4) {
+      unsigned a = table[p[0]], b = table[p[1]], c = table[p[2]], e = table[p[3]];
+      if ((a | b | c | e) & 0x80)
+        break;
+      unsigned v = (a << 18) | (b << 12) | (c << 6) | e;
+      d[0] = (unsigned char) (v >> 16);
+      d[1] = (unsigned char) (v >> 8);
+      d[2] = (unsigned char) v;
+      d += 3;
+      p += 4;
+    }
+
+    // Slow path: gather one group, skipping other characters
+    unsigned group[4];
+    int n = 0;
+    for ( ; p != end && n < 4; ++p) {
+      unsigned c = table[*p];
+      if (c == B64_SKIP)
+        continue;
+      if (c == B64_PAD)
+        break;
+      group[n++] = c;
+    }
+
+    if (n == 4) {
+      unsigned v = (group[0] << 18) | (group[1] << 12) | (group[2] << 6) | group[3];
+      d[0] = (unsigned char) (v >> 16);
+      d[1] = (unsigned char) (v >> 8);
+      d[2] = (unsigned char) v;
+      d += 3;
+      continue;
+    }
+
+    // End of data, padding, or a short final group
+    if (n >= 2) {
+      unsigned v = (group[0] << 18) | (group[1] << 12) | ((n == 3) ? group[2] << 6 : 0);
+      *d++ = (unsigned char) (v >> 16);
+      if (n == 3)
+        *d++ = (unsigned char) (v >> 8);
+    }
+    break;
+  }
+
+  out.resize((char*) d - &out[0]);
+}
+
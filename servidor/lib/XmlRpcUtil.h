@@ -9,6 +9,7 @@
 
 #ifndef MAKEDEPEND
 # include <string>
+# include <vector>
 #endif
 
 #if defined(_MSC_VER)
@@ -21,6 +22,12 @@
 # define strncasecmp strnicmp
 #endif
 
+// Most verbose log level compiled in (0-5). Calls to XmlRpcUtil::log with a
+// constant level above it compile to nothing; build with make LOG_LEVEL=n.
+#ifndef XMLRPC_LOG_LEVEL
+# define XMLRPC_LOG_LEVEL 5
+#endif
+
 namespace XmlRpc {
 
   //! Utilities for XML parsing, encoding, and decoding and message handlers.
@@ -49,8 +56,33 @@ namespace XmlRpc {
     static std::string xmlDecode(const std::string& encoded);
 
 
-    //! Dump messages somewhere
-    static void log(int level, const char* fmt, ...);
+    //! Append the base64 encoding of len bytes of data to out, 72 characters per line.
+    static void base64Encode(const char* data, size_t len, std::string& out);
+
+    //! Append the bytes encoded in len characters of base64 text to out. Characters
+    //! outside the base64 alphabet (line breaks, spaces) are skipped; decoding stops
+    //! at the first padding group.
+    static void base64Decode(const char* text, size_t len, std::vector<char>& out);
+
+    //! Number of characters base64Encode produces for len bytes
+    static size_t base64EncodedLength(size_t len);
+
+    //! Length of the longest prefix of text holding only complete 4-character groups
+    //! (and no padding), which base64Decode turns into exactly 3 bytes per group.
+    //! Used to decode base64 text that is still arriving.
+    static size_t base64CompletePrefix(const char* text, size_t len);
+
+
+    //! Dump messages somewhere. Levels above XMLRPC_LOG_LEVEL are compiled out.
+    template <class... Args>
+    static void log(int level, const char* fmt, Args... args)
+    {
+      if (level <= XMLRPC_LOG_LEVEL)
+        logMessage(level, fmt, args...);
+    }
+
+    //! Dump messages somewhere, through XmlRpcAsyncLog when it is running
+    static void logMessage(int level, const char* fmt, ...);
 
     //! Dump error messages somewhere
     static void error(const char* fmt, ...);
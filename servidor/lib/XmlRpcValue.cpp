@@ -1,13 +1,15 @@
 #include "XmlRpcValue.h"
 #include "XmlRpcException.h"
 #include "XmlRpcUtil.h"
-#include "base64.h"
 
 #ifndef MAKEDEPEND
+# include <ctype.h>
 # include <iostream>
+# include <math.h>
 # include <ostream>
 # include <stdlib.h>
 # include <stdio.h>
+# include <string.h>
 #endif
 
 namespace XmlRpc {
@@ -44,7 +46,7 @@ namespace XmlRpc {
 
       
   // Format strings
-  std::string XmlRpcValue::_doubleFormat("%f");
+  std::string XmlRpcValue::_doubleFormat;
 
 
 
@@ -295,29 +297,245 @@ namespace XmlRpc {
     return xml;
   }
 
+  // Numbers. The common cases (plain decimal integers, and doubles that are
+  // exact in a few decimal places such as coordinates) are converted here;
+  // anything else goes through the C library.
+
+  static const double POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  static const unsigned long long POW10_INT[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull
+  };
+  static const double TWO_POW_53 = 9007199254740992.0;   // Integers up to here are exact
+
+  // Write the decimal digits of v, returning the position after the last one
+  static char* formatDigits(unsigned long long v, char* buf)
+  {
+    char tmp[24];
+    char* p = tmp + sizeof(tmp);
+    do {
+      *--p = char('0' + v % 10);
+      v /= 10;
+    } while (v != 0);
+    size_t n = tmp + sizeof(tmp) - p;
+    memcpy(buf, p, n);
+    return buf + n;
+  }
+
+  // Write v in buf (at least 32 chars), returning the length
+  static int formatInt(int v, char* buf)
+  {
+    char* p = buf;
+    unsigned u = unsigned(v);
+    if (v < 0) {
+      *p++ = '-';
+      u = 0u - u;
+    }
+    return int(formatDigits(u, p) - buf);
+  }
+
+  // Longest formatDouble output: "-0." and 323 zeros before the 17 digits of the
+  // smallest denormal
+  static const int DOUBLE_BUF_SIZE = 400;
+
+  // Write v in buf (at least DOUBLE_BUF_SIZE chars) with the fewest digits that
+  // read back as exactly v, returning the length. Always plain decimal notation:
+  // the XML-RPC <double> grammar has no exponent.
+  static int formatDouble(double v, char* buf)
+  {
+    if (v != v || v - v != 0.0)                   // nan, inf
+      return snprintf(buf, 32, "%f", v);
+
+    char* p = buf;
+    double a = v;
+    if (signbit(v)) {
+      *p++ = '-';
+      a = -v;
+    }
+
+    // Fixed notation when a = q / 10^k for some integer q below 2^53. The
+    // division is correctly rounded, as is reading the decimal back.
+    if (a < TWO_POW_53) {
+      for (int k = 0; k <= 15; ++k) {
+        double scaled = a * POW10[k];
+        if (scaled >= TWO_POW_53)
+          break;
+        double q = floor(scaled + 0.5);
+        if (q / POW10[k] != a)
+          continue;
+
+        unsigned long long iq = (unsigned long long) q;
+        p = formatDigits(iq / POW10_INT[k], p);
+        if (k > 0) {
+          *p++ = '.';
+          char* frac = p + k;
+          unsigned long long f = iq % POW10_INT[k];
+          while (frac != p) {
+            *--frac = char('0' + f % 10);
+            f /= 10;
+          }
+          p += k;
+        }
+        return int(p - buf);
+      }
+    }
+
+    // Otherwise the shortest of 15 to 17 significant digits that reads back
+    // exactly, written out without the exponent
+    char sci[32];
+    for (int prec = 15; prec <= 17; ++prec) {
+      snprintf(sci, sizeof(sci), "%.*e", prec - 1, a);
+      if (strtod(sci, 0) == a)
+        break;
+    }
+    char digits[20];                               // "d.ddd...e+XX" without '.' and exponent
+    int nd = 0;
+    const char* s = sci;
+    for (; *s != 'e'; ++s)
+      if (*s != '.')
+        digits[nd++] = *s;
+    int exp10 = atoi(s + 1);
+    while (nd > 1 && digits[nd-1] == '0')
+      --nd;
+
+    if (exp10 < 0) {
+      *p++ = '0';
+      *p++ = '.';
+      for (int i = -1; i > exp10; --i)
+        *p++ = '0';
+      memcpy(p, digits, nd);
+      p += nd;
+    } else {
+      for (int i = 0; i <= exp10; ++i)
+        *p++ = (i < nd) ? digits[i] : '0';
+      if (nd > exp10 + 1) {
+        *p++ = '.';
+        memcpy(p, digits + exp10 + 1, nd - exp10 - 1);
+        p += nd - exp10 - 1;
+      }
+    }
+    return int(p - buf);
+  }
+
+  // Parse [space][sign]digits as strtol does. Returns false (leaving the rest to
+  // strtol) if there are no digits or the value may not fit in an int.
+  static bool parseInt(const char* s, int* value, const char** end)
+  {
+    while (isspace((unsigned char) *s)) ++s;
+    bool negative = (*s == '-');
+    if (*s == '-' || *s == '+') ++s;
+
+    const char* digits = s;
+    long long v = 0;
+    while (*s >= '0' && *s <= '9' && s - digits < 10)
+      v = v * 10 + (*s++ - '0');
+    if (s == digits || (*s >= '0' && *s <= '9'))
+      return false;
+
+    if (negative) v = -v;
+    if (v < -2147483647LL - 1 || v > 2147483647LL)
+      return false;
+    *value = int(v);
+    *end = s;
+    return true;
+  }
+
+  // Parse [space][sign]digits[.digits][e[sign]digits] when the result is exact:
+  // at most 19 digits whose value is below 2^53 scaled by a power of ten up to
+  // 10^22 (both exact doubles, so one multiply or divide rounds correctly).
+  // Returns false for anything else (hex, inf, long mantissas) to use strtod.
+  static bool parseDouble(const char* s, double* value, const char** end)
+  {
+    while (isspace((unsigned char) *s)) ++s;
+    bool negative = (*s == '-');
+    if (*s == '-' || *s == '+') ++s;
+
+    unsigned long long m = 0;
+    int nDigits = 0;
+    int exp10 = 0;
+    const char* start = s;
+    for ( ; *s >= '0' && *s <= '9'; ++s) {
+      if (m == 0 && *s == '0') continue;            // Leading zeros
+      if (++nDigits > 19) return false;
+      m = m * 10 + unsigned(*s - '0');
+    }
+    bool any = (s != start);
+    if (*s == 'x' || *s == 'X')                       // Hex
+      return false;
+    if (*s == '.') {
+      const char* frac = ++s;
+      for ( ; *s >= '0' && *s <= '9'; ++s) {
+        if (m == 0 && *s == '0') { --exp10; continue; }
+        if (++nDigits > 19) return false;
+        m = m * 10 + unsigned(*s - '0');
+        --exp10;
+      }
+      any = any || (s != frac);
+    }
+    if ( ! any)
+      return false;
+
+    if (*s == 'e' || *s == 'E') {
+      const char* e = s + 1;
+      bool expNegative = (*e == '-');
+      if (*e == '-' || *e == '+') ++e;
+      if (*e >= '0' && *e <= '9') {
+        int x = 0;
+        for ( ; *e >= '0' && *e <= '9'; ++e)
+          if (x < 10000) x = x * 10 + (*e - '0');
+        exp10 += expNegative ? -x : x;
+        s = e;
+      }
+    }
+
+    if (m > (unsigned long long) TWO_POW_53)
+      return false;
+    double d = double(m);
+    if (m != 0) {
+      if (exp10 < -22 || exp10 > 22)
+        return false;
+      d = (exp10 < 0) ? d / POW10[-exp10] : d * POW10[exp10];
+    }
+    *value = negative ? -d : d;
+    *end = s;
+    return true;
+  }
+
+
   // Int
   bool XmlRpcValue::intFromXml(std::string const& valueXml, int* offset)
   {
     const char* valueStart = valueXml.c_str() + *offset;
-    char* valueEnd;
-    long ivalue = strtol(valueStart, &valueEnd, 10);
-    if (valueEnd == valueStart)
-      return false;
+    const char* valueEnd;
+    int ivalue;
+    if ( ! parseInt(valueStart, &ivalue, &valueEnd)) {
+      char* end;
+      ivalue = int(strtol(valueStart, &end, 10));
+      valueEnd = end;
+      if (valueEnd == valueStart)
+        return false;
+    }
 
     _type = TypeInt;
-    _value.asInt = int(ivalue);
+    _value.asInt = ivalue;
     *offset += int(valueEnd - valueStart);
     return true;
   }
 
   std::string XmlRpcValue::intToXml() const
   {
-    char buf[256];
-    snprintf(buf, sizeof(buf)-1, "%d", _value.asInt);
-    buf[sizeof(buf)-1] = 0;
-    std::string xml = VALUE_TAG;
+    char buf[32];
+    int n = formatInt(_value.asInt, buf);
+
+    std::string xml;
+    xml.reserve(sizeof(VALUE_TAG) + sizeof(I4_TAG) + n + sizeof(I4_ETAG) + sizeof(VALUE_ETAG));
+    xml += VALUE_TAG;
     xml += I4_TAG;
-    xml += buf;
+    xml.append(buf, n);
     xml += I4_ETAG;
     xml += VALUE_ETAG;
     return xml;
@@ -327,10 +545,15 @@ namespace XmlRpc {
   bool XmlRpcValue::doubleFromXml(std::string const& valueXml, int* offset)
   {
     const char* valueStart = valueXml.c_str() + *offset;
-    char* valueEnd;
-    double dvalue = strtod(valueStart, &valueEnd);
-    if (valueEnd == valueStart)
-      return false;
+    const char* valueEnd;
+    double dvalue;
+    if ( ! parseDouble(valueStart, &dvalue, &valueEnd)) {
+      char* end;
+      dvalue = strtod(valueStart, &end);
+      valueEnd = end;
+      if (valueEnd == valueStart)
+        return false;
+    }
 
     _type = TypeDouble;
     _value.asDouble = dvalue;
@@ -340,13 +563,21 @@ namespace XmlRpc {
 
   std::string XmlRpcValue::doubleToXml() const
   {
-    char buf[256];
-    snprintf(buf, sizeof(buf)-1, getDoubleFormat().c_str(), _value.asDouble);
-    buf[sizeof(buf)-1] = 0;
+    char buf[DOUBLE_BUF_SIZE];
+    int n;
+    if (getDoubleFormat().empty())
+      n = formatDouble(_value.asDouble, buf);
+    else {
+      snprintf(buf, sizeof(buf)-1, getDoubleFormat().c_str(), _value.asDouble);
+      buf[sizeof(buf)-1] = 0;
+      n = int(strlen(buf));
+    }
 
-    std::string xml = VALUE_TAG;
+    std::string xml;
+    xml.reserve(sizeof(VALUE_TAG) + sizeof(DOUBLE_TAG) + n + sizeof(DOUBLE_ETAG) + sizeof(VALUE_ETAG));
+    xml += VALUE_TAG;
     xml += DOUBLE_TAG;
-    xml += buf;
+    xml.append(buf, n);
     xml += DOUBLE_ETAG;
     xml += VALUE_ETAG;
     return xml;
@@ -420,34 +651,29 @@ namespace XmlRpc {
       return false;     // No end tag;
 
     _type = TypeBase64;
-    std::string asString = valueXml.substr(*offset, valueEnd-*offset);
     _value.asBinary = new BinaryData();
     // check whether base64 encodings can contain chars xml encodes...
 
     // convert from base64 to binary
-    int iostatus = 0;
-	  base64<char> decoder;
-    std::back_insert_iterator<BinaryData> ins = std::back_inserter(*(_value.asBinary));
-		decoder.get(asString.begin(), asString.end(), ins, iostatus);
+    XmlRpcUtil::base64Decode(valueXml.data() + *offset, valueEnd - *offset, *_value.asBinary);
 
-    *offset += int(asString.length());
+    *offset = int(valueEnd);
     return true;
   }
 
 
   std::string XmlRpcValue::binaryToXml() const
   {
-    // convert to base64
-    std::vector<char> base64data;
-    int iostatus = 0;
-	  base64<char> encoder;
-    std::back_insert_iterator<std::vector<char> > ins = std::back_inserter(base64data);
-		encoder.put(_value.asBinary->begin(), _value.asBinary->end(), ins, iostatus, base64<>::crlf());
+    size_t n = _value.asBinary->size();
+    std::string xml;
+    xml.reserve(sizeof(VALUE_TAG) + sizeof(BASE64_TAG) + XmlRpcUtil::base64EncodedLength(n) +
+                sizeof(BASE64_ETAG) + sizeof(VALUE_ETAG));
 
-    // Wrap with xml
-    std::string xml = VALUE_TAG;
+    // Wrap with xml, encoding to base64 in place
+    xml += VALUE_TAG;
     xml += BASE64_TAG;
-    xml.append(base64data.begin(), base64data.end());
+    if (n > 0)
+      XmlRpcUtil::base64Encode(&(*_value.asBinary)[0], n, xml);
     xml += BASE64_ETAG;
     xml += VALUE_ETAG;
     return xml;
@@ -559,10 +785,10 @@ namespace XmlRpc {
         }
       case TypeBase64:
         {
-          int iostatus = 0;
-          std::ostreambuf_iterator<char> out(os);
-          base64<char> encoder;
-          encoder.put(_value.asBinary->begin(), _value.asBinary->end(), out, iostatus, base64<>::crlf());
+          std::string encoded;
+          if ( ! _value.asBinary->empty())
+            XmlRpcUtil::base64Encode(&(*_value.asBinary)[0], _value.asBinary->size(), encoded);
+          os << encoded;
           break;
         }
       case TypeArray:
@@ -113,6 +113,9 @@ namespace XmlRpc {
     //! Check for the existence of a struct member by name.
     bool hasMember(const std::string& name) const;
 
+    //! The members of a struct value, e.g. to iterate over them.
+    ValueStruct& getMembers() { assertStruct(); return *_value.asStruct; }
+
     //! Decode xml. Destroys any existing value.
     bool fromXml(std::string const& valueXml, int* offset);
 
@@ -126,7 +129,9 @@ namespace XmlRpc {
     //! Return the format used to write double values.
     static std::string const& getDoubleFormat() { return _doubleFormat; }
 
-    //! Specify the format used to write double values.
+    //! Specify the printf format used to write double values. With an empty
+    //! format (the default) doubles are written with the fewest digits that
+    //! read back as exactly the same value.
     static void setDoubleFormat(const char* f) { _doubleFormat = f; }
 
 
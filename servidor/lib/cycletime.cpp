@@ -0,0 +1,116 @@
+/* cycletime.cpp : tiempo de ciclo de un programa G-code sin robot ni servidor.
+   Uso: cycletime [opciones] programa.gcode
+
+   Opciones:
+     -H N        movimientos en cola que ve el firmware (1, como runProgram)
+     -a ACEL     ACCELERATION en mm/s^2 (400)
+     -d MM       JUNCTION_DEVIATION en mm (0.05)
+     -s MM       simplificar antes con esta tolerancia, como uploadProgram
+     -j          salida en JSON
+
+   Compila el texto como uploadProgram y lo recorre desde home con
+   MotionPlanner: parando en cada vértice y con la anticipación de SPEED_PROFILE 3.
+*/
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+using namespace std;
+
+#include "ProgramStore.h"
+#include "MotionPlanner.h"
+#include "PathSimplifier.h"
+using namespace RPCServer;
+
+static void uso(const char* prog)
+{
+  cerr << "Uso: " << prog << " [-H horizonte] [-a aceleracion] [-d desvio] [-s tolerancia] [-j] programa.gcode\n";
+}
+
+int main(int argc, char* argv[])
+{
+  MotionLimits limits;
+  int horizon = 1;
+  float tolerance = -1;
+  bool json = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "H:a:d:s:jh")) != -1) {
+    switch (opt) {
+      case 'H': horizon = atoi(optarg); break;
+      case 'a': limits.acceleration = float(atof(optarg)); break;
+      case 'd': limits.junctionDeviation = float(atof(optarg)); break;
+      case 's': tolerance = float(atof(optarg)); break;
+      case 'j': json = true; break;
+      default: uso(argv[0]); return -1;
+    }
+  }
+  if (argc - optind != 1 || limits.acceleration <= 0 || limits.junctionDeviation <= 0) {
+    uso(argv[0]);
+    return -1;
+  }
+
+  ifstream in(argv[optind], ios::binary);
+  if ( ! in) {
+    cerr << "No se pudo abrir " << argv[optind] << "\n";
+    return -1;
+  }
+  stringstream text;
+  text << in.rdbuf();
+  string gcode = text.str();
+
+  ProgramCompiler compiler;
+  compiler.feed(gcode.data(), gcode.size());
+  if ( ! compiler.finish()) {
+    cerr << compiler.getError() << "\n";
+    return -1;
+  }
+  vector<char> image;
+  compiler.takeImage(image);
+  const ProgramCommand* commands = reinterpret_cast<const ProgramCommand*>(image.data() + sizeof(ProgramHeader));
+  size_t count = (image.size() - sizeof(ProgramHeader)) / sizeof(ProgramCommand);
+
+  MotionPlanner planner(ArmGeometry(), limits);
+  vector<ProgramCommand> simplified;
+  SimplifyReport sr;
+  if (tolerance >= 0) {
+    PathSimplifier simplifier(planner.getGeometry());
+    sr = simplifier.simplify(commands, commands + count, ReplayState::home(planner.getGeometry()), tolerance, simplified);
+    commands = simplified.data();
+    count = simplified.size();
+  }
+  CycleTimeReport r = planner.estimate(commands, commands + count, ReplayState::home(planner.getGeometry()), horizon);
+
+  if (json) {
+    if (tolerance >= 0)
+      printf("{\"simplification\":{\"tolerance\":%.4f,\"commandsBefore\":%zu,\"commandsAfter\":%zu,"
+             "\"serialBytesBefore\":%zu,\"serialBytesAfter\":%zu},", sr.tolerance, sr.commandsBefore,
+             sr.commandsAfter, sr.serialBytesBefore, sr.serialBytesAfter);
+    else
+      printf("{");
+    printf("\"commands\":%zu,\"segments\":%zu,\"chains\":%zu,\"pathMm\":%.3f,\"dwellSeconds\":%.3f,"
+           "\"cosineSeconds\":%.4f,\"cosinePeakAcceleration\":%.1f,\"stopSeconds\":%.4f,\"horizon\":%d,"
+           "\"lookAheadSeconds\":%.4f,\"queueSeconds\":%.4f,\"unlimitedSeconds\":%.4f,\"elapsedMs\":%.3f}\n",
+           r.commands, r.segments, r.chains, r.pathMm, r.dwellSeconds, r.cosineSeconds, r.cosinePeakAcceleration,
+           r.stopSeconds, r.horizon, r.lookAheadSeconds, r.queueSeconds, r.unlimitedSeconds, r.elapsedMs);
+    return 0;
+  }
+  if (tolerance >= 0)
+    printf("simplificado a %.3f mm: %zu -> %zu comandos, %zu -> %zu bytes por el puerto serie (%.2f -> %.2f s a 115200)\n",
+           sr.tolerance, sr.commandsBefore, sr.commandsAfter, sr.serialBytesBefore, sr.serialBytesAfter,
+           sr.serialBytesBefore * 10 / 115200.0, sr.serialBytesAfter * 10 / 115200.0);
+  printf("%zu comandos, %zu movimientos en %zu tramos, %.1f mm\n", r.commands, r.segments, r.chains, r.pathMm);
+  if (r.dwellSeconds > 0) printf("  pausas G4                     %9.3f s\n", r.dwellSeconds);
+  printf("  coseno, parando (actual)      %9.3f s  (aceleracion hasta %.0f mm/s^2)\n",
+         r.cosineSeconds, r.cosinePeakAcceleration);
+  printf("  trapecio, parando             %9.3f s  (%.0f mm/s^2)\n", r.stopSeconds, limits.acceleration);
+  printf("  anticipacion, %2d en cola      %9.3f s  (x%.2f)\n", r.horizon, r.lookAheadSeconds,
+         r.lookAheadSeconds > 0 ? r.cosineSeconds / r.lookAheadSeconds : 1.0);
+  printf("  anticipacion, cola llena (%d) %9.3f s\n", limits.queueSize, r.queueSeconds);
+  printf("  anticipacion, todo el programa%9.3f s\n", r.unlimitedSeconds);
+  printf("calculado en %.2f ms\n", r.elapsedMs);
+  return 0;
+}
@@ -0,0 +1,321 @@
+/* rpcbench.cpp : generador de carga y medicion de latencias para el servidor XMLRPC.
+   Uso: rpcbench [opciones] Host Port
+
+   Opciones:
+     -m MEZCLA   metodos y pesos (ServerTest:4,Sumar:3,getPosition:1,multicall:1);
+                 move mueve el brazo conectado: solo si se pide, ej. -m getPosition:3,move:1
+     -c N        conexiones al servidor (4)
+     -p N        llamadas en vuelo por conexion, pipelining (1)
+     -n N        llamadas concurrentes en modo lazo cerrado (16)
+     -r TASA     llamadas por segundo en modo lazo abierto (0 = lazo cerrado)
+     -d SEG      duracion de la medicion (10)
+     -w SEG      calentamiento previo, no se mide (1)
+     -t MS       deadline por llamada (5000)
+     -j          salida en JSON
+*/
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+using namespace std;
+
+#include "XmlRpc.h"
+using namespace XmlRpc;
+
+typedef std::chrono::steady_clock Reloj;
+
+// Los errores se cuentan en el reporte; no llenar la salida con cada uno
+class ErroresSilenciosos : public XmlRpcErrorHandler {
+public:
+  void error(const char*) {}
+} erroresSilenciosos;
+
+// Un metodo de la mezcla y sus resultados
+struct Metodo {
+  string nombre;
+  int peso;
+  XmlRpcValue params;
+  string llamada;           // nombre real del metodo XMLRPC
+  bool idempotente = true;  // se puede reenviar si se cae la conexion
+  vector<double> latencias; // microsegundos, solo llamadas exitosas
+  long ok = 0, faults = 0, errores = 0, timeouts = 0;
+};
+
+struct Opciones {
+  string mezcla = "ServerTest:4,Sumar:3,getPosition:1,multicall:1"; // sin move: no mover el brazo por defecto
+  int conexiones = 4;
+  int pipeline = 1;
+  int concurrencia = 16;
+  double tasa = 0.0;
+  double duracion = 10.0;
+  double calentamiento = 1.0;
+  double timeoutMs = 5000.0;
+  bool json = false;
+  string host;
+  int port = 0;
+};
+
+
+static void uso(const char* prog) {
+  std::cerr << "Uso: " << prog << " [-m mezcla] [-c conexiones] [-p pipeline] [-n concurrencia]\n"
+            << "       [-r llamadas/s] [-d segundos] [-w segundos] [-t ms] [-j] Host Port\n";
+}
+
+
+// Parametros fijos de cada metodo conocido
+static bool prepararMetodo(Metodo& m) {
+  m.llamada = m.nombre;
+  if (m.nombre == "ServerTest" || m.nombre == "getPosition" || m.nombre == "getEndstops") {
+    // sin argumentos
+  } else if (m.nombre == "Sumar") {
+    m.params[0] = 1.5; m.params[1] = 2.25; m.params[2] = 3.125;
+  } else if (m.nombre == "Eco") {
+    m.params[0] = "rpcbench";
+  } else if (m.nombre == "move") {
+    m.params[0] = 100.0; m.params[1] = 120.0; m.params[2] = 50.0; m.params[3] = 1000.0;
+    m.idempotente = false;
+  } else if (m.nombre == "multicall") {
+    // Lote de 8 llamadas en un solo pedido
+    m.llamada = "system.multicall";
+    XmlRpcValue lote;
+    for (int i = 0; i < 8; ++i) {
+      XmlRpcValue& c = lote[i];
+      if (i % 2 == 0) {
+        c["methodName"] = "Sumar";
+        c["params"][0] = double(i);
+        c["params"][1] = 0.5;
+      } else {
+        c["methodName"] = "ServerTest";
+        c["params"].setSize(0);
+      }
+    }
+    m.params[0] = lote;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+
+static bool parsearMezcla(const string& texto, vector<Metodo>& metodos) {
+  stringstream ss(texto);
+  string item;
+  while (getline(ss, item, ',')) {
+    Metodo m;
+    size_t dp = item.find(':');
+    m.nombre = item.substr(0, dp);
+    m.peso = (dp == string::npos) ? 1 : atoi(item.c_str() + dp + 1);
+    if (m.peso <= 0) continue;
+    if ( ! prepararMetodo(m)) {
+      std::cerr << "Metodo desconocido en la mezcla: " << m.nombre << "\n";
+      return false;
+    }
+    metodos.push_back(m);
+  }
+  return ! metodos.empty();
+}
+
+
+static double percentil(vector<double>& v, double p) {
+  if (v.empty()) return 0.0;
+  size_t k = size_t(p * (v.size() - 1) + 0.5);
+  return v[k];
+}
+
+
+// Generador de carga: elige metodos segun los pesos y registra cada resultado
+class Bench {
+public:
+  Bench(Opciones& o, vector<Metodo>& metodos)
+    : _o(o), _metodos(metodos), _cliente(o.host.c_str(), o.port)
+  {
+    _cliente.setMaxConnections(o.conexiones);
+    _cliente.setMaxPipeline(o.pipeline);
+    for (size_t i = 0; i < _metodos.size(); ++i)
+      for (int k = 0; k < _metodos[i].peso; ++k)
+        _ruleta.push_back(int(i));
+  }
+
+  void correr() {
+    Reloj::time_point inicio = Reloj::now();
+    _inicioMedicion = inicio + segundos(_o.calentamiento);
+    _fin = _inicioMedicion + segundos(_o.duracion);
+
+    if (_o.tasa > 0.0)
+      lazoAbierto(inicio);
+    else
+      lazoCerrado();
+
+    // Esperar las respuestas pendientes (hasta el deadline de cada una)
+    _cliente.work(_o.timeoutMs + 1000.0);
+  }
+
+  void reportar() {
+    long ok = 0, faults = 0, errores = 0, timeouts = 0;
+    vector<double> todas;
+    for (size_t i = 0; i < _metodos.size(); ++i) {
+      Metodo& m = _metodos[i];
+      std::sort(m.latencias.begin(), m.latencias.end());
+      todas.insert(todas.end(), m.latencias.begin(), m.latencias.end());
+      ok += m.ok; faults += m.faults; errores += m.errores; timeouts += m.timeouts;
+    }
+    std::sort(todas.begin(), todas.end());
+    long total = ok + faults + errores + timeouts;
+    double tasaError = total ? double(faults + errores + timeouts) / total : 0.0;
+
+    if (_o.json) {
+      printf("{\"host\":\"%s\",\"port\":%d,\"connections\":%d,\"pipeline\":%d,", _o.host.c_str(), _o.port,
+             _o.conexiones, _o.pipeline);
+      if (_o.tasa > 0.0) printf("\"mode\":\"open\",\"targetRate\":%.1f,", _o.tasa);
+      else               printf("\"mode\":\"closed\",\"concurrency\":%d,", _o.concurrencia);
+      printf("\"duration\":%.3f,\"calls\":%ld,\"throughput\":%.1f,\"errorRate\":%.6f,",
+             _o.duracion, total, total / _o.duracion, tasaError);
+      printf("\"latencyUs\":");
+      jsonLatencias(todas);
+      printf(",\"methods\":[");
+      for (size_t i = 0; i < _metodos.size(); ++i) {
+        Metodo& m = _metodos[i];
+        printf("%s{\"name\":\"%s\",\"ok\":%ld,\"faults\":%ld,\"errors\":%ld,\"timeouts\":%ld,\"latencyUs\":",
+               i ? "," : "", m.nombre.c_str(), m.ok, m.faults, m.errores, m.timeouts);
+        jsonLatencias(m.latencias);
+        printf("}");
+      }
+      printf("]}\n");
+      return;
+    }
+
+    printf("Servidor %s:%d, %d conexiones, pipeline %d, ", _o.host.c_str(), _o.port, _o.conexiones, _o.pipeline);
+    if (_o.tasa > 0.0) printf("lazo abierto a %.1f llamadas/s\n", _o.tasa);
+    else               printf("lazo cerrado con %d llamadas concurrentes\n", _o.concurrencia);
+    printf("Llamadas: %ld en %.1f s  ->  %.1f llamadas/s, errores %.3f%%\n",
+           total, _o.duracion, total / _o.duracion, 100.0 * tasaError);
+    printf("\n%-12s %9s %7s %7s %7s %10s %10s %10s %10s\n",
+           "metodo", "ok", "fault", "error", "timeout", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+    for (size_t i = 0; i < _metodos.size(); ++i) {
+      Metodo& m = _metodos[i];
+      filaTexto(m.nombre, m.ok, m.faults, m.errores, m.timeouts, m.latencias);
+    }
+    filaTexto("TOTAL", ok, faults, errores, timeouts, todas);
+  }
+
+private:
+  static Reloj::duration segundos(double s) {
+    return std::chrono::duration_cast<Reloj::duration>(std::chrono::duration<double>(s));
+  }
+
+  void filaTexto(const string& nombre, long ok, long faults, long errores, long timeouts, vector<double>& lat) {
+    printf("%-12s %9ld %7ld %7ld %7ld %10.0f %10.0f %10.0f %10.0f\n", nombre.c_str(), ok, faults, errores, timeouts,
+           percentil(lat, 0.50), percentil(lat, 0.99), percentil(lat, 0.999), lat.empty() ? 0.0 : lat.back());
+  }
+
+  void jsonLatencias(vector<double>& lat) {
+    double suma = 0.0;
+    for (size_t i = 0; i < lat.size(); ++i) suma += lat[i];
+    printf("{\"mean\":%.1f,\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}",
+           lat.empty() ? 0.0 : suma / lat.size(), percentil(lat, 0.50), percentil(lat, 0.99),
+           percentil(lat, 0.999), lat.empty() ? 0.0 : lat.back());
+  }
+
+  // Lanza una llamada. La latencia se mide desde 'programada', que en lazo abierto
+  // es el instante en que la llamada debia salir (evita la omision coordinada).
+  void lanzar(Reloj::time_point programada) {
+    Metodo& m = _metodos[_ruleta[_sorteo++ % _ruleta.size()]];
+    _cliente.executeAsync(m.llamada.c_str(), m.params,
+      [this, &m, programada](int, XmlRpcAsyncClient::CallStatus st, XmlRpcValue&) {
+        Reloj::time_point ahora = Reloj::now();
+        if (programada >= _inicioMedicion && programada < _fin) {
+          switch (st) {
+            case XmlRpcAsyncClient::CallOk:
+              m.ok++;
+              m.latencias.push_back(std::chrono::duration<double, std::micro>(ahora - programada).count());
+              break;
+            case XmlRpcAsyncClient::CallFault:   m.faults++; break;
+            case XmlRpcAsyncClient::CallError:   m.errores++; break;
+            case XmlRpcAsyncClient::CallTimeout: m.timeouts++; break;
+          }
+        }
+        // Lazo cerrado: cada respuesta libera el lugar para la siguiente llamada
+        if (_o.tasa <= 0.0 && ahora < _fin)
+          lanzar(ahora);
+      }, _o.timeoutMs, m.idempotente);
+  }
+
+  void lazoCerrado() {
+    Reloj::time_point ahora = Reloj::now();
+    for (int i = 0; i < _o.concurrencia; ++i)
+      lanzar(ahora);
+    while (Reloj::now() < _fin && _cliente.getOutstanding() > 0)
+      _cliente.work(std::chrono::duration<double, std::milli>(_fin - Reloj::now()).count());
+  }
+
+  void lazoAbierto(Reloj::time_point inicio) {
+    Reloj::duration intervalo = segundos(1.0 / _o.tasa);
+    Reloj::time_point proxima = inicio;
+    while (proxima < _fin) {
+      Reloj::time_point ahora = Reloj::now();
+      while (proxima <= ahora && proxima < _fin) {
+        lanzar(proxima);
+        proxima += intervalo;
+      }
+      double espera = std::chrono::duration<double, std::milli>(proxima - Reloj::now()).count();
+      if (espera <= 0.0) continue;
+      if (_cliente.work(espera))
+        std::this_thread::sleep_until(proxima);   // Nada pendiente: dormir hasta la proxima
+    }
+  }
+
+  Opciones& _o;
+  vector<Metodo>& _metodos;
+  vector<int> _ruleta;
+  unsigned long _sorteo = 0;
+  XmlRpcAsyncClient _cliente;
+  Reloj::time_point _inicioMedicion;
+  Reloj::time_point _fin;
+};
+
+
+int main(int argc, char* argv[])
+{
+  Opciones o;
+  int opt;
+  while ((opt = getopt(argc, argv, "m:c:p:n:r:d:w:t:jh")) != -1) {
+    switch (opt) {
+      case 'm': o.mezcla = optarg; break;
+      case 'c': o.conexiones = atoi(optarg); break;
+      case 'p': o.pipeline = atoi(optarg); break;
+      case 'n': o.concurrencia = atoi(optarg); break;
+      case 'r': o.tasa = atof(optarg); break;
+      case 'd': o.duracion = atof(optarg); break;
+      case 'w': o.calentamiento = atof(optarg); break;
+      case 't': o.timeoutMs = atof(optarg); break;
+      case 'j': o.json = true; break;
+      default: uso(argv[0]); return -1;
+    }
+  }
+  if (argc - optind != 2 || o.duracion <= 0.0 || o.conexiones < 1 || o.concurrencia < 1) {
+    uso(argv[0]);
+    return -1;
+  }
+  o.host = argv[optind];
+  o.port = atoi(argv[optind + 1]);
+
+  vector<Metodo> metodos;
+  if ( ! parsearMezcla(o.mezcla, metodos)) {
+    uso(argv[0]);
+    return -1;
+  }
+
+  XmlRpc::setVerbosity(0);
+  XmlRpcErrorHandler::setErrorHandler(&erroresSilenciosos);
+
+  Bench bench(o, metodos);
+  bench.correr();
+  bench.reportar();
+  return 0;
+}
@@ -0,0 +1,17 @@
+// Lo mínimo de Arduino.h para compilar en el PC las partes del firmware que no
+// tocan hardware (robotGeometry.cpp)
+#ifndef ARDUINO_STUB_H_
+#define ARDUINO_STUB_H_
+
+#include <math.h>
+#include <stdint.h>
+
+typedef uint8_t byte;
+
+#define PI 3.1415926535897932384626433832795
+#define PROGMEM
+
+inline float sq(float x) { return x * x; }
+inline unsigned int pgm_read_word(const uint16_t* p) { return *p; }
+
+#endif
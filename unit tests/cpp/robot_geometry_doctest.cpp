@@ -0,0 +1,150 @@
+// Precisión de RobotGeometry (firmware) con TABLE_IK contra la versión float.
+// Compilar desde "unit tests/cpp" (arduino/ tiene lo poco de Arduino.h que hace falta):
+//   g++ -O2 -I arduino -I ../../Firmware/robotArm_v0.62sim robot_geometry_doctest.cpp
+//       ../../Firmware/robotArm_v0.62sim/robotGeometry.cpp -o robot_geometry_doctest
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <cmath>
+#include <iostream>
+#include <Arduino.h>
+#include "config.h"
+#include "robotGeometry.h"
+using namespace std;
+
+// Un paso de motor en rad (como RampsStepper::stepToPositionRad)
+static const double STEP_RAD = 2 * PI / (MICROSTEPS * STEPS_PER_REV * MAIN_GEAR_TEETH / MOTOR_GEAR_TEETH);
+static const double MAX_ERROR_RAD = 5e-5;
+
+// RobotGeometry::calculateGrad como estaba antes de TABLE_IK: con T = float es la
+// versión del firmware y con T = double sirve de referencia
+struct Angulos
+{
+    double rot, low, high;
+};
+
+template <typename T>
+static Angulos ikLibm(T xmm, T ymm, T zmm)
+{
+    T rrot_ee = hypot(xmm, ymm);
+    T rrot = rrot_ee - T(END_EFFECTOR_OFFSET);
+    T rside = hypot(rrot, zmm);
+    T rside_2 = rside * rside;
+    T low_2 = T(LOW_SHANK_LENGTH) * T(LOW_SHANK_LENGTH);
+    T high_2 = T(HIGH_SHANK_LENGTH) * T(HIGH_SHANK_LENGTH);
+    T rot = asin(xmm / rrot_ee);
+    T high = T(PI) - acos((low_2 + high_2 - rside_2) / (2 * T(LOW_SHANK_LENGTH) * T(HIGH_SHANK_LENGTH)));
+    T low;
+    if (zmm > 0)
+    {
+        low = acos(zmm / rside) - acos((low_2 - high_2 + rside_2) / (2 * T(LOW_SHANK_LENGTH) * rside));
+    }
+    else
+    {
+        low = T(PI) - asin(rrot / rside) - acos((low_2 - high_2 + rside_2) / (2 * T(LOW_SHANK_LENGTH) * rside));
+    }
+    Angulos a = {rot, low, high + low};
+    return a;
+}
+
+static void peorError(const Angulos& a, const Angulos& ref, double peor[3])
+{
+    double err[3] = {fabs(a.rot - ref.rot), fabs(a.low - ref.low), fabs(a.high - ref.high)};
+    for (int i = 0; i < 3; ++i)
+    {
+        if (err[i] > peor[i])
+        {
+            peor[i] = err[i];
+        }
+    }
+}
+
+// Dentro de los límites de G0/G1 en el firmware (Z_MIN, Z_MAX y el ángulo entre brazos)
+static bool alcanzable(float x, float y, float z)
+{
+    float rrot = hypot(x, y) - END_EFFECTOR_OFFSET;
+    float rside_2 = rrot * rrot + z * z;
+    float cosCodo = (sq(LOW_SHANK_LENGTH) + sq(HIGH_SHANK_LENGTH) - rside_2) / (2 * LOW_SHANK_LENGTH * HIGH_SHANK_LENGTH);
+    return hypot(x, y) > 1 && z >= Z_MIN && z <= Z_MAX &&
+           cosCodo <= SHANKS_MIN_ANGLE_COS && cosCodo >= SHANKS_MAX_ANGLE_COS;
+}
+
+TEST_CASE("IK con tabla contra float en todo el espacio de trabajo")
+{
+    RobotGeometry geometry(END_EFFECTOR_OFFSET, LOW_SHANK_LENGTH, HIGH_SHANK_LENGTH);
+    double peorTabla[3] = {0, 0, 0};
+    double peorFloat[3] = {0, 0, 0};
+    long puntos = 0;
+    // Paso irregular para no repetir siempre los mismos cocientes
+    for (float x = -280; x <= 280; x += 3.37f)
+    {
+        for (float y = -280; y <= 280; y += 3.11f)
+        {
+            for (float z = Z_MIN; z <= Z_MAX; z += 2.93f)
+            {
+                if (!alcanzable(x, y, z))
+                {
+                    continue;
+                }
+                Angulos ref = ikLibm<double>(x, y, z);
+                geometry.set(x, y, z);
+                Angulos tabla = {geometry.getRotRad(), geometry.getLowRad(), geometry.getHighRad()};
+                peorError(tabla, ref, peorTabla);
+                peorError(ikLibm<float>(x, y, z), ref, peorFloat);
+                ++puntos;
+            }
+        }
+    }
+    cout << puntos << " puntos, error máximo (rad) contra double, un paso = " << STEP_RAD << "\n"
+         << "  tabla: rot " << peorTabla[0] << " low " << peorTabla[1] << " high " << peorTabla[2] << "\n"
+         << "  float: rot " << peorFloat[0] << " low " << peorFloat[1] << " high " << peorFloat[2] << "\n";
+    CHECK(puntos > 100000);
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK(peorTabla[i] < MAX_ERROR_RAD);
+    }
+    CHECK(MAX_ERROR_RAD < STEP_RAD / 10);
+}
+
+TEST_CASE("Posiciones conocidas")
+{
+    RobotGeometry geometry(END_EFFECTOR_OFFSET, LOW_SHANK_LENGTH, HIGH_SHANK_LENGTH);
+
+    SUBCASE("Posición inicial: brazo inferior vertical y superior horizontal")
+    {
+        geometry.set(INITIAL_X, INITIAL_Y, INITIAL_Z);
+        CHECK(geometry.getRotRad() == doctest::Approx(0).epsilon(MAX_ERROR_RAD));
+        CHECK(geometry.getLowRad() == doctest::Approx(0).epsilon(MAX_ERROR_RAD));
+        CHECK(geometry.getHighRad() == doctest::Approx(PI / 2).epsilon(MAX_ERROR_RAD));
+    }
+
+    SUBCASE("Simetría en x")
+    {
+        geometry.set(80, 120, -40);
+        float rot = geometry.getRotRad(), low = geometry.getLowRad(), high = geometry.getHighRad();
+        geometry.set(-80, 120, -40);
+        CHECK(geometry.getRotRad() == doctest::Approx(-rot));
+        CHECK(geometry.getLowRad() == doctest::Approx(low));
+        CHECK(geometry.getHighRad() == doctest::Approx(high));
+    }
+}
+
+TEST_CASE("Sólo se resuelve de nuevo si cambia el destino")
+{
+    RobotGeometry geometry(END_EFFECTOR_OFFSET, LOW_SHANK_LENGTH, HIGH_SHANK_LENGTH);
+    geometry.set(10, 150, 20);
+    float low = geometry.getLowRad();
+    geometry.set(10, 150, 20);
+    CHECK(geometry.getLowRad() == low);
+    geometry.set(10, 150, 25);
+    CHECK(geometry.getLowRad() != low);
+    CHECK(geometry.getZmm() == 25);
+}
+
+TEST_CASE("Fuera de alcance da lo mismo que float")
+{
+    RobotGeometry geometry(END_EFFECTOR_OFFSET, LOW_SHANK_LENGTH, HIGH_SHANK_LENGTH);
+    geometry.set(0, 400, 0);
+    Angulos ref = ikLibm<float>(0, 400, 0);
+    CHECK(std::isnan(geometry.getLowRad()) == std::isnan(ref.low));
+    CHECK(std::isnan(geometry.getHighRad()) == std::isnan(ref.high));
+}